@@ -0,0 +1,74 @@
+#include <stdio.h>
+
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/simulator.hpp"
+#include "mood_thieves/utils.hpp"
+
+/**
+ * Measures holding back the ACKs of requests queued far behind under the broadcast protocol.
+ *
+ * K thieves share 4 weapons and 4 laboratories in the simulator, so the weapons are overloaded K / 4 times.
+ * A message costs its receiver --handle-ns of virtual time, messages saved shorten the backlog of every
+ * receiver. For K = 64..256 and an ACK horizon of 0 (every request acknowledged right away), 1, 2 and 4 pools
+ * it reports the messages and the ACKs per laboratory entry and the weapon acquisition latency in virtual time.
+ *
+ * Usage: ack_horizon [--handle-ns=20000] [--name=value ...]
+ */
+
+namespace
+{
+
+using mood_thieves::Metrics;
+
+double messages_per_entry(const Metrics &metrics, int message_type, int entries)
+{
+    return static_cast<double>(metrics.sentCount(message_type)) / entries;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    mood_thieves::Config base;
+    base.weapons = 4;
+    base.laboratories = 4;
+    base.weapon_us = 1000;
+    base.laboratory_us = 3000;
+    base.recharge_us = 5000;
+    base.entries = 5;
+    base.handle_ns = 20000;
+    base.latency = {mood_thieves::LatencyDistribution::EXPONENTIAL, 50, 50};
+    if (mood_thieves::parse_config(argc, argv, base) == -1)
+    {
+        return 1;
+    }
+    base.protocol = mood_thieves::Protocol::BROADCAST;
+
+    printf("%6s %8s %12s %10s %14s %14s %12s %10s\n", "K", "horizon", "msgs/entry", "acks/entry", "acquire(ms)",
+           "p99(ms)", "virtual(s)", "violations");
+    for (int size = 64; size <= 256; size *= 2)
+    {
+        for (int horizon : {0, 1, 2, 4})
+        {
+            mood_thieves::Config config = base;
+            config.thieves = size;
+            config.ack_horizon = horizon;
+            mood_thieves::Simulator simulator(config);
+            simulator.run();
+
+            const Metrics &metrics = simulator.getMetrics();
+            int entries = size * config.entries;
+            double messages = 0;
+            for (int type = 0; type < Metrics::MESSAGE_TYPES; type++)
+            {
+                messages += messages_per_entry(metrics, type, entries);
+            }
+            mood_thieves::HistogramSummary acquire = metrics.summary(Metrics::ACQUIRE_WEAPON);
+            double mean_ms = acquire.count > 0 ? static_cast<double>(acquire.sum) / acquire.count / 1e6 : 0;
+            printf("%6d %8d %12.1f %10.1f %14.2f %14.2f %12.3f %10ld\n", size, horizon, messages,
+                   messages_per_entry(metrics, mood_thieves::utils::MessageType::ACK, entries), mean_ms,
+                   acquire.percentile(0.99) / 1e6, simulator.virtualNs() / 1e9, simulator.violationCount());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,313 @@
+#include <filesystem>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * End-to-end benchmark of the thieves sweeping the number of ranks, the pool sizes and the phase durations.
+ *
+ * Every point of the sweep launches main under mpirun for a fixed number of laboratory entries per thief or
+ * a fixed duration, reads the JSON metrics rank 0 writes on exit and prints a CSV row with the laboratory
+ * entries per second, the acquisition latency percentiles and the messages sent per laboratory entry, the
+ * remote atomic operations for the rma protocol.
+ *
+ * Usage: bench [--name=value ...] > bench.csv
+ */
+
+namespace
+{
+
+struct Options
+{
+    std::vector<std::string> protocols = {"broadcast"}; ///< Protocols to sweep.
+    std::vector<int> ranks = {2, 4};                    ///< Numbers of thieves to sweep.
+    std::vector<int> weapons = {2};                     ///< Weapon pool sizes to sweep.
+    std::vector<int> laboratories = {1};                ///< Laboratory sizes to sweep.
+    std::vector<int> weapon_us = {1000};                ///< Roaming phase durations to sweep.
+    std::vector<int> laboratory_us = {3000};            ///< Laboratory phase durations to sweep.
+    std::vector<int> recharge_us = {5000};              ///< Recharge durations to sweep.
+    int entries = 20;                                   ///< Laboratory entries per thief, if no duration.
+    int duration_ms = 0;                                ///< Milliseconds every run lasts, 0 runs for the entries.
+    std::string mpirun = "mpirun --oversubscribe";      ///< Launcher of a run, followed by -np.
+    std::string transport = "mpi";                      ///< Transport of the thieves, mpi or in-process.
+    std::string main;                                   ///< The thieves executable.
+    std::string extra;                                  ///< Further arguments passed to every run.
+};
+
+/**
+ * Split a comma separated list.
+ */
+std::vector<std::string> split(const std::string &value)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (true)
+    {
+        size_t comma = value.find(',', start);
+        items.push_back(value.substr(start, comma - start));
+        if (comma == std::string::npos)
+        {
+            return items;
+        }
+        start = comma + 1;
+    }
+}
+
+/**
+ * Parse a comma separated list of non-negative integers.
+ *
+ * @return True if every item is a non-negative integer, false otherwise.
+ */
+bool parse_ints(const std::string &value, std::vector<int> &result)
+{
+    result.clear();
+    for (const std::string &item : split(value))
+    {
+        char *end = nullptr;
+        long parsed = strtol(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || parsed < 0 || parsed > 0x7fffffff)
+        {
+            return false;
+        }
+        result.push_back(parsed);
+    }
+    return true;
+}
+
+int parse_options(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        size_t separator = argument.find('=');
+        if (argument.rfind("--", 0) != 0 || separator == std::string::npos)
+        {
+            fprintf(stderr, "[ERROR]: Invalid argument %s, expected --name=value\n", argv[i]);
+            return -1;
+        }
+        std::string name = argument.substr(2, separator - 2);
+        std::string value = argument.substr(separator + 1);
+
+        bool valid = true;
+        if (name == "protocols")
+        {
+            options.protocols = split(value);
+        }
+        else if (name == "ranks")
+        {
+            valid = parse_ints(value, options.ranks);
+        }
+        else if (name == "weapons")
+        {
+            valid = parse_ints(value, options.weapons);
+        }
+        else if (name == "laboratories")
+        {
+            valid = parse_ints(value, options.laboratories);
+        }
+        else if (name == "weapon-us")
+        {
+            valid = parse_ints(value, options.weapon_us);
+        }
+        else if (name == "laboratory-us")
+        {
+            valid = parse_ints(value, options.laboratory_us);
+        }
+        else if (name == "recharge-us")
+        {
+            valid = parse_ints(value, options.recharge_us);
+        }
+        else if (name == "entries")
+        {
+            std::vector<int> entries;
+            valid = parse_ints(value, entries) && entries.size() == 1;
+            options.entries = valid ? entries[0] : 0;
+        }
+        else if (name == "duration-ms")
+        {
+            std::vector<int> duration;
+            valid = parse_ints(value, duration) && duration.size() == 1;
+            options.duration_ms = valid ? duration[0] : 0;
+        }
+        else if (name == "mpirun")
+        {
+            options.mpirun = value;
+        }
+        else if (name == "transport")
+        {
+            options.transport = value;
+            valid = value == "mpi" || value == "in-process";
+        }
+        else if (name == "main")
+        {
+            options.main = value;
+        }
+        else if (name == "extra")
+        {
+            options.extra = value;
+        }
+        else
+        {
+            fprintf(stderr, "[ERROR]: Unknown argument --%s\n", name.c_str());
+            return -1;
+        }
+
+        if (!valid)
+        {
+            fprintf(stderr, "[ERROR]: Invalid value for --%s: %s\n", name.c_str(), value.c_str());
+            return -1;
+        }
+    }
+    if (options.entries == 0 && options.duration_ms == 0)
+    {
+        fprintf(stderr, "[ERROR]: Either --entries or --duration-ms has to be positive\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Find a number following a key in the JSON report, searching from a position.
+ *
+ * @return The number, 0 if the key is missing.
+ */
+double json_number(const std::string &json, const std::string &key, size_t from = 0)
+{
+    size_t position = json.find("\"" + key + "\":", from);
+    if (position == std::string::npos)
+    {
+        return 0;
+    }
+    return strtod(json.c_str() + position + key.size() + 3, nullptr);
+}
+
+/**
+ * @return The position of an object in the JSON report, 0 if it is missing.
+ */
+size_t json_object(const std::string &json, const std::string &key, size_t from = 0)
+{
+    size_t position = json.find("\"" + key + "\":{", from);
+    return position == std::string::npos ? 0 : position;
+}
+
+struct Point
+{
+    std::string protocol;
+    int ranks, weapons, laboratories, weapon_us, laboratory_us, recharge_us;
+};
+
+/**
+ * Runs a point of the sweep and prints its CSV row.
+ *
+ * @return Status code, -1 if the run failed.
+ */
+int run(const Options &options, const Point &point, const std::string &metrics_file)
+{
+    // In-process thieves are threads of a single process started without mpirun
+    std::string launcher = options.transport == "mpi"
+                               ? options.mpirun + " -np " + std::to_string(point.ranks) + " " + options.main
+                               : options.main + " --transport=in-process --thieves=" + std::to_string(point.ranks);
+    std::string command = launcher + " --protocol=" + point.protocol + " --weapons=" + std::to_string(point.weapons) +
+                          " --laboratories=" + std::to_string(point.laboratories) +
+                          " --weapon-us=" + std::to_string(point.weapon_us) +
+                          " --laboratory-us=" + std::to_string(point.laboratory_us) +
+                          " --recharge-us=" + std::to_string(point.recharge_us) +
+                          (options.duration_ms > 0 ? " --duration-ms=" + std::to_string(options.duration_ms)
+                                                   : " --entries=" + std::to_string(options.entries)) +
+                          " --metrics=json --metrics-file=" + metrics_file + " " + options.extra + " > /dev/null";
+
+    std::filesystem::remove(metrics_file);
+    if (system(command.c_str()) != 0)
+    {
+        fprintf(stderr, "[ERROR]: %s failed\n", command.c_str());
+        return -1;
+    }
+    FILE *file = fopen(metrics_file.c_str(), "r");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "[ERROR]: %s wrote no metrics\n", command.c_str());
+        return -1;
+    }
+    std::string json;
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        json.append(buffer, read);
+    }
+    fclose(file);
+
+    double elapsed_s = json_number(json, "elapsed_s");
+    size_t laboratory = json_object(json, "acquire_laboratory_us");
+    size_t weapon = json_object(json, "acquire_weapon_us");
+    double entries = json_number(json, "count", laboratory);
+    double messages = 0;
+    size_t sent = json_object(json, "sent");
+    for (const char *type : {"REQUEST", "ACK", "RELEASE", "INQUIRE", "YIELD", "FAILED", "TOKEN", "WITHDRAW", "SERVED"})
+    {
+        messages += json_number(json, type, sent);
+    }
+    size_t remote_ops = json_object(json, "remote_ops");
+    messages += json_number(json, "count", remote_ops) * json_number(json, "mean", remote_ops);
+
+    printf("%s,%d,%d,%d,%d,%d,%d,%.3f,%.0f,%.2f,%.1f,%.1f,%.1f,%.1f,%.1f,%.2f\n", point.protocol.c_str(),
+           point.ranks, point.weapons, point.laboratories, point.weapon_us, point.laboratory_us, point.recharge_us,
+           elapsed_s, entries, elapsed_s > 0 ? entries / elapsed_s : 0, json_number(json, "p50", laboratory),
+           json_number(json, "p90", laboratory), json_number(json, "p99", laboratory),
+           json_number(json, "p50", weapon), json_number(json, "p99", weapon), entries > 0 ? messages / entries : 0);
+    fflush(stdout);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (parse_options(argc, argv, options) == -1)
+    {
+        return 1;
+    }
+    if (options.main.empty())
+    {
+        options.main = (std::filesystem::absolute(argv[0]).parent_path() / "main").string();
+    }
+    std::string metrics_file =
+        (std::filesystem::temp_directory_path() / ("mood_thieves_bench." + std::to_string(getpid()) + ".json"))
+            .string();
+
+    printf("protocol,ranks,weapons,laboratories,weapon_us,laboratory_us,recharge_us,elapsed_s,entries,"
+           "entries_per_s,laboratory_p50_us,laboratory_p90_us,laboratory_p99_us,weapon_p50_us,weapon_p99_us,"
+           "messages_per_entry\n");
+    // Walk the cartesian product of the swept values, the last one changing fastest
+    size_t points = options.protocols.size() * options.ranks.size() * options.weapons.size() *
+                    options.laboratories.size() * options.weapon_us.size() * options.laboratory_us.size() *
+                    options.recharge_us.size();
+    int status = 0;
+    for (size_t i = 0; i < points; i++)
+    {
+        size_t rest = i;
+        auto pick = [&rest](const auto &values)
+        {
+            auto value = values[rest % values.size()];
+            rest /= values.size();
+            return value;
+        };
+        Point point;
+        point.recharge_us = pick(options.recharge_us);
+        point.laboratory_us = pick(options.laboratory_us);
+        point.weapon_us = pick(options.weapon_us);
+        point.laboratories = pick(options.laboratories);
+        point.weapons = pick(options.weapons);
+        point.ranks = pick(options.ranks);
+        point.protocol = pick(options.protocols);
+        if (run(options, point, metrics_file) == -1)
+        {
+            status = 1;
+        }
+    }
+    std::filesystem::remove(metrics_file);
+    return status;
+}
@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <stdio.h>
+
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/simulator.hpp"
+#include "mood_thieves/utils.hpp"
+
+/**
+ * Measures requesting the laboratory before the roam ends.
+ *
+ * K = 16 thieves share 8 weapons and 4 laboratories in the simulator over a constant latency of 50 us to
+ * 1 ms. A laboratory requested at the end of the roam waits at least a round trip for its ACKs, requested
+ * one round trip or the whole roam earlier the ACKs arrive meanwhile. For every latency, lead and a victim
+ * found by every roam or by half of them it reports the virtual time of a thief per laboratory entry, the
+ * laboratory acquisition latency from its request and the WITHDRAW messages per entry.
+ *
+ * Usage: lab_lead [--protocol=broadcast] [--name=value ...]
+ */
+
+int main(int argc, char **argv)
+{
+    mood_thieves::Config base;
+    base.thieves = 16;
+    base.weapons = 8;
+    base.laboratories = 4;
+    base.weapon_us = 4000;
+    base.laboratory_us = 1000;
+    base.recharge_us = 5000;
+    base.entries = 20;
+    if (mood_thieves::parse_config(argc, argv, base) == -1)
+    {
+        return 1;
+    }
+
+    printf("%10s %10s %8s %14s %14s %14s %12s %10s\n", "latency", "lead(us)", "victim", "cycle(ms)",
+           "acquire(ms)", "p99(ms)", "withdraws", "violations");
+    for (int latency_us : {50, 250, 1000})
+    {
+        for (double victim : {1.0, 0.5})
+        {
+            for (int lead_us : {0, 2 * latency_us, base.weapon_us})
+            {
+                mood_thieves::Config config = base;
+                config.latency = {mood_thieves::LatencyDistribution::CONSTANT, static_cast<double>(latency_us), 0};
+                config.lab_lead_us = std::min(lead_us, config.weapon_us);
+                config.victim_probability = victim;
+                mood_thieves::Simulator simulator(config);
+                simulator.run();
+
+                const mood_thieves::Metrics &metrics = simulator.getMetrics();
+                int entries = config.thieves * config.entries;
+                mood_thieves::HistogramSummary acquire = metrics.summary(mood_thieves::Metrics::ACQUIRE_LABORATORY);
+                double mean_ms = acquire.count > 0 ? static_cast<double>(acquire.sum) / acquire.count / 1e6 : 0;
+                printf("%10d %10d %8.2f %14.3f %14.3f %14.3f %12.1f %10ld\n", latency_us, config.lab_lead_us,
+                       victim, simulator.virtualNs() / 1e6 / config.entries, mean_ms, acquire.percentile(0.99) / 1e6,
+                       static_cast<double>(metrics.sentCount(mood_thieves::utils::MessageType::WITHDRAW)) / entries,
+                       simulator.violationCount());
+            }
+        }
+    }
+    return 0;
+}
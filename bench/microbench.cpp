@@ -0,0 +1,300 @@
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <mpi.h>
+#include <thread>
+#include <vector>
+
+#include "mood_thieves/lamport_queue.hpp"
+#include "mood_thieves/request_table.hpp"
+#include "mood_thieves/spsc_queue.hpp"
+#include "mood_thieves/utils.hpp"
+
+/**
+ * Google Benchmark suite of the primitives on the hot path of a thief.
+ *
+ * The request queue of the broadcast protocol for K = 16..4096 thieves, the Lamport clock advanced by 1 to 3
+ * threads at once, packing a batch of messages into the wire format and with MPI_Pack over the batch
+ * datatype, the command ring between the threads of a thief and the wakeups the receiver and the business
+ * logic exchange. Takes the options of Google Benchmark, --benchmark_format=json prints results to diff.
+ *
+ * Usage: microbench [--benchmark_filter=REGEX] [--benchmark_out=FILE --benchmark_out_format=json]
+ */
+
+namespace
+{
+
+using mood_thieves::LamportQueue;
+using mood_thieves::RequestTable;
+namespace utils = mood_thieves::utils;
+
+const int CAPACITY = 2;
+
+/**
+ * Fills a queue with a request of every thief, thief i asking at clock i.
+ */
+void fill(LamportQueue &queue, int size)
+{
+    for (int thief_id = 0; thief_id < size; thief_id++)
+    {
+        queue.receiveRequest(thief_id, thief_id);
+    }
+}
+
+/**
+ * The oldest request is released and its thief asks again with the newest clock, one REQUEST and RELEASE.
+ */
+void BM_QueueRequestRelease(benchmark::State &state)
+{
+    int size = state.range(0);
+    LamportQueue queue(0, size, CAPACITY);
+    fill(queue, size);
+    int clock = size;
+    for (auto _ : state)
+    {
+        int thief_id = clock % (size - 1) + 1;
+        queue.receiveRelease(thief_id, clock);
+        benchmark::DoNotOptimize(queue.receiveRequest(thief_id, clock));
+        clock++;
+    }
+}
+BENCHMARK(BM_QueueRequestRelease)->RangeMultiplier(4)->Range(16, 4096);
+
+/**
+ * Checks whether the own pending request may enter, acknowledged by everyone and queued among others.
+ */
+void BM_QueueCanEnter(benchmark::State &state)
+{
+    int size = state.range(0);
+    LamportQueue queue(0, size, CAPACITY);
+    fill(queue, size);
+    queue.request(size);
+    queue.receiveRequest(0, size);
+    for (int thief_id = 0; thief_id < size; thief_id++)
+    {
+        queue.receiveAck(thief_id, size);
+    }
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(queue.canEnter());
+    }
+}
+BENCHMARK(BM_QueueCanEnter)->RangeMultiplier(4)->Range(16, 4096);
+
+/**
+ * Counts the requests older than a key, once per own request, over a table of two slots per thief.
+ */
+void BM_TableCountBefore(benchmark::State &state)
+{
+    int size = state.range(0);
+    RequestTable table(size);
+    for (int thief_id = 0; thief_id < size; thief_id++)
+    {
+        table.insert(thief_id, thief_id);
+    }
+    uint64_t key = RequestTable::key(size / 2, 0);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(table.countBefore(key));
+    }
+}
+BENCHMARK(BM_TableCountBefore)->RangeMultiplier(4)->Range(16, 4096);
+
+utils::LamportClock shared_clock(0);
+
+/**
+ * Increments of the clock a message is stamped with, contended by every benchmark thread.
+ */
+void BM_ClockIncrement(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(shared_clock.increment());
+    }
+}
+BENCHMARK(BM_ClockIncrement)->ThreadRange(1, 3)->UseRealTime();
+
+/**
+ * Updates of the clock with the clock of a received message, contended by every benchmark thread.
+ */
+void BM_ClockReceive(benchmark::State &state)
+{
+    int other = 0;
+    for (auto _ : state)
+    {
+        other += 2;
+        benchmark::DoNotOptimize(shared_clock.receive(other));
+    }
+}
+BENCHMARK(BM_ClockReceive)->ThreadRange(1, 3)->UseRealTime();
+
+std::vector<utils::message_t> batch_messages(int count)
+{
+    std::vector<utils::message_t> messages(count);
+    for (int i = 0; i < count; i++)
+    {
+        messages[i] = {utils::MessageType::REQUEST, {i, i * 3, utils::ResourceType::WEAPON, 0}, i + 1};
+    }
+    return messages;
+}
+
+/**
+ * Packs a batch of messages into the 16-byte wire entries handed to MPI.
+ */
+void BM_PackBatch(benchmark::State &state)
+{
+    std::vector<utils::message_t> messages = batch_messages(state.range(0));
+    std::vector<utils::wire_message_t> wire(messages.size());
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < messages.size(); i++)
+        {
+            wire[i] = utils::pack(messages[i]);
+        }
+        benchmark::DoNotOptimize(wire.data());
+    }
+    state.SetItemsProcessed(state.iterations() * messages.size());
+}
+BENCHMARK(BM_PackBatch)->RangeMultiplier(4)->Range(1, 64);
+
+/**
+ * Copies a batch of wire entries through MPI_Pack and MPI_Unpack over the batch datatype.
+ */
+void BM_MpiPackBatch(benchmark::State &state)
+{
+    int count = state.range(0);
+    std::vector<utils::message_t> messages = batch_messages(count);
+    std::vector<utils::wire_message_t> wire(count), unpacked(count);
+    for (int i = 0; i < count; i++)
+    {
+        wire[i] = utils::pack(messages[i]);
+    }
+    MPI_Datatype batch_type;
+    utils::initialize_batch_type(batch_type);
+    int buffer_size;
+    MPI_Pack_size(count, batch_type, MPI_COMM_WORLD, &buffer_size);
+    std::vector<char> buffer(buffer_size);
+    for (auto _ : state)
+    {
+        int position = 0;
+        MPI_Pack(wire.data(), count, batch_type, buffer.data(), buffer_size, &position, MPI_COMM_WORLD);
+        position = 0;
+        MPI_Unpack(buffer.data(), buffer_size, &position, unpacked.data(), count, batch_type, MPI_COMM_WORLD);
+        benchmark::DoNotOptimize(unpacked.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    MPI_Type_free(&batch_type);
+}
+BENCHMARK(BM_MpiPackBatch)->RangeMultiplier(4)->Range(1, 64);
+
+/**
+ * A command through the ring from the business logic to the receiver and back out.
+ */
+void BM_CommandRing(benchmark::State &state)
+{
+    mood_thieves::SpscQueue<int64_t> ring(16);
+    int64_t value = 0;
+    for (auto _ : state)
+    {
+        ring.push(value);
+        ring.pop(value);
+        benchmark::DoNotOptimize(value);
+    }
+}
+BENCHMARK(BM_CommandRing);
+
+/**
+ * Round trip of two wakeups through atomic waits, the receiver granting a unit to the business logic.
+ */
+void BM_GrantWakeup(benchmark::State &state)
+{
+    std::atomic<uint32_t> granted{0}, acknowledged{0};
+    std::atomic<bool> stop{false};
+    std::thread peer(
+        [&]
+        {
+            uint32_t seen = 0;
+            while (true)
+            {
+                granted.wait(seen, std::memory_order_acquire);
+                seen = granted.load(std::memory_order_acquire);
+                if (stop.load())
+                {
+                    return;
+                }
+                acknowledged.store(seen, std::memory_order_release);
+                acknowledged.notify_one();
+            }
+        });
+    uint32_t round = 0;
+    for (auto _ : state)
+    {
+        round++;
+        granted.store(round, std::memory_order_release);
+        granted.notify_one();
+        uint32_t seen = acknowledged.load(std::memory_order_acquire);
+        while (seen != round)
+        {
+            acknowledged.wait(seen, std::memory_order_acquire);
+            seen = acknowledged.load(std::memory_order_acquire);
+        }
+    }
+    stop.store(true);
+    granted.store(round + 1, std::memory_order_release);
+    granted.notify_one();
+    peer.join();
+}
+BENCHMARK(BM_GrantWakeup)->UseRealTime();
+
+/**
+ * Round trip of two wakeups through doorbells, a command queued for a receiver sleeping between polls.
+ */
+void BM_DoorbellWakeup(benchmark::State &state)
+{
+    utils::Doorbell ping, pong;
+    std::atomic<bool> stop{false};
+    std::thread peer(
+        [&]
+        {
+            uint32_t seen = 0;
+            while (!stop.load())
+            {
+                while (ping.rings() == seen && !stop.load())
+                {
+                    ping.sleep(seen, std::chrono::microseconds(1000));
+                }
+                seen = ping.rings();
+                pong.ring();
+            }
+        });
+    for (auto _ : state)
+    {
+        uint32_t seen = pong.rings();
+        ping.ring();
+        while (pong.rings() == seen)
+        {
+            pong.sleep(seen, std::chrono::microseconds(1000));
+        }
+    }
+    stop.store(true);
+    ping.ring();
+    peer.join();
+}
+BENCHMARK(BM_DoorbellWakeup)->UseRealTime();
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        MPI_Finalize();
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <deque>
+#include <queue>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#include "mood_thieves/maekawa.hpp"
+#include "mood_thieves/ricart_agrawala.hpp"
+#include "mood_thieves/utils.hpp"
+
+/**
+ * Compares the messages per acquisition of the broadcast, Ricart-Agrawala and Maekawa protocols.
+ *
+ * The protocol state machines run in-process on a single pool, every thief requests again right after
+ * releasing and the messages are delivered in random order that keeps every channel FIFO.
+ * The broadcast protocol is given analytically since its state lives in MoodThieve.
+ */
+
+namespace
+{
+
+struct Message
+{
+    int type;
+    int from;
+    int clock;
+    int value;
+};
+
+/**
+ * Random delivery of FIFO channels.
+ */
+class Network
+{
+public:
+    explicit Network(int size) : size(size), channels(size * size) {}
+
+    void send(int from, int to, const Message &message)
+    {
+        auto &channel = channels[from * size + to];
+        if (channel.empty())
+        {
+            active.push_back({from, to});
+        }
+        channel.push_back(message);
+        sent++;
+    }
+
+    bool receive(std::mt19937 &random, int &to, Message &message)
+    {
+        if (active.empty())
+        {
+            return false;
+        }
+        size_t index = std::uniform_int_distribution<size_t>(0, active.size() - 1)(random);
+        auto key = active[index];
+        auto &channel = channels[key.first * size + key.second];
+        message = channel.front();
+        channel.pop_front();
+        to = key.second;
+        if (channel.empty())
+        {
+            active[index] = active.back();
+            active.pop_back();
+        }
+        return true;
+    }
+
+    long sent = 0;
+
+private:
+    int size;
+    std::vector<std::deque<Message>> channels;
+    std::vector<std::pair<int, int>> active;
+};
+
+struct Result
+{
+    double messages_per_entry;
+    int max_holders;
+};
+
+/**
+ * Runs thieves that request again right after releasing until the given number of entries.
+ * A thief holds the unit for as many deliveries as there are thieves.
+ *
+ * @param size The total number of thieves.
+ * @param entries The number of entries to run for.
+ * @param seed The seed of the delivery order.
+ * @param request Starts a request of a thief.
+ * @param receive Delivers a message to a thief.
+ * @param can_enter Checks whether a thief can enter.
+ * @param enter Enters a thief.
+ * @param release Releases the unit of a thief.
+ * @param network The network the callbacks send on.
+ */
+template <class Request, class Receive, class CanEnter, class Enter, class Release>
+Result run(int size, int entries, unsigned seed, Request request, Receive receive, CanEnter can_enter, Enter enter,
+           Release release, Network &network)
+{
+    std::mt19937 random(seed);
+    std::priority_queue<std::pair<long, int>, std::vector<std::pair<long, int>>, std::greater<>> holding;
+    for (int i = 0; i < size; i++)
+    {
+        request(i);
+    }
+
+    long step = 0;
+    int done = 0, max_holders = 0;
+    Message message;
+    int to;
+    while (done < entries)
+    {
+        step++;
+        // Holding thieves keep the time going while the network is idle, a deadlock ends the run
+        if (network.receive(random, to, message))
+        {
+            receive(to, message);
+            if (can_enter(to))
+            {
+                enter(to);
+                holding.push({step + size, to});
+                max_holders = std::max(max_holders, static_cast<int>(holding.size()));
+                done++;
+            }
+        }
+        else if (holding.empty())
+        {
+            break;
+        }
+        else
+        {
+            step = holding.top().first;
+        }
+        while (!holding.empty() && holding.top().first <= step)
+        {
+            int thief = holding.top().second;
+            holding.pop();
+            release(thief);
+            request(thief);
+        }
+    }
+    return {static_cast<double>(network.sent) / std::max(done, 1), max_holders};
+}
+
+Result run_maekawa(int size, int units, int entries, unsigned seed)
+{
+    std::vector<mood_thieves::Maekawa> thieves;
+    std::vector<int> clocks(size, 0);
+    for (int i = 0; i < size; i++)
+    {
+        thieves.emplace_back(i, size, units);
+    }
+    Network network(size);
+    auto send = [&](int from, const std::vector<mood_thieves::Maekawa::Action> &actions)
+    {
+        clocks[from]++;
+        for (auto &action : actions)
+        {
+            int clock = action.message_type == mood_thieves::utils::REQUEST ? thieves[from].requestClock()
+                                                                            : clocks[from];
+            network.send(from, action.thief_id, {action.message_type, from, clock, action.unit});
+        }
+    };
+    return run(
+        size, entries, seed, [&](int i) { send(i, thieves[i].request(++clocks[i])); },
+        [&](int to, const Message &message)
+        {
+            clocks[to] = std::max(clocks[to], message.clock) + 1;
+            send(to, thieves[to].receive(message.type, message.from, message.clock, message.value));
+        },
+        [&](int i) { return thieves[i].canEnter(); }, [&](int i) { thieves[i].enter(); },
+        [&](int i) { send(i, thieves[i].release()); }, network);
+}
+
+Result run_ricart_agrawala(int size, int units, int entries, unsigned seed)
+{
+    std::vector<mood_thieves::RicartAgrawala> thieves;
+    std::vector<int> clocks(size, 0);
+    for (int i = 0; i < size; i++)
+    {
+        thieves.emplace_back(i, size, units, 1);
+    }
+    Network network(size);
+    return run(
+        size, entries, seed,
+        [&](int i)
+        {
+            int clock = ++clocks[i];
+            for (int to : thieves[i].request(clock))
+            {
+                network.send(i, to, {mood_thieves::utils::REQUEST, i, clock, 0});
+            }
+        },
+        [&](int to, const Message &message)
+        {
+            clocks[to] = std::max(clocks[to], message.clock) + 1;
+            if (message.type == mood_thieves::utils::REQUEST)
+            {
+                int granted = thieves[to].receiveRequest(message.from, message.clock);
+                if (granted > 0)
+                {
+                    network.send(to, message.from, {mood_thieves::utils::ACK, to, ++clocks[to], granted});
+                }
+                return;
+            }
+            for (int recipient : thieves[to].receiveAck(message.from, message.value))
+            {
+                network.send(to, recipient, {mood_thieves::utils::REQUEST, to, thieves[to].requestClock(), 0});
+            }
+        },
+        [&](int i) { return thieves[i].canEnter(); }, [&](int i) { thieves[i].enter(); },
+        [&](int i)
+        {
+            for (auto &[recipient, granted] : thieves[i].release())
+            {
+                network.send(i, recipient, {mood_thieves::utils::ACK, i, ++clocks[i], granted});
+            }
+        },
+        network);
+}
+
+bool quorums_intersect(int size)
+{
+    std::vector<std::vector<int>> quorums;
+    for (int i = 0; i < size; i++)
+    {
+        quorums.push_back(mood_thieves::grid_quorum(i, size));
+    }
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = i + 1; j < size; j++)
+        {
+            std::vector<int> common;
+            std::set_intersection(quorums[i].begin(), quorums[i].end(), quorums[j].begin(), quorums[j].end(),
+                                  std::back_inserter(common));
+            if (common.empty())
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main()
+{
+    const int units = 2;
+    const int entries = 2000;
+
+    printf("%6s %8s %12s %16s %16s %10s %10s %10s\n", "K", "quorum", "intersect", "broadcast(3K)", "ricart-agrawala",
+           "maekawa", "ra-max", "mk-max");
+    for (int size = 16; size <= 256; size *= 2)
+    {
+        double quorum = 0;
+        for (int i = 0; i < size; i++)
+        {
+            quorum += mood_thieves::grid_quorum(i, size).size();
+        }
+        quorum /= size;
+
+        Result ra = run_ricart_agrawala(size, units, entries, size);
+        Result maekawa = run_maekawa(size, units, entries, size);
+        printf("%6d %8.1f %12s %16d %16.1f %10.1f %10d %10d\n", size, quorum, quorums_intersect(size) ? "yes" : "NO",
+               3 * size, ra.messages_per_entry, maekawa.messages_per_entry, ra.max_holders, maekawa.max_holders);
+    }
+    return 0;
+}
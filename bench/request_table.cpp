@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#include "mood_thieves/request_table.hpp"
+#include "mood_thieves/utils.hpp"
+
+/**
+ * Measures the request table of the broadcast protocol against the sorted vector it replaced.
+ *
+ * K thieves keep a request each in the queue. Every round the oldest request is released and its thief
+ * requests again with a newer clock, then thief 0, the one owning the queue, checks whether its request is
+ * among the first capacity ones. It reports the nanoseconds of a REQUEST, a RELEASE and a check for K up to
+ * 4096, and the count the table runs once per own request with the scalar and the AVX2 loop.
+ */
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+const int CAPACITY = 2;
+
+/**
+ * The queue the broadcast protocol kept before, requests ordered by (clock, id) in a vector.
+ */
+class SortedQueue
+{
+public:
+    void insert(int thief_id, int clock)
+    {
+        mood_thieves::utils::message_data_t request = {thief_id, clock, 0, 0};
+        queue.insert(std::upper_bound(queue.begin(), queue.end(), request, before), request);
+    }
+
+    void removeOldest(int thief_id)
+    {
+        auto it = std::find_if(queue.begin(), queue.end(),
+                               [thief_id](const mood_thieves::utils::message_data_t &m) { return m.id == thief_id; });
+        if (it != queue.end())
+        {
+            queue.erase(it);
+        }
+    }
+
+    bool canEnter(int thief_id, int clock) const
+    {
+        int position = std::min<int>(CAPACITY, queue.size());
+        return std::any_of(queue.begin(), queue.begin() + position,
+                           [thief_id, clock](const mood_thieves::utils::message_data_t &m)
+                           { return m.id == thief_id && m.clock == clock; });
+    }
+
+private:
+    static bool before(const mood_thieves::utils::message_data_t &a, const mood_thieves::utils::message_data_t &b)
+    {
+        return a.clock == b.clock ? a.id < b.id : a.clock < b.clock;
+    }
+
+    std::vector<mood_thieves::utils::message_data_t> queue;
+};
+
+/**
+ * The queue of the broadcast protocol now.
+ */
+class TableQueue
+{
+public:
+    explicit TableQueue(int size) : table(size) {}
+
+    void insert(int thief_id, int clock)
+    {
+        if (thief_id == 0)
+        {
+            table.watch(mood_thieves::RequestTable::key(clock, thief_id));
+        }
+        table.insert(thief_id, clock);
+    }
+
+    void removeOldest(int thief_id) { table.remove(thief_id, table.oldest(thief_id)); }
+
+    bool canEnter(int thief_id, int clock) const
+    {
+        uint64_t key = mood_thieves::RequestTable::key(clock, thief_id);
+        return table.contains(thief_id, key) && table.countBefore(key) < CAPACITY;
+    }
+
+private:
+    mood_thieves::RequestTable table;
+};
+
+struct Result
+{
+    double request_ns; ///< Nanoseconds of queueing a request.
+    double release_ns; ///< Nanoseconds of removing the oldest request of a thief.
+    double check_ns;   ///< Nanoseconds of checking whether a request may enter.
+};
+
+double elapsed_ns(Clock::time_point start, int operations)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / operations;
+}
+
+/**
+ * Runs the rounds on a queue, the clocks of the requests keep their release order.
+ */
+template <typename Queue> Result run(Queue &queue, int size, int rounds)
+{
+    std::vector<int> clocks(size);
+    for (int thief_id = 0; thief_id < size; thief_id++)
+    {
+        clocks[thief_id] = thief_id;
+        queue.insert(thief_id, clocks[thief_id]);
+    }
+
+    // The oldest request is always the one of the thief released size rounds ago
+    int clock = size;
+    Result result = {0, 0, 0};
+    int entered = 0;
+    for (int round = 0; round < rounds; round++)
+    {
+        int thief_id = round % size;
+        Clock::time_point start = Clock::now();
+        queue.removeOldest(thief_id);
+        result.release_ns += elapsed_ns(start, rounds);
+
+        start = Clock::now();
+        clocks[thief_id] = clock++;
+        queue.insert(thief_id, clocks[thief_id]);
+        result.request_ns += elapsed_ns(start, rounds);
+
+        start = Clock::now();
+        entered += queue.canEnter(0, clocks[0]);
+        result.check_ns += elapsed_ns(start, rounds);
+    }
+    if (entered < 0)
+    {
+        printf("unreachable\n");
+    }
+    return result;
+}
+
+/**
+ * Times the count alone over a table of size thieves with two slots each, half of them free.
+ */
+double run_count(int size, bool vectorized, int rounds, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::vector<uint64_t> keys(size * 2, mood_thieves::RequestTable::FREE);
+    for (int thief_id = 0; thief_id < size; thief_id++)
+    {
+        keys[thief_id * 2] = mood_thieves::RequestTable::key(random() % (size * 4), thief_id);
+    }
+    long smaller = 0;
+    Clock::time_point start = Clock::now();
+    for (int round = 0; round < rounds; round++)
+    {
+        uint64_t key = keys[(round % size) * 2];
+        smaller += vectorized ? mood_thieves::RequestTable::countLess(keys.data(), keys.size(), key)
+                              : mood_thieves::RequestTable::countLessScalar(keys.data(), keys.size(), key);
+    }
+    double result = elapsed_ns(start, rounds);
+    if (smaller < 0)
+    {
+        printf("unreachable\n");
+    }
+    return result;
+}
+
+} // namespace
+
+int main()
+{
+    const int rounds = 200000;
+
+    printf("AVX2 count: %s\n", mood_thieves::RequestTable::vectorized() ? "yes" : "no, scalar fallback");
+    printf("%8s %6s %12s %12s %12s\n", "queue", "K", "request(ns)", "release(ns)", "check(ns)");
+    for (int size = 16; size <= 4096; size *= 4)
+    {
+        SortedQueue sorted;
+        Result result = run(sorted, size, rounds);
+        printf("%8s %6d %12.1f %12.1f %12.1f\n", "sorted", size, result.request_ns, result.release_ns,
+               result.check_ns);
+        TableQueue table(size);
+        result = run(table, size, rounds);
+        printf("%8s %6d %12.1f %12.1f %12.1f\n", "table", size, result.request_ns, result.release_ns,
+               result.check_ns);
+    }
+
+    printf("\n%6s %12s %12s\n", "K", "scalar(ns)", "avx2(ns)");
+    for (int size = 16; size <= 4096; size *= 2)
+    {
+        printf("%6d %12.1f %12.1f\n", size, run_count(size, false, rounds, size), run_count(size, true, rounds, size));
+    }
+    return 0;
+}
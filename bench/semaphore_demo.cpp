@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/distributed_semaphore.hpp"
+#include "mood_thieves/in_process_transport.hpp"
+
+/**
+ * Exercises the distributed semaphore over the in-process transport.
+ *
+ * K = 8 participants with two threads each share a pool of 4 weapons and one of 2 laboratories, a participant
+ * holds one laboratory at most. Every thread repeatedly takes a weapon with a guard and then a laboratory,
+ * one thread with try_guard_for and a timeout of 200 us, the other with acquire_async and the same deadline.
+ * A laboratory is held for 300 us, so the 16 threads contend enough for requests to time out and be withdrawn.
+ * The weapon is released 200 us later with release_after. Once every thread is done, every participant takes and
+ * returns a unit of every pool in turn, and as many participants as a pool has units try to take one at once.
+ * A unit not granted within a second leaked.
+ *
+ * For every protocol it reports the laboratory entries per second, the mean wait of a granted laboratory, the
+ * requests that timed out and were withdrawn, the times a pool had more holders than units and the leaked units.
+ * A weapon leaves the count when its delayed release is scheduled, so only the laboratories are checked exactly.
+ * It fails if any pool had more holders than units or leaked one.
+ *
+ * Usage: semaphore_demo [--thieves=8] [--weapons=4] [--laboratories=2] [--entries=200]
+ */
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct Counters
+{
+    std::atomic<int> in_use[2] = {};  ///< Holders of every pool.
+    std::atomic<long> entries = 0;    ///< Laboratories granted.
+    std::atomic<long> timeouts = 0;   ///< Laboratory requests withdrawn.
+    std::atomic<long> violations = 0; ///< Grants beyond the capacity of a pool.
+    std::atomic<long> wait_ns = 0;    ///< Summed wait of the granted laboratories.
+};
+
+void take(Counters &counters, int pool, int capacity)
+{
+    if (++counters.in_use[pool] > capacity)
+    {
+        counters.violations++;
+    }
+}
+
+void work(mood_thieves::DistributedSemaphore &semaphore, const mood_thieves::Config &config, Counters &counters,
+          bool asynchronous)
+{
+    const int weapons = semaphore.pool("weapons");
+    const int laboratories = semaphore.pool("laboratories");
+    const std::chrono::microseconds timeout(200);
+    for (int entry = 0; entry < config.entries; entry++)
+    {
+        mood_thieves::DistributedSemaphore::Guard weapon = semaphore.guard(weapons);
+        take(counters, weapons, config.weapons);
+
+        Clock::time_point requested = Clock::now();
+        mood_thieves::DistributedSemaphore::Guard laboratory;
+        bool granted = false;
+        if (asynchronous)
+        {
+            std::promise<bool> done;
+            semaphore.acquire_async(
+                laboratories, [&done](bool acquired) { done.set_value(acquired); }, requested + timeout);
+            granted = done.get_future().get();
+        }
+        else
+        {
+            laboratory = semaphore.try_guard_for(laboratories, timeout);
+            granted = static_cast<bool>(laboratory);
+        }
+        if (granted)
+        {
+            counters.wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - requested).count();
+            counters.entries++;
+            take(counters, laboratories, config.laboratories);
+            std::this_thread::sleep_for(std::chrono::microseconds(300));
+            counters.in_use[laboratories]--;
+            if (laboratory)
+            {
+                laboratory.release();
+            }
+            else
+            {
+                semaphore.release(laboratories);
+            }
+        }
+        else
+        {
+            counters.timeouts++;
+        }
+
+        counters.in_use[weapons]--;
+        weapon.release_after(std::chrono::microseconds(200));
+    }
+}
+
+/**
+ * @return The units of a pool that are no longer granted within a second.
+ */
+int leaked(std::vector<std::unique_ptr<mood_thieves::DistributedSemaphore>> &semaphores, int pool, int capacity,
+           mood_thieves::Protocol protocol)
+{
+    // A unit stuck with its arbiters blocks the requests for it, every participant takes one after the other
+    int failed = 0;
+    for (auto &semaphore : semaphores)
+    {
+        failed += semaphore->try_guard_for(pool, std::chrono::seconds(1)) ? 0 : 1;
+    }
+    // Maekawa asks for one unit per request, two takers may wait for the same one while the other is free
+    if (failed > 0 || protocol == mood_thieves::Protocol::MAEKAWA)
+    {
+        return std::min(failed, capacity);
+    }
+
+    // A unit lost from the count shows once every unit is taken at once
+    std::vector<mood_thieves::DistributedSemaphore::Guard> guards(capacity);
+    std::vector<std::thread> takers;
+    for (int unit = 0; unit < capacity; unit++)
+    {
+        takers.emplace_back(
+            [&, unit]
+            {
+                guards[unit] = semaphores[unit % semaphores.size()]->try_guard_for(pool, std::chrono::seconds(1));
+            });
+    }
+    for (std::thread &taker : takers)
+    {
+        taker.join();
+    }
+    return static_cast<int>(
+        std::count_if(guards.begin(), guards.end(), [](const auto &guard) { return !static_cast<bool>(guard); }));
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    mood_thieves::Config base;
+    base.thieves = 8;
+    base.weapons = 4;
+    base.laboratories = 2;
+    base.entries = 200;
+    if (mood_thieves::parse_config(argc, argv, base) == -1)
+    {
+        return 1;
+    }
+
+    const char *protocols[] = {"broadcast", "ricart-agrawala", "maekawa", "suzuki-kasami"};
+    std::vector<mood_thieves::SemaphorePool> pools = {{"weapons", base.weapons, 0},
+                                                      {"laboratories", base.laboratories, 1}};
+
+    long failures = 0;
+    printf("%16s %12s %14s %10s %10s %8s\n", "protocol", "entries/s", "lab wait(us)", "timeouts", "violations",
+           "leaked");
+    for (int protocol = 0; protocol < 4; protocol++)
+    {
+        Counters counters;
+        mood_thieves::InProcessNetwork network(base.thieves);
+        std::vector<std::unique_ptr<mood_thieves::InProcessTransport>> transports;
+        std::vector<std::unique_ptr<mood_thieves::DistributedSemaphore>> semaphores;
+        for (int id = 0; id < base.thieves; id++)
+        {
+            transports.push_back(std::make_unique<mood_thieves::InProcessTransport>(network, id));
+            semaphores.push_back(std::make_unique<mood_thieves::DistributedSemaphore>(
+                *transports[id], id, base.thieves, static_cast<mood_thieves::Protocol>(protocol), pools));
+        }
+
+        Clock::time_point start = Clock::now();
+        std::vector<std::thread> participants;
+        for (int id = 0; id < base.thieves; id++)
+        {
+            participants.emplace_back(
+                [&, id]
+                {
+                    std::thread other(work, std::ref(*semaphores[id]), std::cref(base), std::ref(counters), true);
+                    work(*semaphores[id], base, counters, false);
+                    other.join();
+                });
+        }
+        for (std::thread &participant : participants)
+        {
+            participant.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        // Let the delayed releases run, then every unit has to be free again
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        auto kind = static_cast<mood_thieves::Protocol>(protocol);
+        int leaked_units = leaked(semaphores, semaphores[0]->pool("weapons"), base.weapons, kind) +
+                           leaked(semaphores, semaphores[0]->pool("laboratories"), base.laboratories, kind);
+        participants.clear();
+        for (int id = 0; id < base.thieves; id++)
+        {
+            participants.emplace_back([&, id] { semaphores[id]->finish(); });
+        }
+        for (std::thread &participant : participants)
+        {
+            participant.join();
+        }
+        semaphores.clear();
+
+        long entries = counters.entries;
+        printf("%16s %12.1f %14.1f %10ld %10ld %8d\n", protocols[protocol], entries / seconds,
+               entries > 0 ? counters.wait_ns / 1e3 / entries : 0.0, counters.timeouts.load(),
+               counters.violations.load(), leaked_units);
+        failures += counters.violations + leaked_units;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/simulator.hpp"
+
+/**
+ * Measures splitting the pools into shards arbitrated by their subscribers only.
+ *
+ * K thieves share 8 weapons and 8 laboratories in the simulator, split into M = 1, 4 and 8 shards. Every
+ * thief subscribes to two shards and requests from the less loaded one, a message costs its receiver --handle-ns
+ * of virtual time. For K = 64..256 it reports the messages per laboratory entry, the laboratory entries per
+ * virtual second as the utilization the sharding keeps and the weapon acquisition latency in virtual time.
+ * It fails if any run let more thieves into a shard than it has units.
+ *
+ * Usage: shard_sweep [--protocol=broadcast] [--handle-ns=20000] [--name=value ...]
+ */
+
+int main(int argc, char **argv)
+{
+    mood_thieves::Config base;
+    base.weapons = 8;
+    base.laboratories = 8;
+    base.weapon_us = 1000;
+    base.laboratory_us = 3000;
+    base.recharge_us = 5000;
+    base.entries = 5;
+    base.handle_ns = 20000;
+    base.latency = {mood_thieves::LatencyDistribution::EXPONENTIAL, 50, 50};
+    if (mood_thieves::parse_config(argc, argv, base) == -1)
+    {
+        return 1;
+    }
+    if (base.protocol == mood_thieves::Protocol::RMA)
+    {
+        fprintf(stderr, "[ERROR]: The rma protocol exchanges no messages to simulate\n");
+        return 1;
+    }
+
+    long violations = 0;
+    printf("%6s %8s %12s %12s %14s %14s %10s\n", "K", "shards", "msgs/entry", "entries/s", "acquire(ms)",
+           "p99(ms)", "violations");
+    for (int size = 64; size <= 256; size *= 2)
+    {
+        for (int shards : {1, 4, 8})
+        {
+            mood_thieves::Config config = base;
+            config.thieves = size;
+            config.shards = shards;
+            mood_thieves::Simulator simulator(config);
+            simulator.run();
+
+            const mood_thieves::Metrics &metrics = simulator.getMetrics();
+            int entries = size * config.entries;
+            double messages = 0;
+            for (int type = 0; type < mood_thieves::Metrics::MESSAGE_TYPES; type++)
+            {
+                messages += static_cast<double>(metrics.sentCount(type)) / entries;
+            }
+            mood_thieves::HistogramSummary acquire = metrics.summary(mood_thieves::Metrics::ACQUIRE_WEAPON);
+            double mean_ms = acquire.count > 0 ? static_cast<double>(acquire.sum) / acquire.count / 1e6 : 0;
+            printf("%6d %8d %12.1f %12.1f %14.2f %14.2f %10ld\n", size, shards, messages,
+                   entries / (simulator.virtualNs() / 1e9), mean_ms, acquire.percentile(0.99) / 1e6,
+                   simulator.violationCount());
+            violations += simulator.violationCount();
+        }
+    }
+    return violations == 0 ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "mood_thieves/timer_wheel.hpp"
+#include "mood_thieves/utils.hpp"
+
+/**
+ * Measures the cost of a weapon recharge timer on the timer wheel against a thread per timer.
+ *
+ * For every number of pending timers it reports the wall time of scheduling a timer, the CPU time of the whole
+ * process per timer until all timers ran and how late the timers ran behind their deadline.
+ */
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct Result
+{
+    double schedule_ns;  ///< Wall time of scheduling a single timer.
+    double cpu_us;       ///< Process CPU time per timer until all of them ran.
+    double mean_late_ms; ///< Mean lateness behind the deadline.
+    double max_late_ms;  ///< Maximum lateness behind the deadline.
+};
+
+/**
+ * Schedules the timers with random delays up to max_delay_ms and waits until all of them ran.
+ */
+Result run_wheel(int timers, int max_delay_ms, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> delays(1, max_delay_ms);
+    std::vector<double> late(timers);
+    std::atomic<int> done{0};
+
+    mood_thieves::TimerWheel wheel;
+    double cpu = mood_thieves::utils::process_cpu_time();
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < timers; i++)
+    {
+        std::chrono::milliseconds delay(delays(random));
+        Clock::time_point deadline = Clock::now() + delay;
+        wheel.schedule(delay,
+                       [&, i, deadline]
+                       {
+                           late[i] = std::chrono::duration<double, std::milli>(Clock::now() - deadline).count();
+                           done++;
+                       });
+    }
+    double schedule_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / timers;
+    while (done.load() < timers)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    cpu = mood_thieves::utils::process_cpu_time() - cpu;
+
+    double sum = 0;
+    for (double value : late)
+    {
+        sum += value;
+    }
+    return {schedule_ns, cpu * 1e6 / timers, sum / timers, *std::max_element(late.begin(), late.end())};
+}
+
+/**
+ * Starts a sleeping thread per timer like the weapon recharge used to and joins all of them.
+ */
+Result run_threads(int timers, int max_delay_ms, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> delays(1, max_delay_ms);
+    std::vector<double> late(timers);
+    std::vector<std::thread> threads;
+    threads.reserve(timers);
+
+    double cpu = mood_thieves::utils::process_cpu_time();
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < timers; i++)
+    {
+        std::chrono::milliseconds delay(delays(random));
+        Clock::time_point deadline = Clock::now() + delay;
+        threads.emplace_back(
+            [&late, i, delay, deadline]
+            {
+                std::this_thread::sleep_for(delay);
+                late[i] = std::chrono::duration<double, std::milli>(Clock::now() - deadline).count();
+            });
+    }
+    double schedule_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / timers;
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    cpu = mood_thieves::utils::process_cpu_time() - cpu;
+
+    double sum = 0;
+    for (double value : late)
+    {
+        sum += value;
+    }
+    return {schedule_ns, cpu * 1e6 / timers, sum / timers, *std::max_element(late.begin(), late.end())};
+}
+
+void print(const char *name, int timers, int max_delay_ms, const Result &result)
+{
+    printf("%8s %8d %10d %14.0f %12.2f %14.3f %14.3f\n", name, timers, max_delay_ms, result.schedule_ns,
+           result.cpu_us, result.mean_late_ms, result.max_late_ms);
+}
+
+} // namespace
+
+int main()
+{
+    const int max_delay_ms = 2000;
+
+    printf("%8s %8s %10s %14s %12s %14s %14s\n", "service", "timers", "delay(ms)", "schedule(ns)", "cpu(us)",
+           "mean-late(ms)", "max-late(ms)");
+    for (int timers = 1000; timers <= 1000000; timers *= 10)
+    {
+        print("wheel", timers, max_delay_ms, run_wheel(timers, max_delay_ms, timers));
+    }
+    for (int timers = 100; timers <= 10000; timers *= 10)
+    {
+        print("threads", timers, max_delay_ms, run_threads(timers, max_delay_ms, timers));
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/lamport_queue.hpp"
+#include "mood_thieves/maekawa.hpp"
+#include "mood_thieves/ricart_agrawala.hpp"
+#include "mood_thieves/suzuki_kasami.hpp"
+#include "mood_thieves/utils.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * The arbitration of one resource of a thief under the configured protocol, without any locking.
+ *
+ * Wraps the state machine of the protocol and turns every state change into the messages it causes. Every
+ * host shares it: the receiving thread of MoodThieve, the simulator, the coroutine executor, the node leaders
+ * and the distributed semaphore, so the simulator checks the code the MPI thieves run.
+ */
+class Arbitration
+{
+public:
+    /**
+     * Sends a message about the resource: the identifier of the thief to send to, the message type,
+     * the Lamport clock of the message and its protocol specific value.
+     */
+    using Send = std::function<void(int thief_id, int message_type, int clock, int value)>;
+
+    /**
+     * Constructor
+     *
+     * @param protocol The arbitration protocol.
+     * @param id The identifier of the thief.
+     * @param size The total number of thieves.
+     * @param capacity The number of units in the pool.
+     * @param max_held The most units the thief holds at once, see RicartAgrawala.
+     * @param ack_horizon Pools queued ahead that hold back an ACK under the broadcast protocol, see LamportQueue.
+     */
+    Arbitration(Protocol protocol, int id, int size, int capacity, int max_held, int ack_horizon = 0);
+
+    /**
+     * Starts a request for a unit.
+     *
+     * @param clock The Lamport clock of the request.
+     * @param send Sends the resulting messages.
+     */
+    void request(int clock, const Send &send);
+
+    /**
+     * Releases the oldest held unit, under Suzuki-Kasami it may serve the pending request of the thief itself.
+     *
+     * @param clock The Lamport clock of the thief.
+     * @param send Sends the resulting messages.
+     */
+    void release(int clock, const Send &send);
+
+    /**
+     * Gives up the pending request before it entered. Under the broadcast protocol a WITHDRAW takes it out of
+     * every queue, the other protocols have no way back: the request is abandoned and its unit released as
+     * soon as it is granted, unless the next request of the thief takes it over first.
+     *
+     * @param clock The Lamport clock of the thief.
+     * @param send Sends the resulting messages.
+     */
+    void withdraw(int clock, const Send &send);
+
+    /**
+     * Handles a message about the resource, the clock has to be updated with the message already.
+     *
+     * @param message The received message.
+     * @param clock The Lamport clock of the thief, incremented before every reply.
+     * @param send Sends the resulting messages.
+     */
+    void receive(const utils::message_t &message, int &clock, const Send &send);
+
+    /**
+     * Handles the FINISH of a thief.
+     *
+     * @param thief_id The identifier of the finished thief.
+     */
+    void receiveFinish(int thief_id);
+
+    /**
+     * @return Whether the pending request can take a unit.
+     */
+    bool canEnter() const;
+
+    /**
+     * Takes the unit of the pending request.
+     */
+    void enter();
+
+    /**
+     * @return The number of requests of other thieves waiting in the local state.
+     */
+    int queueDepth() const;
+
+private:
+    /**
+     * Sends the messages resulting from a Maekawa state change.
+     */
+    static void sendMaekawa(const std::vector<Maekawa::Action> &actions, int request_clock, int clock,
+                            const Send &send);
+
+    /**
+     * Passes a token under the Suzuki-Kasami protocol to a thief, nowhere if it is -1.
+     */
+    void sendToken(int thief_id, int clock, const Send &send);
+
+    /**
+     * Handles a message about the resource for the state machine of the protocol.
+     */
+    void handle(const utils::message_t &message, int &clock, const Send &send);
+
+    /**
+     * Releases the unit of an abandoned request once it is granted.
+     */
+    void releaseAbandoned(int &clock, const Send &send);
+
+    int id;                              ///< The identifier of the thief.
+    int size;                            ///< The total number of thieves.
+    std::unique_ptr<LamportQueue> queue; ///< State under the broadcast protocol.
+    std::unique_ptr<RicartAgrawala> ra;  ///< State under the Ricart-Agrawala protocol.
+    std::unique_ptr<Maekawa> maekawa;    ///< State under the Maekawa protocol.
+    std::unique_ptr<SuzukiKasami> sk;    ///< State under the Suzuki-Kasami protocol.
+    bool abandoned = false;              ///< Whether the pending request was withdrawn and waits for its unit.
+};
+
+} // namespace mood_thieves
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mpi.h>
+#include <mutex>
+#include <vector>
+
+#include "mood_thieves/utils.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * Coalesces messages per destination into batches sent as a single MPI message.
+ *
+ * Deferred messages wait in the buffer of their destination until it is full, until the oldest one
+ * is older than the flush delay or until the owner flushes everything. Urgent messages flush their
+ * destination right away and take the deferred messages along, e.g. ACKs ride on a REQUEST.
+ * The buffers of a destination are always sent in order, so per-destination FIFO ordering is kept.
+ *
+ * Messages are packed into wire_message_t entries as they are posted and a flush only starts an
+ * MPI_Isend of the buffer, so a broadcast never waits for a slow destination. Every destination has
+ * a second buffer for the batch in flight, its send is completed once the next batch to the same
+ * destination is due or when the Batcher is destroyed.
+ */
+class Batcher
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param batch_type The MPI type of a single batch entry, see utils::initialize_batch_type.
+     * @param comm The communicator to send on.
+     * @param size The number of destinations.
+     * @param max_batch The maximum number of messages in a batch.
+     * @param flush_delay_us The longest time a deferred message waits in microseconds.
+     */
+    Batcher(MPI_Datatype batch_type, MPI_Comm comm, int size, int max_batch, int flush_delay_us);
+
+    /**
+     * Destructor, completes the batches in flight.
+     */
+    ~Batcher();
+
+    Batcher(const Batcher &) = delete;
+    Batcher &operator=(const Batcher &) = delete;
+
+    /**
+     * Adds a message to the buffer of its destination.
+     *
+     * @param thief_id The identifier of the thief to send to.
+     * @param message The message to send.
+     * @param urgent Whether to send the buffer right away.
+     */
+    void post(int thief_id, const utils::message_t &message, bool urgent);
+
+    /**
+     * Sends the buffers whose oldest message waits longer than the flush delay.
+     */
+    void flushExpired();
+
+    /**
+     * Sends all buffers.
+     */
+    void flushAll();
+
+    /**
+     * @return The number of MPI messages sent so far.
+     */
+    long batchesSent() const { return batches_sent.load(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Starts sending the buffer of a destination, the mutex has to be held.
+     *
+     * @param thief_id The identifier of the destination.
+     */
+    void flush(int thief_id);
+
+    MPI_Datatype batch_type;                                   ///< The MPI type of a single batch entry.
+    MPI_Comm comm;                                             ///< The communicator to send on.
+    size_t max_batch;                                          ///< The maximum number of messages in a batch.
+    Clock::duration flush_delay;                               ///< The longest time a deferred message waits.
+    std::vector<std::vector<utils::wire_message_t>> buffers;   ///< The messages waiting for every destination.
+    std::vector<std::vector<utils::wire_message_t>> in_flight; ///< The batch being sent to every destination.
+    std::vector<MPI_Request> requests;                         ///< The send of the batch in flight.
+    std::vector<Clock::time_point> oldest;                     ///< When the oldest waiting message was added.
+    int waiting = 0;                                           ///< The number of destinations with waiting messages.
+    std::mutex mutex;                                          ///< Mutex protecting the buffers.
+    std::atomic<long> batches_sent{0};                         ///< The number of MPI messages sent.
+};
+
+} // namespace mood_thieves
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace mood_thieves
+{
+
+// Enum representing the way the receiving thread waits for messages
+enum class ReceivePolicy
+{
+    SPIN,     ///< Busy-spin on MPI_Iprobe (legacy behaviour).
+    ADAPTIVE, ///< Spin on MPI_Testsome for a while, then yield and back off with short sleeps.
+    BLOCK     ///< Block in MPI_Waitsome and let the MPI library decide how to idle.
+};
+
+// Enum representing the arbitration protocol of the weapons and laboratories
+enum class Protocol
+{
+    BROADCAST,       ///< Lamport-style queue: REQUEST and RELEASE to everyone, ACK from everyone.
+    RICART_AGRAWALA, ///< Deferred ACKs k-of-n, no RELEASE messages.
+    MAEKAWA,         ///< Grid quorums per unit with INQUIRE/YIELD/FAILED.
+    SUZUKI_KASAMI,   ///< A token per unit, REQUEST to everyone unless an idle token is at hand.
+    RMA              ///< Ticket semaphores in an MPI window, one-sided atomics instead of messages.
+};
+
+// Enum representing how the merged metrics are reported
+enum class MetricsFormat
+{
+    OFF,  ///< No report.
+    TEXT, ///< A table per report.
+    JSON  ///< A JSON object per line and report.
+};
+
+// Enum representing how the thieves exchange messages
+enum class TransportBackend
+{
+    MPI,       ///< Every thief is an MPI rank.
+    IN_PROCESS ///< Every thief is a set of threads of one process, messages go through lock-free mailboxes.
+};
+
+// Enum representing how a rank runs its thieves
+enum class ExecutorKind
+{
+    THREADS,   ///< A thief per rank with a receiving, a business logic and a timer thread.
+    COROUTINES ///< Many thieves per rank as coroutines of a single thread.
+};
+
+// Enum representing how the ranks are arranged for the arbitration
+enum class Topology
+{
+    FLAT, ///< Every rank takes part in the protocol.
+    NODE  ///< Ranks of a node queue in shared memory, one leader per node takes part in the protocol.
+};
+
+// Enum representing the distribution of the simulated network latency
+enum class LatencyDistribution
+{
+    CONSTANT,    ///< Always first_us.
+    UNIFORM,     ///< Uniform between first_us and second_us.
+    EXPONENTIAL, ///< first_us plus an exponential tail of mean second_us.
+    LOGNORMAL    ///< Lognormal with median first_us and shape second_us.
+};
+
+// Enum representing the distribution of the duration of a phase of the business logic
+enum class PhaseDistribution
+{
+    CONSTANT,    ///< Always the mean.
+    EXPONENTIAL, ///< Exponential with the mean.
+    LOGNORMAL,   ///< Lognormal with the mean and shape sigma.
+    PARETO,      ///< Pareto with the mean and shape alpha above 1, the variance is infinite up to alpha 2.
+    TRACE        ///< The durations of a file in their order.
+};
+
+/**
+ * Distribution of the duration of a phase, its mean is the duration configured for the phase.
+ */
+struct PhaseTime
+{
+    PhaseDistribution distribution = PhaseDistribution::CONSTANT; ///< The distribution.
+    double shape = 0;                                             ///< Sigma of LOGNORMAL, alpha of PARETO.
+    std::vector<int> samples_us;                                  ///< Durations of TRACE in microseconds.
+};
+
+/**
+ * Latency of a message in the simulation.
+ */
+struct Latency
+{
+    LatencyDistribution distribution = LatencyDistribution::CONSTANT; ///< The distribution.
+    double first_us = 50;                                             ///< First parameter, see the distribution.
+    double second_us = 0;                                             ///< Second parameter, see the distribution.
+};
+
+/**
+ * Runtime configuration of a thief.
+ */
+struct Config
+{
+    Protocol protocol = Protocol::BROADCAST;                ///< The arbitration protocol.
+    ReceivePolicy receive_policy = ReceivePolicy::ADAPTIVE; ///< How the receiving thread waits for messages.
+    int receive_slots = 16;     ///< Number of pre-posted persistent receives.
+    int spin_iterations = 1000; ///< Idle polls before the adaptive policy starts yielding.
+    int yield_iterations = 100; ///< Idle yields before the adaptive policy starts sleeping.
+    int max_backoff_us = 1000;  ///< Upper bound of the adaptive sleep in microseconds.
+    int batch_size = 16;        ///< Maximum number of messages coalesced into one MPI message.
+    int batch_delay_us = 50;    ///< Longest time a deferred message waits for a batch, 0 disables batching.
+    std::string trace_prefix;   ///< Path prefix of the per-rank trace files, empty disables tracing.
+    std::string record_prefix;  ///< Path prefix of the per-thief schedule files to record, empty records none.
+    std::string replay_prefix;  ///< Path prefix of the per-thief schedule files to replay, empty replays none.
+    int entries = 0;            ///< Laboratory entries after which the thief finishes, 0 runs forever.
+    MetricsFormat metrics_format = MetricsFormat::TEXT; ///< How rank 0 reports the merged metrics.
+    std::string metrics_file;                           ///< File rank 0 writes the metrics to, empty for stdout.
+    int metrics_interval_ms = 0; ///< Milliseconds between periodic reports, 0 reports only on exit.
+    int weapons = 2;             ///< Number of weapons in the pool.
+    int laboratories = 1;        ///< Number of laboratory workstations.
+    int weapon_us = 1000000;     ///< Mean microseconds a thief roams the city with a weapon.
+    int laboratory_us = 3000000; ///< Mean microseconds a thief spends in the laboratory.
+    int recharge_us = 5000000;   ///< Mean microseconds a used weapon recharges before it is released.
+    PhaseTime weapon_time;       ///< Distribution of the roaming time.
+    PhaseTime laboratory_time;   ///< Distribution of the laboratory time.
+    PhaseTime recharge_time;     ///< Distribution of the recharge time.
+    int duration_ms = 0;         ///< Milliseconds after which the thief finishes, 0 runs forever.
+    TransportBackend transport = TransportBackend::MPI; ///< How the thieves exchange messages.
+    ExecutorKind executor = ExecutorKind::THREADS;      ///< How a rank runs its thieves.
+    int thieves = 4;                                    ///< Thieves in-process, simulated or per rank as coroutines.
+    Topology topology = Topology::FLAT;                 ///< How the ranks are arranged for the arbitration.
+    int node_size = 0;                                  ///< Ranks per node, 0 asks MPI which ranks share memory.
+    int lease = 4;                                      ///< Local holders a unit of a node serves in a row.
+    Latency latency;                                    ///< Simulated network latency of a message.
+    int handle_ns = 0;                                  ///< Simulated receiver time to handle a message.
+    int seed = 1;                                       ///< Seed of the simulation.
+    int ack_horizon = 0;                                ///< Pools queued ahead that hold back an ACK, 0 never.
+    int shards = 1;                                     ///< Shards of every pool, each arbitrated by its subscribers.
+    int lab_lead_us = 0;                                ///< Microseconds before the end of a roam the lab is requested.
+    double victim_probability = 1;                      ///< Chance a roam finds a victim, otherwise no laboratory.
+};
+
+// Most shards of a pool, the shard travels with the resource type in a byte of a message
+const int MAX_SHARDS = 64;
+
+/**
+ * Parse the command line arguments into the configuration.
+ * Arguments have the form --name=value, unknown arguments are an error.
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @param config The configuration to fill in, fields not mentioned keep their defaults.
+ *
+ * @return Status code, -1 if the arguments are invalid.
+ */
+int parse_config(int argc, char **argv, Config &config);
+
+/**
+ * A thief holds the weapon it uses and every weapon still recharging, a new one is taken at the earliest
+ * one shortest roaming and laboratory phase after the previous one. A recharge without an upper bound may
+ * outlast any number of cycles.
+ *
+ * @param config The configuration.
+ *
+ * @return The most weapons a single thief can hold at once.
+ */
+int max_weapons_held(const Config &config);
+
+} // namespace mood_thieves
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <vector>
+
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/executor.hpp"
+#include "mood_thieves/metrics.hpp"
+#include "mood_thieves/sharded_pool.hpp"
+#include "mood_thieves/utils.hpp"
+#include "mood_thieves/workload.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * A thief run as a coroutine of an Executor, so that a rank hosts many of them.
+ *
+ * Follows the business logic of MoodThieve: acquire a weapon, roam, acquire a laboratory, work, leave and let
+ * the weapon recharge in a coroutine of its own. The laboratory may be requested before the roam ends and is
+ * given up again when the roam finds no victim. Only the executor thread touches the state of the thief, so
+ * there is no locking, and a waiting thief is resumed by the message that lets it enter instead of polling.
+ */
+class CoroutineThief
+{
+public:
+    /**
+     * Awaitable requesting a unit of a resource, the awaiting coroutine resumes holding it.
+     */
+    struct Acquire
+    {
+        CoroutineThief &thief; ///< The requesting thief.
+        int resource_type;     ///< The requested resource.
+
+        bool await_ready() { return thief.request(resource_type); }
+        void await_suspend(std::coroutine_handle<> handle) { thief.waiting_handle = handle; }
+        void await_resume() const {}
+    };
+
+    /**
+     * Awaitable waiting for a unit requested earlier, the awaiting coroutine resumes holding it.
+     */
+    struct Granted
+    {
+        CoroutineThief &thief; ///< The requesting thief.
+        int resource_type;     ///< The requested resource.
+
+        bool await_ready() const { return thief.waiting != resource_type; }
+        void await_suspend(std::coroutine_handle<> handle) { thief.waiting_handle = handle; }
+        void await_resume() const {}
+    };
+
+    /**
+     * Awaitable waiting until at most a number of weapons of the thief are recharging.
+     */
+    struct Recharged
+    {
+        CoroutineThief &thief; ///< The waiting thief.
+        int most;              ///< The most weapons still recharging.
+
+        bool await_ready() const { return thief.recharging <= most; }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            thief.recharged_most = most;
+            thief.recharged_handle = handle;
+        }
+        void await_resume() const {}
+    };
+
+    /**
+     * Constructor
+     *
+     * @param executor The executor running the thief.
+     * @param metrics The metrics of the rank to record into.
+     * @param id The global identifier of the thief.
+     * @param size The total number of thieves of all ranks.
+     * @param config The runtime configuration.
+     */
+    CoroutineThief(Executor &executor, Metrics &metrics, int id, int size, const Config &config);
+
+    /**
+     * Business logic of the thief until it made its entries or its duration passed.
+     *
+     * @return The coroutine to spawn on the executor.
+     */
+    Task run();
+
+    /**
+     * Handles a single message received from another thief.
+     *
+     * @param message The received message.
+     */
+    void handleMessage(const utils::message_t &message);
+
+    /**
+     * @return Whether every thief sent FINISH, nothing more arrives then.
+     */
+    bool finished() const { return finished_thieves == size; }
+
+    /**
+     * @param resource_type The resource to request.
+     *
+     * @return Awaitable resuming once the thief holds a unit of the resource.
+     */
+    Acquire acquire(int resource_type) { return {*this, resource_type}; }
+
+private:
+    /**
+     * Sends a request for a unit and takes it if it can.
+     *
+     * @param resource_type The resource to request.
+     *
+     * @return True if the thief took the unit right away.
+     */
+    bool request(int resource_type);
+
+    /**
+     * Gives up the laboratory after a roam without a victim and returns the unused weapon.
+     *
+     * @param requested Whether the laboratory was requested during the roam.
+     */
+    void abandon(bool requested);
+
+    /**
+     * Takes the unit the thief has been waiting for.
+     *
+     * @param resource_type The resource to take.
+     */
+    void enter(int resource_type);
+
+    /**
+     * Recharges a weapon and releases it.
+     *
+     * @param shard The shard the weapon was taken from.
+     *
+     * @return The coroutine to spawn on the executor.
+     */
+    Task recharge(int shard);
+
+    /**
+     * Sends a single message to a thief.
+     *
+     * @param thief_id The identifier of the thief to send to.
+     * @param message_type The type of the message.
+     * @param message_clock The Lamport clock of the message.
+     * @param resource_type The resource the message is about, with the shard of its pool.
+     * @param value The protocol specific value of the message.
+     */
+    void send(int thief_id, int message_type, int message_clock, int resource_type, int value);
+
+    /**
+     * @return Sends the messages of the arbitration of a resource.
+     */
+    ShardedPool::Send sender(int resource_type);
+
+    /**
+     * @return Nanoseconds since the thief started.
+     */
+    int64_t elapsedNs() const;
+
+    Executor &executor;                            ///< The executor running the thief.
+    Metrics &metrics;                              ///< The metrics of the rank.
+    int id;                                        ///< The global identifier of the thief.
+    int size;                                      ///< The total number of thieves.
+    Config config;                                 ///< The runtime configuration.
+    std::chrono::steady_clock::time_point started; ///< When the thief started.
+    Workload workload;                             ///< Draws the phase durations and the victims.
+    int clock = 0;                                 ///< The Lamport clock.
+    std::vector<ShardedPool> pools;                ///< The arbitration of the weapons and the laboratories.
+    int waiting = -1;                              ///< The resource the thief waits for, -1 if none.
+    std::coroutine_handle<> waiting_handle;        ///< The coroutine waiting in acquire.
+    std::coroutine_handle<> recharged_handle;      ///< The coroutine waiting for weapons to recharge.
+    int recharged_most = 0;                        ///< The most weapons recharging recharged_handle waits for.
+    int max_weapons;                               ///< The most weapons the thief holds at once.
+    int64_t request_ns[2] = {};                    ///< When the pending request of every resource was sent.
+    int taken_shards[2] = {};                      ///< The shard of the unit of every resource taken last.
+    int recharging = 0;                            ///< The number of weapons recharging.
+    int laboratory_entries = 0;                    ///< The number of times the thief entered the laboratory.
+    int finished_thieves = 0;                      ///< The number of thieves that sent FINISH.
+    bool handling = false;                         ///< Whether a message is being handled, its replies are deferred.
+};
+
+} // namespace mood_thieves
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mood_thieves/arbitration.hpp"
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/timer_wheel.hpp"
+#include "mood_thieves/transport.hpp"
+#include "mood_thieves/utils.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * A pool of a DistributedSemaphore.
+ */
+struct SemaphorePool
+{
+    std::string name; ///< The name the pool is looked up by.
+    int capacity;     ///< The number of units shared by all participants.
+    int max_held = 0; ///< The most units a participant holds at once, 0 for the capacity.
+};
+
+/**
+ * Counting semaphores shared by the participants of a transport, each arbitrated under the configured protocol.
+ *
+ * Every participant constructs one with the same pools in the same order, a pool travels as its index in the
+ * resource type of a message. Any thread may acquire and release units, the threads of a participant queue for
+ * a pool in the order they asked and only the first of them has a request out to the other participants. A
+ * request that times out is withdrawn, under the broadcast protocol from every queue, under the others it stays
+ * queued and its unit is released as soon as it is granted unless a later request of the participant takes it
+ * over. A participant never holds more than max_held units of a pool, further requests wait locally.
+ *
+ * A receiving thread handles the messages of the other participants. Callbacks of the asynchronous form run
+ * without any lock held on the thread that made the grant or the timeout, the receiving, the timer or the
+ * calling thread, and must not block.
+ */
+class DistributedSemaphore
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Called once a request completes, with whether it took a unit or timed out.
+     */
+    using Callback = std::function<void(bool acquired)>;
+
+    /**
+     * Holds a unit of a pool and releases it when destroyed.
+     */
+    class Guard
+    {
+    public:
+        Guard() = default;
+        Guard(DistributedSemaphore &semaphore, int pool) : semaphore(&semaphore), pool(pool) {}
+        Guard(Guard &&other) noexcept : semaphore(other.semaphore), pool(other.pool) { other.semaphore = nullptr; }
+        Guard &operator=(Guard &&other) noexcept;
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+        ~Guard() { release(); }
+
+        /**
+         * @return Whether the guard holds a unit.
+         */
+        explicit operator bool() const { return semaphore != nullptr; }
+
+        /**
+         * Releases the unit now.
+         */
+        void release();
+
+        /**
+         * Releases the unit after a delay, the guard no longer holds it.
+         *
+         * @param delay The time the unit stays taken.
+         */
+        void release_after(std::chrono::microseconds delay);
+
+    private:
+        DistributedSemaphore *semaphore = nullptr; ///< The semaphore of the unit, null if none is held.
+        int pool = -1;                             ///< The pool of the unit.
+    };
+
+    /**
+     * Constructor, starts the receiving thread.
+     *
+     * @param transport The transport to the other participants.
+     * @param id The identifier of the participant.
+     * @param size The total number of participants.
+     * @param protocol The arbitration protocol, rma arbitrates like broadcast as there is no window.
+     * @param pools The pools, the same on every participant.
+     */
+    DistributedSemaphore(Transport &transport, int id, int size, Protocol protocol,
+                         const std::vector<SemaphorePool> &pools);
+
+    /**
+     * Destructor, finishes if finish was not called.
+     */
+    ~DistributedSemaphore();
+
+    DistributedSemaphore(const DistributedSemaphore &) = delete;
+    DistributedSemaphore &operator=(const DistributedSemaphore &) = delete;
+
+    /**
+     * @param name The name of a pool.
+     *
+     * @return The index of the pool, -1 if there is none of that name.
+     */
+    int pool(const std::string &name) const;
+
+    /**
+     * Takes a unit of a pool, blocks until it is granted.
+     *
+     * @param pool The index of the pool.
+     */
+    void acquire(int pool);
+
+    /**
+     * Takes a unit of a pool unless the deadline passes first.
+     *
+     * @param pool The index of the pool.
+     * @param deadline When to give up.
+     *
+     * @return True if the unit was taken, false if the request timed out and was withdrawn.
+     */
+    bool try_acquire_until(int pool, Clock::time_point deadline);
+
+    /**
+     * Takes a unit of a pool unless the timeout passes first.
+     *
+     * @param pool The index of the pool.
+     * @param timeout How long to wait.
+     *
+     * @return True if the unit was taken, false if the request timed out and was withdrawn.
+     */
+    bool try_acquire_for(int pool, std::chrono::microseconds timeout)
+    {
+        // A timeout reaching past the end of the clock saturates instead of wrapping into the past
+        Clock::time_point now = Clock::now();
+        if (timeout >= std::chrono::duration_cast<std::chrono::microseconds>(Clock::time_point::max() - now))
+        {
+            return try_acquire_until(pool, Clock::time_point::max());
+        }
+        return try_acquire_until(pool, now + timeout);
+    }
+
+    /**
+     * Requests a unit of a pool without blocking.
+     *
+     * @param pool The index of the pool.
+     * @param callback Called once the unit is taken or the deadline passed.
+     * @param deadline When to give up, never by default.
+     */
+    void acquire_async(int pool, Callback callback, Clock::time_point deadline = Clock::time_point::max());
+
+    /**
+     * @return A guard holding a unit of a pool, blocks until it is granted.
+     */
+    Guard guard(int pool);
+
+    /**
+     * @return A guard holding a unit of a pool, an empty one if the timeout passed first.
+     */
+    Guard try_guard_for(int pool, std::chrono::microseconds timeout);
+
+    /**
+     * Releases the oldest held unit of a pool.
+     *
+     * @param pool The index of the pool.
+     */
+    void release(int pool);
+
+    /**
+     * Releases the oldest held unit of a pool after a delay, it stays taken meanwhile.
+     *
+     * @param pool The index of the pool.
+     * @param delay The time the unit stays taken.
+     */
+    void release_after(int pool, std::chrono::microseconds delay);
+
+    /**
+     * Leaves the semaphores, blocks until every participant left. Nothing may be held or requested anymore.
+     */
+    void finish();
+
+private:
+    struct Waiter
+    {
+        uint64_t ticket;   ///< Tells the waiters apart.
+        Callback callback; ///< Called once the request completes.
+    };
+
+    struct Pool
+    {
+        std::string name;           ///< The name of the pool.
+        int max_held;               ///< The most units held at once.
+        Arbitration arbitration;    ///< The arbitration of the pool.
+        std::deque<Waiter> waiters; ///< Local requests in order, the first one may have a request out.
+        bool requesting = false;    ///< Whether the first waiter has a request out.
+        int held = 0;               ///< The number of units held, delayed releases included.
+    };
+
+    using Ready = std::vector<std::pair<Callback, bool>>;
+
+    /**
+     * Body of the receiving thread.
+     */
+    void receiveMessages();
+
+    /**
+     * Handles a message of another participant, the mutex has to be held.
+     */
+    void handleMessage(const utils::message_t &message, Ready &ready);
+
+    /**
+     * Sends the request of the first waiter of a pool if it may and grants what can enter, the mutex has
+     * to be held.
+     */
+    void progress(int pool, Ready &ready);
+
+    /**
+     * Withdraws a request whose deadline passed.
+     */
+    void expire(int pool, uint64_t ticket);
+
+    /**
+     * Runs the callbacks of completed requests, without the mutex held.
+     */
+    static void complete(Ready &ready);
+
+    /**
+     * @return Sends the messages of the arbitration of a pool.
+     */
+    Arbitration::Send sender(int pool);
+
+    Transport &transport;             ///< The transport to the other participants.
+    int id;                           ///< The identifier of the participant.
+    int size;                         ///< The total number of participants.
+    std::vector<Pool> pools;          ///< The pools by index.
+    std::mutex mutex;                 ///< Protects the pools and the clock.
+    std::condition_variable finished; ///< Signalled once every participant left.
+    int clock = 0;                    ///< The Lamport clock.
+    uint64_t next_ticket = 0;         ///< The ticket of the next waiter.
+    int finished_count = 0;           ///< The number of participants that left.
+    bool finishing = false;           ///< Whether finish was called.
+    std::thread receiver;             ///< The receiving thread.
+    TimerWheel timers;                ///< Runs the delayed releases and deadlines, stops first.
+};
+
+} // namespace mood_thieves
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <queue>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/transport.hpp"
+#include "mood_thieves/utils.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * A coroutine run by an Executor, it starts suspended and the executor destroys it once it returns.
+ */
+class Task
+{
+public:
+    struct promise_type
+    {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    Task(Task &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+    ~Task()
+    {
+        if (handle)
+        {
+            handle.destroy();
+        }
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    /**
+     * @return The coroutine, which the caller owns from now on.
+     */
+    std::coroutine_handle<> release() { return std::exchange(handle, {}); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle; ///< The coroutine, empty once released.
+};
+
+/**
+ * Runs the coroutines of all thieves hosted by a rank on the calling thread.
+ *
+ * A suspended thief costs neither a thread nor wakeups: it is resumed when a message handler wakes it or
+ * when its sleep expires. Every thief has a global identifier, the thieves of rank r are
+ * r * thieves_per_rank and up. Messages between thieves of the same rank never leave the executor, the
+ * others go through the transport of the rank carrying their receiver in message_t::to. Both keep the
+ * order of the messages between a pair of thieves.
+ *
+ * Between events the thread idles according to the receive policy, so a sleep may end up to
+ * max_backoff_us late under the adaptive one.
+ */
+class Executor
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Suspends a coroutine until a point in time.
+     */
+    struct Sleep
+    {
+        Executor &executor;        ///< The executor resuming the coroutine.
+        Clock::time_point wake_at; ///< When to resume it.
+
+        bool await_ready() const { return wake_at <= Clock::now(); }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            executor.timers.push({wake_at, executor.sequence++, handle});
+        }
+        void await_resume() const {}
+    };
+
+    /**
+     * Constructor
+     *
+     * @param transport The transport between the ranks.
+     * @param rank The rank of this executor.
+     * @param thieves_per_rank The number of thieves every rank hosts.
+     * @param config The configuration holding the receive policy.
+     */
+    Executor(Transport &transport, int rank, int thieves_per_rank, const Config &config);
+
+    /**
+     * Destructor, destroys the coroutines that did not return.
+     */
+    ~Executor();
+
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    /**
+     * Schedules a new coroutine, it first runs once the executor gets to it.
+     *
+     * @param task The coroutine to run.
+     */
+    void spawn(Task task);
+
+    /**
+     * Resumes a suspended coroutine once the executor gets to it.
+     *
+     * @param handle The coroutine to resume.
+     */
+    void wake(std::coroutine_handle<> handle) { ready.push_back(handle); }
+
+    /**
+     * @param duration How long to sleep.
+     *
+     * @return Awaitable suspending the calling coroutine for the duration.
+     */
+    Sleep sleep_for(std::chrono::microseconds duration) { return {*this, Clock::now() + duration}; }
+
+    /**
+     * Sends a message to a thief of any rank.
+     *
+     * @param thief_id The global identifier of the thief to send to.
+     * @param message The message to send.
+     * @param urgent Whether a message for another rank has to leave right away.
+     */
+    void post(int thief_id, utils::message_t message, bool urgent);
+
+    /**
+     * Runs coroutines, timers and message handlers until every coroutine returned and done holds.
+     *
+     * @param handler Handles a message for any thief of the rank, message.to is the receiving thief.
+     * @param done Whether the rank may stop once its coroutines returned, e.g. every thief finished.
+     */
+    void run(const Transport::Handler &handler, const std::function<bool()> &done);
+
+    /**
+     * @return The number of messages that stayed within the rank.
+     */
+    long localMessages() const { return local_messages; }
+
+private:
+    struct Timer
+    {
+        Clock::time_point wake_at;      ///< When to resume the coroutine.
+        uint64_t sequence;              ///< Order of the sleeps, equal times resume in that order.
+        std::coroutine_handle<> handle; ///< The sleeping coroutine.
+
+        bool operator>(const Timer &other) const
+        {
+            return wake_at == other.wake_at ? sequence > other.sequence : wake_at > other.wake_at;
+        }
+    };
+
+    /**
+     * Resumes a coroutine and destroys it if it returned.
+     */
+    void resume(std::coroutine_handle<> handle);
+
+    Transport &transport;                                ///< The transport between the ranks.
+    int rank;                                            ///< The rank of this executor.
+    int thieves_per_rank;                                ///< The number of thieves every rank hosts.
+    Config config;                                       ///< The configuration holding the receive policy.
+    std::deque<std::coroutine_handle<>> ready;           ///< Coroutines to resume, oldest first.
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers; ///< Sleeping coroutines.
+    std::deque<utils::message_t> local;                  ///< Messages between thieves of the rank, oldest first.
+    std::unordered_set<void *> spawned;                  ///< Frame address of every coroutine that did not return.
+    uint64_t sequence = 0;                               ///< The number of sleeps.
+    long local_messages = 0;                             ///< The number of messages that stayed within the rank.
+};
+
+} // namespace mood_thieves
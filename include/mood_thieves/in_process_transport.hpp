@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "mood_thieves/transport.hpp"
+#include "mood_thieves/utils.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * Lock-free multi-producer single-consumer queue of messages, the mailbox of a thief.
+ *
+ * Vyukov's intrusive queue: a push is a single exchange of the tail, so any number of threads post
+ * without locks and the order of the exchanges is the delivery order. Only the owner pops.
+ * The owner sleeps on an atomic push counter, producers wake it with notify_one, which does not
+ * enter the kernel unless the owner is actually waiting.
+ */
+class Mailbox
+{
+public:
+    Mailbox();
+    ~Mailbox();
+
+    Mailbox(const Mailbox &) = delete;
+    Mailbox &operator=(const Mailbox &) = delete;
+
+    /**
+     * Appends a message, safe to call from any thread.
+     *
+     * @param message The message to append.
+     */
+    void push(const utils::message_t &message);
+
+    /**
+     * Takes the oldest message, only called by the owner.
+     *
+     * @param message The taken message.
+     *
+     * @return True if a message was taken, false if the mailbox is empty or a push is still in progress.
+     */
+    bool pop(utils::message_t &message);
+
+    /**
+     * @return The number of completed pushes and wakes, read before an empty pop and passed to waitForPush.
+     */
+    uint32_t pushes() const { return push_count.load(std::memory_order_acquire); }
+
+    /**
+     * Blocks until a push completes after the counter was read.
+     *
+     * @param seen The counter read before the last empty pop.
+     */
+    void waitForPush(uint32_t seen) const { push_count.wait(seen, std::memory_order_acquire); }
+
+    /**
+     * Releases the owner blocked in waitForPush as a push would, without a message.
+     */
+    void wake();
+
+private:
+    struct Node
+    {
+        std::atomic<Node *> next{nullptr};
+        utils::message_t message;
+    };
+
+    /**
+     * Links a node at the tail.
+     */
+    void link(Node *node);
+
+    alignas(64) std::atomic<Node *> tail;           ///< The newest node, exchanged by the producers.
+    alignas(64) Node *head;                         ///< The oldest node, owned by the consumer.
+    Node stub;                                      ///< Placeholder keeping the queue non-empty.
+    alignas(64) std::atomic<uint32_t> push_count{0}; ///< Completed pushes and wakes, the owner sleeps on it.
+};
+
+/**
+ * The mailboxes of all thieves hosted by a process.
+ */
+class InProcessNetwork
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param size The number of thieves.
+     */
+    explicit InProcessNetwork(int size) : mailboxes(size) {}
+
+    /**
+     * @return The mailbox of a thief.
+     */
+    Mailbox &mailbox(int thief_id) { return mailboxes[thief_id]; }
+
+private:
+    std::vector<Mailbox> mailboxes; ///< The mailbox of every thief.
+};
+
+/**
+ * Transport between thieves hosted as threads of a single process.
+ *
+ * A message is pushed straight into the mailbox of its destination, there is nothing to batch.
+ */
+class InProcessTransport : public Transport
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param network The mailboxes of all thieves.
+     * @param id The identifier of the thief owning the transport.
+     */
+    InProcessTransport(InProcessNetwork &network, int id) : network(network), own(network.mailbox(id)) {}
+
+    void post(int thief_id, const utils::message_t &message, bool urgent) override;
+    void flushExpired() override {}
+    void flushAll() override {}
+    int poll(const Handler &handler) override;
+    int wait(const Handler &handler) override;
+    void wake() override;
+    long batchesSent() const override { return sent.load(std::memory_order_relaxed); }
+
+private:
+    InProcessNetwork &network;      ///< The mailboxes of all thieves.
+    Mailbox &own;                   ///< The mailbox of the owning thief.
+    std::atomic<long> sent{0};      ///< The number of pushed messages.
+    std::atomic<bool> woken{false}; ///< Whether wake was called since a wait last checked.
+};
+
+} // namespace mood_thieves
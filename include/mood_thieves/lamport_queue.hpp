@@ -0,0 +1,147 @@
+#pragma once
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "mood_thieves/request_table.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * Lamport's queue arbitration of a pool of indistinguishable units.
+ *
+ * A REQUEST is broadcast to every thief including the requester, every thief keeps all requests ordered
+ * by (clock, id) and answers each with an ACK. A thief enters once everyone acknowledged its request
+ * and the request is among the first capacity ones. A unit stays in the queue of everyone until its
+ * holder broadcasts a RELEASE, a recharging weapon keeps taking a place in the pool.
+ * The requests are kept in a RequestTable, so no message costs more than a pass over its keys.
+ *
+ * As in Lamport's original algorithm any message of a thief timestamped later than the pending request
+ * stands for its ACK, channels are FIFO so every older REQUEST of the thief is queued already. With an
+ * ACK horizon a thief holds back the ACK of a request queued behind at least horizon times capacity
+ * others, that thief cannot enter before the queue drains anyway. The ACK goes out once a RELEASE moves
+ * the request within the horizon, unless the next REQUEST or RELEASE of the thief answers it first, so an
+ * overloaded pool costs fewer messages while the order of the queue and so its fairness stay the same.
+ *
+ * A request that has not entered can be withdrawn: the WITHDRAW takes it out of every queue like a RELEASE,
+ * but by its clock, as the thief may hold older units of the pool.
+ *
+ * The class only keeps the state, sending the messages is left to the caller.
+ */
+class LamportQueue
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param id The identifier of the thief.
+     * @param size The total number of thieves.
+     * @param capacity The number of units in the pool.
+     * @param ack_horizon Multiples of the capacity queued ahead of a request that hold back its ACK, 0 never.
+     */
+    LamportQueue(int id, int size, int capacity, int ack_horizon = 0);
+
+    /**
+     * Starts a request for a unit, the REQUEST goes to every thief including this one.
+     *
+     * @param clock The Lamport clock of the request.
+     */
+    void request(int clock);
+
+    /**
+     * Queues a request of any thief.
+     *
+     * @param thief_id The identifier of the requesting thief.
+     * @param clock The Lamport clock of the request.
+     *
+     * @return True if the request is acknowledged right away, false if its ACK is held back.
+     */
+    bool receiveRequest(int thief_id, int clock);
+
+    /**
+     * Counts an acknowledgement of the pending request.
+     *
+     * @param thief_id The identifier of the acknowledging thief.
+     * @param clock The Lamport clock of the acknowledged request, an ACK of an older one is ignored.
+     */
+    void receiveAck(int thief_id, int clock);
+
+    /**
+     * Removes the oldest request of another thief, the own ones are removed by release.
+     *
+     * @param thief_id The identifier of the releasing thief.
+     * @param clock The Lamport clock of the RELEASE.
+     */
+    void receiveRelease(int thief_id, int clock);
+
+    /**
+     * Removes a withdrawn request of any thief, the own one included once its WITHDRAW comes back.
+     *
+     * @param thief_id The identifier of the withdrawing thief.
+     * @param clock The Lamport clock of the WITHDRAW.
+     * @param request_clock The Lamport clock of the withdrawn request.
+     */
+    void receiveWithdraw(int thief_id, int clock, int request_clock);
+
+    /**
+     * Takes the held back ACKs whose requests moved within the horizon.
+     *
+     * @return The identifier and the request clock of every ACK to send now.
+     */
+    std::vector<std::pair<int, int>> dueAcks();
+
+    /**
+     * Checks whether the pending request can enter the pool.
+     *
+     * @return True if the thief can take a unit, false otherwise.
+     */
+    bool canEnter() const;
+
+    /**
+     * Takes a unit for the pending request.
+     */
+    void enter();
+
+    /**
+     * Removes the oldest held unit from the queue, the RELEASE goes to every thief.
+     */
+    void release();
+
+    /**
+     * Gives up the pending request before it entered, the WITHDRAW goes to every thief including this one.
+     * The own REQUEST may still be on its way back, so the request leaves the queue with the WITHDRAW.
+     */
+    void withdraw();
+
+    /**
+     * @return The Lamport clock of the pending request.
+     */
+    int requestClock() const { return request_clock; }
+
+    /**
+     * @return The number of queued requests.
+     */
+    int queueDepth() const { return queue.count(); }
+
+private:
+    /**
+     * Counts a message of a thief as the acknowledgement of the pending request.
+     */
+    void acknowledge(int thief_id);
+
+    int id;       ///< The identifier of the thief.
+    int size;     ///< The total number of thieves.
+    int capacity; ///< The number of units in the pool.
+    int horizon;  ///< Requests queued ahead of a request that hold back its ACK, 0 never.
+
+    bool requesting = false; ///< Whether there is a pending request.
+    int request_clock = 0;   ///< The Lamport clock of the pending request.
+    int acks = 0;            ///< Acknowledgements of the pending request.
+    std::vector<bool> acked; ///< Whether every thief acknowledged the pending request.
+    RequestTable queue;      ///< Requests of all thieves, ordered by (clock, id).
+    std::set<uint64_t> owed; ///< Keys of the requests whose ACK is held back.
+};
+
+} // namespace mood_thieves
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <vector>
+
+namespace mood_thieves
+{
+
+/**
+ * Builds the grid quorum of a thief.
+ *
+ * The thieves are laid out row by row in a grid of ceil(sqrt(size)) columns and the quorum
+ * is the row and the column of the thief. Any two quorums intersect, also with a partial last row.
+ *
+ * @param id The identifier of the thief.
+ * @param size The total number of thieves.
+ *
+ * @return The sorted identifiers of the thieves in the quorum, including the thief itself.
+ */
+std::vector<int> grid_quorum(int id, int size);
+
+/**
+ * Maekawa arbitration of a pool of indistinguishable units.
+ *
+ * Every unit of the pool is a separate lock arbitrated by all thieves, a thief asks only its grid
+ * quorum for the unit it picked and enters once the whole quorum granted it. Deadlocks are
+ * resolved with INQUIRE/YIELD/FAILED as in Sanders' correction of the algorithm.
+ * Each thief plays both roles, the requester and the arbiter of the quorums it belongs to.
+ *
+ * The class only keeps the state, sending the messages is left to the caller.
+ */
+class Maekawa
+{
+public:
+    /**
+     * A message to send as a result of a state change.
+     */
+    struct Action
+    {
+        int message_type; ///< The type of message to send.
+        int thief_id;     ///< The identifier of the thief to send to.
+        int unit;         ///< The unit the message is about.
+    };
+
+    /**
+     * Constructor
+     *
+     * @param id The identifier of the thief.
+     * @param size The total number of thieves.
+     * @param units The number of units in the pool.
+     */
+    Maekawa(int id, int size, int units);
+
+    /**
+     * Starts a request for a unit the thief does not hold yet.
+     *
+     * @param clock The Lamport clock of the request.
+     *
+     * @return The messages to send.
+     */
+    std::vector<Action> request(int clock);
+
+    /**
+     * Handles a message of another thief, or of itself.
+     *
+     * @param message_type The type of the message.
+     * @param thief_id The identifier of the sender.
+     * @param clock The Lamport clock of the message, the request clock for a REQUEST.
+     * @param unit The unit the message is about.
+     *
+     * @return The messages to send.
+     */
+    std::vector<Action> receive(int message_type, int thief_id, int clock, int unit);
+
+    /**
+     * Checks whether the whole quorum granted the pending request.
+     *
+     * @return True if the thief can take the unit, false otherwise.
+     */
+    bool canEnter() const;
+
+    /**
+     * Takes the unit of the pending request.
+     */
+    void enter();
+
+    /**
+     * Releases the oldest held unit.
+     *
+     * @return The messages to send.
+     */
+    std::vector<Action> release();
+
+    /**
+     * @return The Lamport clock of the pending request.
+     */
+    int requestClock() const { return request_clock; }
+
+    /**
+     * @return The quorum of the thief.
+     */
+    const std::vector<int> &getQuorum() const { return quorum; }
+
+    /**
+     * @return The number of requests waiting at the arbiters of this thief.
+     */
+    int queueDepth() const { return waiting_requests; }
+
+private:
+    /**
+     * A request waiting at an arbiter.
+     */
+    struct Entry
+    {
+        int clock;   ///< The Lamport clock of the request.
+        int id;      ///< The identifier of the requesting thief.
+        bool failed; ///< Whether the requester knows it has to wait.
+
+        bool operator<(const Entry &other) const
+        {
+            return clock == other.clock ? id < other.id : clock < other.clock;
+        }
+    };
+
+    /**
+     * The arbiter state of a single unit.
+     */
+    struct Arbiter
+    {
+        bool locked = false;        ///< Whether the unit is granted to a request.
+        Entry holder{0, -1, false}; ///< The request the unit is granted to.
+        bool inquired = false;      ///< Whether the holder was asked to yield.
+        std::vector<Entry> waiting; ///< The requests waiting for the unit, oldest first.
+    };
+
+    /**
+     * Grants the unit to the oldest waiting request, if any.
+     *
+     * @param arbiter The arbiter of the unit.
+     * @param unit The unit.
+     * @param actions The messages to send.
+     */
+    void grantNext(Arbiter &arbiter, int unit, std::vector<Action> &actions);
+
+    /**
+     * Yields all grants the thief was inquired about.
+     *
+     * @param actions The messages to send.
+     */
+    void yieldInquired(std::vector<Action> &actions);
+
+    /**
+     * Arbitrates a request: grants the unit if free, otherwise queues the request and
+     * either tells the requester it failed or asks the holder to yield.
+     *
+     * @param thief_id The identifier of the requesting thief.
+     * @param clock The Lamport clock of the request.
+     * @param unit The requested unit.
+     * @param actions The messages to send.
+     */
+    void arbitrateRequest(int thief_id, int clock, int unit, std::vector<Action> &actions);
+
+    /**
+     * Arbitrates a release: the unit goes to the oldest waiting request.
+     *
+     * @param thief_id The identifier of the releasing thief.
+     * @param unit The released unit.
+     * @param actions The messages to send.
+     */
+    void arbitrateRelease(int thief_id, int unit, std::vector<Action> &actions);
+
+    /**
+     * Arbitrates a yield: the holder goes back to the queue and the oldest request gets the unit.
+     *
+     * @param thief_id The identifier of the yielding thief.
+     * @param unit The yielded unit.
+     * @param actions The messages to send.
+     */
+    void arbitrateYield(int thief_id, int unit, std::vector<Action> &actions);
+
+    int id;                  ///< The identifier of the thief.
+    int units;               ///< The number of units in the pool.
+    std::vector<int> quorum; ///< The quorum of the thief.
+
+    bool requesting = false;       ///< Whether there is a pending request.
+    int request_clock = 0;         ///< The Lamport clock of the pending request.
+    int request_unit = 0;          ///< The unit of the pending request.
+    int requests = 0;              ///< The number of requests made, used to spread them over the units.
+    bool failed = false;           ///< Whether the pending request got FAILED or yielded.
+    std::vector<bool> granted;     ///< Whether every thief granted the pending request.
+    std::vector<int> inquired;     ///< Arbiters that asked to yield while the request might still succeed.
+    std::vector<int> held;         ///< Units held by the thief, oldest first.
+    std::vector<Arbiter> arbiters; ///< Arbiter state of every unit.
+    int waiting_requests = 0;      ///< Requests waiting at all arbiters.
+};
+
+} // namespace mood_thieves
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mpi.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace mood_thieves
+{
+
+/**
+ * Histogram with buckets of bounded relative width, in the style of HdrHistogram.
+ *
+ * Values below 32 get a bucket each, above that every power of two is split into 32 buckets,
+ * so a percentile is off by at most about 3%. Recording is a few relaxed atomic increments.
+ */
+class Histogram
+{
+public:
+    static constexpr int SUB_BITS = 5;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    /**
+     * Records a single value.
+     *
+     * @param value The value to record.
+     */
+    void record(uint64_t value);
+
+    /**
+     * Appends the bucket counts, the number and the sum of the values to a vector to be summed.
+     *
+     * @param sums The vector to append to.
+     */
+    void appendSums(std::vector<uint64_t> &sums) const;
+
+    /**
+     * @return The smallest recorded value, UINT64_MAX if there is none.
+     */
+    uint64_t min() const { return minimum.load(std::memory_order_relaxed); }
+
+    /**
+     * @return The largest recorded value.
+     */
+    uint64_t max() const { return maximum.load(std::memory_order_relaxed); }
+
+    /**
+     * @return The bucket of a value.
+     */
+    static int bucket(uint64_t value);
+
+    /**
+     * @return The highest value that falls into a bucket.
+     */
+    static uint64_t bucketUpperBound(int bucket);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> counts{}; ///< Number of values in every bucket.
+    std::atomic<uint64_t> count{0};                      ///< Number of recorded values.
+    std::atomic<uint64_t> sum{0};                        ///< Sum of recorded values.
+    std::atomic<uint64_t> minimum{UINT64_MAX};           ///< Smallest recorded value.
+    std::atomic<uint64_t> maximum{0};                    ///< Largest recorded value.
+};
+
+/**
+ * Histogram merged from all ranks.
+ */
+struct HistogramSummary
+{
+    std::vector<uint64_t> counts; ///< Number of values in every bucket.
+    uint64_t count = 0;           ///< Number of recorded values.
+    uint64_t sum = 0;             ///< Sum of recorded values.
+    uint64_t min = 0;             ///< Smallest recorded value.
+    uint64_t max = 0;             ///< Largest recorded value.
+
+    /**
+     * @param quantile The quantile between 0 and 1.
+     *
+     * @return The value below which the quantile of the recorded values falls.
+     */
+    uint64_t percentile(double quantile) const;
+};
+
+/**
+ * Latency histograms and message counters of a thief.
+ */
+class Metrics
+{
+public:
+    // Enum representing the recorded histograms
+    enum HistogramId
+    {
+        ACQUIRE_WEAPON,          ///< Nanoseconds from requesting a weapon to taking it.
+        ACQUIRE_LABORATORY,      ///< Nanoseconds from requesting a laboratory to entering it.
+        ACK_RTT,                 ///< Nanoseconds from sending a REQUEST to receiving an ACK for it.
+        QUEUE_WEAPON,            ///< Requests queued for the weapons when a REQUEST arrives.
+        QUEUE_LABORATORY,        ///< Requests queued for the laboratories when a REQUEST arrives.
+        REMOTE_OPS,              ///< Remote atomic operations per acquisition or release of the rma protocol.
+        COMMAND_LAG,             ///< Nanoseconds from queueing a request or a release to the receiver sending it.
+        BROADCAST,               ///< Nanoseconds to hand a message over for every thief.
+        HISTOGRAMS
+    };
+
+    static constexpr int MESSAGE_TYPES = 11; ///< Counted message types, larger types share the last counter.
+
+    /**
+     * Records a value into a histogram.
+     *
+     * @param id The histogram to record into.
+     * @param value The value to record.
+     */
+    void record(HistogramId id, uint64_t value) { histograms[id].record(value); }
+
+    /**
+     * Counts a sent message.
+     *
+     * @param message_type The type of the message.
+     */
+    void countSent(int message_type);
+
+    /**
+     * Counts a received message.
+     *
+     * @param message_type The type of the message.
+     */
+    void countReceived(int message_type);
+
+    /**
+     * Merges the metrics of all ranks on rank 0, collective over the communicator.
+     *
+     * @param comm The communicator of all thieves.
+     * @param rank The rank within the communicator.
+     * @param elapsed_s The seconds the metrics cover.
+     * @param json Whether to write JSON instead of a text table.
+     * @param output The file rank 0 writes the report to.
+     * @param thieves_per_rank The number of thieves every rank recorded for.
+     */
+    void report(MPI_Comm comm, int rank, double elapsed_s, bool json, FILE *output, int thieves_per_rank = 1) const;
+
+    /**
+     * Merges the metrics of thieves hosted by this process and reports them.
+     *
+     * @param thieves The metrics of every thief.
+     * @param elapsed_s The seconds the metrics cover.
+     * @param json Whether to write JSON instead of a text table.
+     * @param output The file to write the report to.
+     */
+    static void report(const std::vector<const Metrics *> &thieves, double elapsed_s, bool json, FILE *output);
+
+    /**
+     * Reports metrics that a number of thieves recorded into this object.
+     *
+     * @param size The number of thieves.
+     * @param elapsed_s The seconds the metrics cover.
+     * @param json Whether to write JSON instead of a text table.
+     * @param output The file to write the report to.
+     */
+    void report(int size, double elapsed_s, bool json, FILE *output) const;
+
+    /**
+     * @return The name of a histogram.
+     */
+    static const char *name(HistogramId id);
+
+    /**
+     * @return The values of a histogram recorded into this object.
+     */
+    HistogramSummary summary(HistogramId id) const;
+
+    /**
+     * @return The number of sent messages of a type.
+     */
+    uint64_t sentCount(int message_type) const;
+
+private:
+    /**
+     * Appends the values to be summed, minimized and maximized across thieves.
+     */
+    void collect(std::vector<uint64_t> &sums, std::vector<uint64_t> &mins, std::vector<uint64_t> &maxes) const;
+
+    /**
+     * Writes a report of merged values.
+     */
+    static void write(const std::vector<uint64_t> &sums, const std::vector<uint64_t> &mins,
+                      const std::vector<uint64_t> &maxes, int size, double elapsed_s, bool json, FILE *output);
+
+    std::array<Histogram, HISTOGRAMS> histograms;                ///< The recorded histograms.
+    std::array<std::atomic<uint64_t>, MESSAGE_TYPES> sent{};     ///< Sent messages by type.
+    std::array<std::atomic<uint64_t>, MESSAGE_TYPES> received{}; ///< Received messages by type.
+};
+
+} // namespace mood_thieves
@@ -1,24 +1,103 @@
 #pragma once
 
+#include <array>
 #include <atomic>
-#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <mpi.h>
-#include <mutex>
-#include <queue>
 #include <thread>
 #include <vector>
 
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/metrics.hpp"
+#include "mood_thieves/rma_semaphores.hpp"
+#include "mood_thieves/schedule.hpp"
+#include "mood_thieves/sharded_pool.hpp"
+#include "mood_thieves/spsc_queue.hpp"
+#include "mood_thieves/timer_wheel.hpp"
+#include "mood_thieves/transport.hpp"
 #include "mood_thieves/utils.hpp"
+#include "mood_thieves/workload.hpp"
 
 namespace mood_thieves
 {
 
 /**
  * A thief that wanders around town and steals other people's moods.
+ *
+ * The receiving thread is the only one touching the arbitration state. The business logic and the timer
+ * thread hand their requests and releases over as commands, each through its own single-producer queue,
+ * and the receiver tells the business logic a unit was taken through an atomic it waits on.
  */
 class MoodThieve
 {
 private:
+    /**
+     * A request, a release or the FINISH another thread leaves to the receiving thread.
+     */
+    struct Command
+    {
+        int message_type;  ///< REQUEST, RELEASE or FINISH.
+        int resource_type; ///< The type of resource, -1 for FINISH.
+        int64_t queued_ns; ///< When the command was queued.
+        int source;        ///< The schedule::Kind of the queue it came through.
+    };
+
+    /**
+     * Hands a command over to the receiving thread and wakes it, the rma protocol runs it right away.
+     *
+     * @param commands The queue of the calling thread.
+     * @param message_type The message type of the command.
+     * @param resource_type The type of resource of the command.
+     */
+    void queueCommand(SpscQueue<Command> &commands, int message_type, int resource_type);
+
+    /**
+     * Runs all queued commands, only called by the receiving thread.
+     *
+     * @return The number of commands run.
+     */
+    int runCommands();
+
+    /**
+     * Handles the held back messages and the queued commands in the order of the replayed schedule, and as
+     * they come once it ended or the thief left it, only called by the receiving thread.
+     *
+     * @return The number of messages and commands handled.
+     */
+    int followSchedule();
+
+    /**
+     * Records a step of the receiving thread or checks it against the replayed schedule.
+     *
+     * @param entry The step taken.
+     */
+    void step(const schedule::Entry &entry);
+
+    /**
+     * Sends the messages of a single command.
+     *
+     * @param command The command to run.
+     */
+    void runCommand(const Command &command);
+
+    /**
+     * Takes the unit of the pending request of a resource if it may enter and wakes the business logic.
+     *
+     * @param resource_type The type of resource to check.
+     */
+    void grant(int resource_type);
+
+    /**
+     * Blocks the business logic until the pending request of a resource entered.
+     *
+     * @param resource_type The type of resource requested.
+     *
+     * @return The shard of the unit taken, 0 under the rma protocol.
+     */
+    int waitFor(int resource_type);
+
     /**
      * Creates and broadcasts the message to all other thieves including itself.
      *
@@ -35,79 +114,146 @@ private:
     void sendRequest(int resource_type);
 
     /**
-     * Acknowledge to a specific thief that the message has been received.
+     * Sends a single message to a specific thief.
+     *
+     * @param message_type The type of message to send.
+     * @param message_data The data of the message.
+     * @param thief_id The identifier of the thief to send to.
+     */
+    void send(int message_type, const utils::message_data_t &message_data, int thief_id);
+
+    /**
+     * Gives up the pending request of a resource. A unit granted already is released, under the broadcast
+     * protocol the WITHDRAW goes to all thieves including this one, the other protocols release the unit as
+     * soon as it is granted unless the next request takes it over.
      *
-     * @param resource_type The type of resource to acknowledge about.
-     * @param thief_id The identifier of the thief to acknowledge to.
+     * @param resource_type The type of resource to withdraw the request for.
      */
-    void sendAck(int resource_type, int thief_id);
+    void sendWithdraw(int resource_type);
+
+    /**
+     * Queues the request of a resource for the receiving thread, the business logic waits for it later.
+     *
+     * @param resource_type The type of resource to request.
+     */
+    void request(int resource_type);
 
     /**
      * Sends the release message to all other thieves including itself.
      *
      * @param resource_type The type of resource to release.
+     * @param shard The shard the unit was taken from, ignored by the rma protocol.
+     */
+    void sendRelease(int resource_type, int shard);
+
+    /**
+     * Checks whether the pending ticket of a resource may enter under the rma protocol, polls its pool if not yet.
+     * Only called by the business logic thread.
+     *
+     * @param resource_type The type of resource to check.
+     *
+     * @return True if the thief can take the unit, false otherwise.
      */
-    void sendRelease(int resource_type);
+    bool isRmaGranted(int resource_type);
 
     /**
-     * Checks whether thieve can enter the critical section of weapons.
+     * Handles a single message received from another thief.
      *
-     * @return True if the thief can enter the critical section of weapons, false otherwise.
+     * @param message The received message, its type is the tag it was sent with.
      */
-    bool isWeapon();
+    void handleMessage(const utils::message_t &message);
 
     /**
-     * Checks whether thieve can enter the critical section of lobaroatories.
+     * @param resource_type The type of resource the messages are about.
      *
-     * @return True if the thief can enter the critical section of lobarotories, false otherwise.
+     * @return Sends the messages of the arbitration of a resource, with the shard in the resource type.
      */
-    bool isLaboratory();
+    ShardedPool::Send sender(int resource_type);
 
     /**
-     * Frees the weapon after a given timeout.
-     * Should be executed in a parallel thread.
+     * Starts recharging the weapon and schedules freeing it after a given timeout.
      *
      * @param timeout The timeout after which the weapon should be freed.
+     * @param shard The shard the weapon was taken from.
      */
-    void free_weapon_with_timeout(int timeout);
+    void free_weapon_with_timeout(std::chrono::microseconds timeout, int shard);
 
     /**
-     * Empties the weapon queue once the weapon is freed.
+     * Frees the recharged weapon, runs on the timer thread.
+     *
+     * @param shard The shard the weapon was taken from.
+     */
+    void free_weapon(int shard);
+
+    /**
+     * Waits for the weapon to recharge and tells all thieves that this one is done.
+     */
+    void finish();
+
+    /**
+     * Reports the merged metrics periodically until any thief starts finishing.
      * Should be executed in a parallel thread.
      */
-    void free_weapon_queue();
+    void metrics_loop();
 
-    utils::LamportClock clock; ///< The Lamport clock.
-    MPI_Datatype msg_t;        ///< The type of message to use for communication with other thieves.
+    /**
+     * @return Nanoseconds since the thief started.
+     */
+    int64_t elapsedNs() const;
+
+    utils::LamportClock clock; ///< The Lamport clock, advanced by the receiver and read by every thread.
+    Transport &transport;      ///< Moves the messages to and from the other thieves.
     int size;                  ///< The total number of thieves.
+    Config config;             ///< The runtime configuration.
+
+    Metrics metrics;                               ///< Latency histograms and message counters.
+    std::chrono::steady_clock::time_point started; ///< When the thief started.
+    std::array<std::atomic<int64_t>, 2> request_ns{}; ///< When the pending request of every resource was sent.
+    MPI_Comm metrics_comm = MPI_COMM_NULL;         ///< Communicator of the metrics reports.
+    FILE *metrics_output = nullptr;                ///< The file rank 0 reports the metrics to.
+    std::atomic<bool> finishing{false};            ///< Whether the periodic reports should stop.
+    std::thread metrics_thread;                    ///< The thread reporting the metrics periodically.
+
+    std::atomic<bool> end{false};                   ///< Flag to indicate that the thief receiving thread should end.
+    std::thread logic_thread;                       ///< The thread responsible for handling business logic.
+    int finished = 0;                               ///< The number of thieves that sent FINISH.
+    std::atomic<int> recharging{0};                 ///< Weapons recharging or not yet released by the receiver.
+    int max_weapons;                                ///< The most weapons the thief holds at once.
+    SpscQueue<Command> logic_commands{16};          ///< Commands of the business logic thread.
+    SpscQueue<Command> timer_commands{16};          ///< Commands of the timer thread.
+    utils::Doorbell doorbell;                       ///< Rung for every command, cuts an adaptive sleep short.
+    bool executing = false;                         ///< Whether the receiver runs commands, their messages go at once.
+    std::array<std::atomic<uint32_t>, 2> granted{}; ///< Shard entered by every pending request plus one, 0 before.
+    Workload workload;                              ///< Draws the phase durations and the victims.
+    schedule::Recorder *recorder = nullptr;         ///< Records the steps of the receiver, null records none.
+    schedule::Replay *replay = nullptr;             ///< The steps the receiver follows, null follows none.
+    std::deque<utils::message_t> held;              ///< Arrived messages a replay did not get to yet.
 
-    std::atomic<bool> end{false};                ///< Flag to indicate that the thief receiving thread should end.
-    std::thread logic_thread;                    ///< The thread responsible for handling business logic.
-    std::thread free_weapon_queue_thread;        ///< The thread responsible for freeing weapons.
-    std::queue<std::thread> free_weapon_threads; ///< The threads responsible for freeing weapons.
-    std::condition_variable wv; ///< Condition variable to unsleep the business logic thread for a weapon;
-    std::condition_variable lv; ///< Condition variable to unsleep the business logic thread for a laboratory;
-    std::mutex wv_mutex;        ///< Mutex to protect the condition variable for weapons.
-    std::mutex lv_mutex;        ///< Mutex to protect the condition variable for laboratories.
-    std::mutex new_mutex;       ///< Mutex to protect the condition variable for laboratories.
+    std::array<ShardedPool, 2> pools;   ///< Arbitration of the weapons and laboratories, owned by the receiver.
+    std::unique_ptr<RmaSemaphores> rma; ///< Semaphores of the rma protocol, null under the other protocols.
+    uint32_t rma_tickets[2] = {};       ///< The pending ticket of every resource, owned by the business logic.
+    bool rma_granted[2] = {};           ///< Whether the pending ticket of every resource may enter.
+    int rma_operations[2] = {};         ///< Remote operations spent on the pending ticket of every resource.
 
-    std::vector<utils::message_data_t> weapons_data_vector;      ///< The queue of requests for a weapon.
-    std::vector<utils::message_data_t> laborotories_data_vector; ///< The queue of requests for a weapon.
-    std::mutex weapons_data_vector_mutex;                        ///< Mutex to protect the weapon requests queue.
-    std::mutex laborotories_data_vector_mutex;                   ///< Mutex to protect the weapon requests queue.
+    int laboratory_entries = 0;             ///< The number of times the thief entered the laboratory.
+    std::atomic<long> messages_sent{0};     ///< The number of messages sent to other thieves.
+    pthread_t receiver_thread;              ///< The thread receiving messages, used to report its CPU time.
 
-    int weapons_ack = 0;
-    int laboratories_ack = 0;
+    TimerWheel timers; ///< Frees recharged weapons, declared last to stop before the state its callbacks use.
 
 public:
     /**
      * Constructor
      *
-     * @param message_type The type of message to use for communication with other thieves.
+     * Has to run on the thread that receives the messages.
+     *
+     * @param transport The transport to the other thieves.
      * @param id The identifier of the thief.
      * @param size The total number of thieves.
+     * @param config The runtime configuration.
+     * @param comm The communicator to merge the metrics over, MPI_COMM_NULL leaves merging to the caller.
      */
-    MoodThieve(MPI_Datatype message_type, int id, int size);
+    MoodThieve(Transport &transport, int id, int size, const Config &config, MPI_Comm comm = MPI_COMM_WORLD);
 
     /**
      * Destructor
@@ -120,9 +266,33 @@ public:
     void business_logic();
 
     /**
-     * Receives messages from other thieves in an infinity loop.
+     * Receives messages from other thieves until every thief sent FINISH.
      */
     void receiveMessages();
+
+    /**
+     * Records the steps of the receiving thread, has to be called before receiveMessages.
+     *
+     * @param schedule The open schedule file, outliving receiveMessages.
+     */
+    void recordSchedule(schedule::Recorder &schedule) { recorder = &schedule; }
+
+    /**
+     * Makes the receiving thread follow recorded steps, has to be called before receiveMessages.
+     *
+     * @param schedule The read schedule, outliving receiveMessages.
+     */
+    void replaySchedule(schedule::Replay &schedule) { replay = &schedule; }
+
+    /**
+     * Stops the periodic reports and reports the metrics merged from all thieves, collective over all thieves.
+     */
+    void reportMetrics();
+
+    /**
+     * @return The metrics of this thief alone.
+     */
+    const Metrics &getMetrics() const { return metrics; }
 };
 
 } // namespace mood_thieves
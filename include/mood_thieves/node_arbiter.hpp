@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+#include "mood_thieves/arbitration.hpp"
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/metrics.hpp"
+#include "mood_thieves/transport.hpp"
+#include "mood_thieves/utils.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * Two-level arbitration of the weapons and laboratories for ranks sharing a node.
+ *
+ * The ranks of a node queue for units in an MPI_Win_allocate_shared window: a rank takes a ticket and
+ * spins until the leader of the node, its rank 0, grants tickets up to it. Only the leaders take part in
+ * the configured protocol, among themselves, acquiring units on behalf of their node one at a time. A
+ * unit held by a node goes from one local holder to the next for up to lease holders in a row and back
+ * to the other nodes once nobody of the node waits for it. The inter-node messages therefore scale with
+ * the number of nodes instead of the number of ranks.
+ */
+class NodeArbiter
+{
+public:
+    /**
+     * Constructor, splits the communicator into nodes and maps the shared window, collective over comm.
+     *
+     * @param comm The communicator of all ranks.
+     * @param batch_type The MPI type of a single batch entry, see utils::initialize_batch_type.
+     * @param config The configuration, node_size overrides the nodes found by MPI_Comm_split_type.
+     * @param metrics The metrics to record the inter-node messages into.
+     */
+    NodeArbiter(MPI_Comm comm, MPI_Datatype batch_type, const Config &config, Metrics &metrics);
+
+    /**
+     * Destructor, frees the window and the communicators, collective over comm.
+     */
+    ~NodeArbiter();
+
+    NodeArbiter(const NodeArbiter &) = delete;
+    NodeArbiter &operator=(const NodeArbiter &) = delete;
+
+    /**
+     * Waits for a unit of a resource, safe to call from any thread of the node.
+     *
+     * @param resource_type The resource to acquire.
+     */
+    void acquire(int resource_type);
+
+    /**
+     * Gives a unit of a resource back to the node.
+     *
+     * @param resource_type The resource to release.
+     */
+    void release(int resource_type);
+
+    /**
+     * Tells the leader that the calling rank will not acquire anything anymore.
+     */
+    void finish();
+
+    /**
+     * Takes part in the inter-node protocol for the node until every node finished, only on the leader.
+     */
+    void lead();
+
+    /**
+     * @return Whether the rank is the leader of its node.
+     */
+    bool isLeader() const { return node_rank == 0; }
+
+    /**
+     * @return The number of nodes.
+     */
+    int nodeCount() const { return nodes; }
+
+    /**
+     * @return The Lamport clock the leader of the node published last, safe to call from any rank of the node.
+     */
+    int lamportClock() const { return state->clock.load(std::memory_order_acquire); }
+
+private:
+    /**
+     * A queue of the ranks of a node for one resource, in the shared window.
+     */
+    struct SharedQueue
+    {
+        alignas(64) std::atomic<uint32_t> tickets;  ///< Tickets taken by the ranks of the node.
+        alignas(64) std::atomic<uint32_t> granted;  ///< Tickets granted by the leader, in ticket order.
+        alignas(64) std::atomic<uint32_t> released; ///< Units the ranks gave back.
+    };
+
+    /**
+     * The shared window of a node.
+     */
+    struct SharedState
+    {
+        SharedQueue queues[2];                 ///< The queues of the weapons and the laboratories.
+        alignas(64) std::atomic<int> finished; ///< The ranks of the node that finished.
+        alignas(64) std::atomic<int> clock;    ///< The Lamport clock of the leader, for the traces of the node.
+    };
+
+    /**
+     * The units a leader holds for its node of one resource.
+     */
+    struct Lease
+    {
+        uint32_t granted = 0;    ///< Tickets granted so far.
+        uint32_t released = 0;   ///< Releases seen so far.
+        std::deque<int> idle;    ///< Local holders served by every unit nobody of the node holds.
+        std::deque<int> in_use;  ///< Local holders served by every unit a rank of the node holds.
+        bool requesting = false; ///< Whether a request of the node is pending.
+        int max_held = 1;        ///< The most units the node may hold at once.
+    };
+
+    /**
+     * Grants and returns the units of a resource according to the shared queue, on the leader.
+     *
+     * @return Whether anything changed.
+     */
+    bool progress(int resource_type);
+
+    /**
+     * Returns a unit to the other nodes, on the leader.
+     */
+    void releaseGlobally(int resource_type);
+
+    /**
+     * Handles a message of another leader.
+     */
+    void handleMessage(const utils::message_t &message);
+
+    /**
+     * @return Sends the messages of the inter-node arbitration of a resource.
+     */
+    Arbitration::Send sender(int resource_type);
+
+    Config config;                           ///< The runtime configuration.
+    Metrics &metrics;                        ///< Metrics of the inter-node messages.
+    MPI_Comm node_comm = MPI_COMM_NULL;      ///< The ranks of the node.
+    MPI_Comm leaders_comm = MPI_COMM_NULL;   ///< The leaders of all nodes, only on a leader.
+    MPI_Win window = MPI_WIN_NULL;           ///< The shared window of the node.
+    SharedState *state = nullptr;            ///< The shared state in the window.
+    int node_rank = 0;                       ///< The rank within the node.
+    int node_size = 0;                       ///< The number of ranks of the node.
+    int node = 0;                            ///< The index of the node among the leaders.
+    int nodes = 0;                           ///< The number of nodes.
+    std::unique_ptr<MpiTransport> transport; ///< The transport between the leaders.
+    std::vector<Arbitration> pools;          ///< The inter-node arbitration of both resources.
+    Lease leases[2];                         ///< The units held for the node of both resources.
+    int clock = 0;                           ///< The Lamport clock of the leader.
+    int finished_nodes = 0;                  ///< The leaders that sent FINISH.
+};
+
+} // namespace mood_thieves
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <functional>
+#include <mpi.h>
+#include <vector>
+
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/utils.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * Receives messages through a ring of pre-posted persistent receives.
+ *
+ * Every slot of the ring is an MPI_Recv_init request for a batch of messages matching any source and any tag.
+ * Since incoming messages always match the earliest posted receive, the slots complete
+ * in ring order and are handed out strictly in that order, which keeps the per-sender
+ * FIFO ordering the protocol relies on.
+ */
+class ReceiveEngine
+{
+public:
+    using Handler = std::function<void(const utils::message_t &)>;
+
+    /**
+     * Constructor, posts all receives of the ring.
+     *
+     * @param batch_type The type of a batch entry to receive.
+     * @param comm The communicator to receive on.
+     * @param slots The number of receives to keep posted.
+     * @param max_batch The maximum number of messages in a batch.
+     */
+    ReceiveEngine(MPI_Datatype batch_type, MPI_Comm comm, int slots, int max_batch);
+
+    /**
+     * Destructor, cancels and frees all receives of the ring.
+     */
+    ~ReceiveEngine();
+
+    ReceiveEngine(const ReceiveEngine &) = delete;
+    ReceiveEngine &operator=(const ReceiveEngine &) = delete;
+
+    /**
+     * Handles all messages that already arrived without blocking.
+     *
+     * @param handler The function to call for every received message.
+     *
+     * @return The number of handled messages.
+     */
+    int poll(const Handler &handler);
+
+    /**
+     * Blocks until at least one message arrives and handles all arrived messages.
+     *
+     * @param handler The function to call for every received message.
+     *
+     * @return The number of handled messages.
+     */
+    int wait(const Handler &handler);
+
+private:
+    /**
+     * Hands out the completed slots at the head of the ring and re-posts them.
+     *
+     * @param completed The number of entries of indices filled by MPI.
+     * @param handler The function to call for every received message.
+     *
+     * @return The number of handled messages.
+     */
+    int drain(int completed, const Handler &handler);
+
+    MPI_Datatype batch_type;                    ///< The type of a batch entry.
+    int max_batch;                              ///< The maximum number of messages in a batch.
+    std::vector<utils::wire_message_t> buffers; ///< Receive buffer of every slot, max_batch entries each.
+    std::vector<MPI_Request> requests;          ///< Persistent receive of every slot.
+    std::vector<MPI_Status> statuses;           ///< Statuses filled by MPI_Testsome/MPI_Waitsome.
+    std::vector<int> indices;                   ///< Indices filled by MPI_Testsome/MPI_Waitsome.
+    std::vector<int> counts;                    ///< Number of messages received by every completed slot.
+    std::vector<bool> completed_slots;          ///< Whether the slot completed but was not handled yet.
+    int head = 0;                               ///< The oldest posted slot.
+};
+
+/**
+ * Decides how the receiving thread idles when no message is available.
+ *
+ * The thread first spins, then yields the processor and finally sleeps
+ * with an exponentially growing timeout bounded by the configuration.
+ */
+class IdlePolicy
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param config The configuration holding the spin, yield and sleep bounds.
+     */
+    explicit IdlePolicy(const Config &config);
+
+    /**
+     * Idles once after an empty poll.
+     *
+     * @param doorbell Rung when work other than messages arrives, cuts a sleep short. Null sleeps the whole time.
+     * @param seen The rings of the doorbell read before the empty poll.
+     */
+    void idle(utils::Doorbell *doorbell = nullptr, uint32_t seen = 0);
+
+    /**
+     * Resets the policy back to spinning after a message arrived.
+     */
+    void reset();
+
+private:
+    int spin_iterations;  ///< Idle polls spent spinning.
+    int yield_iterations; ///< Idle polls spent yielding.
+    int max_backoff_us;   ///< Upper bound of the sleep.
+    int idle_polls = 0;   ///< Idle polls since the last message.
+    int backoff_us = 1;   ///< Current sleep.
+};
+
+} // namespace mood_thieves
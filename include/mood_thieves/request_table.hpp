@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mood_thieves
+{
+
+/**
+ * The queued requests of all thieves for a pool, a table of packed (clock, id) keys indexed by thief.
+ *
+ * Every thief owns a row of slots, so queueing and removing a request only touches its row whatever the
+ * number of thieves. The position of a request in the (clock, id) order is the number of smaller keys,
+ * counted in a single pass over the contiguous keys, four at a time with AVX2 where the processor has it.
+ * The position of the watched request, the pending one of the thief, is counted once and then kept up to
+ * date by every insert and remove, so checking it is O(1) as well.
+ * A free slot holds FREE, which is larger than every key. A row doubles once a thief queues more requests
+ * than it has slots, a thief only holds a few units at a time so that is rare.
+ */
+class RequestTable
+{
+public:
+    static constexpr uint64_t FREE = INT64_MAX; ///< Key of a free slot, signed compares stay valid.
+
+    /**
+     * Constructor
+     *
+     * @param size The total number of thieves.
+     * @param slots The initial number of requests every thief can queue.
+     */
+    explicit RequestTable(int size, int slots = 2);
+
+    /**
+     * Packs a request into its key, keys order like (clock, id).
+     *
+     * @param clock The Lamport clock of the request.
+     * @param thief_id The identifier of the requesting thief.
+     *
+     * @return The key of the request.
+     */
+    static uint64_t key(int clock, int thief_id)
+    {
+        return static_cast<uint64_t>(static_cast<uint32_t>(clock)) << 32 | static_cast<uint32_t>(thief_id);
+    }
+
+    /**
+     * Queues a request.
+     *
+     * @param thief_id The identifier of the requesting thief.
+     * @param clock The Lamport clock of the request.
+     */
+    void insert(int thief_id, int clock);
+
+    /**
+     * @return The key of the oldest request of a thief, FREE if it has none.
+     */
+    uint64_t oldest(int thief_id) const;
+
+    /**
+     * Removes a queued request.
+     *
+     * @param thief_id The identifier of the requesting thief.
+     * @param key The key of the request.
+     */
+    void remove(int thief_id, uint64_t key);
+
+    /**
+     * Checks whether a request is queued.
+     *
+     * @param thief_id The identifier of the requesting thief.
+     * @param key The key of the request.
+     *
+     * @return True if the request is queued, false otherwise.
+     */
+    bool contains(int thief_id, uint64_t key) const;
+
+    /**
+     * Starts keeping the position of a request, queued or not yet.
+     *
+     * @param key The key of the request.
+     */
+    void watch(uint64_t key);
+
+    /**
+     * @return The number of queued requests older than the given key, O(1) for the watched one.
+     */
+    int countBefore(uint64_t key) const
+    {
+        return key == watched ? watched_before : countLess(keys.data(), keys.size(), key);
+    }
+
+    /**
+     * @return The number of queued requests.
+     */
+    int count() const { return requests; }
+
+    /**
+     * Counts the keys smaller than a key, with AVX2 if the processor supports it.
+     *
+     * @param keys The keys, all of them at most FREE.
+     * @param count The number of keys.
+     * @param key The key to compare with.
+     *
+     * @return The number of smaller keys.
+     */
+    static int countLess(const uint64_t *keys, size_t count, uint64_t key);
+
+    /**
+     * Counts the keys smaller than a key one at a time, the fallback of countLess.
+     */
+    static int countLessScalar(const uint64_t *keys, size_t count, uint64_t key);
+
+    /**
+     * @return Whether countLess uses AVX2.
+     */
+    static bool vectorized();
+
+private:
+    /**
+     * Doubles the slots of every row.
+     */
+    void grow();
+
+    int size;                   ///< The total number of thieves.
+    int slots;                  ///< The slots of every row.
+    int requests = 0;           ///< The number of queued requests.
+    std::vector<uint64_t> keys; ///< The rows of all thieves, thief i owns slots [i * slots, (i + 1) * slots).
+    uint64_t watched = FREE;    ///< The key of the watched request.
+    int watched_before = 0;     ///< The number of queued requests older than the watched one.
+};
+
+} // namespace mood_thieves
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+namespace mood_thieves
+{
+
+/**
+ * Ricart-Agrawala arbitration of a pool of indistinguishable units.
+ *
+ * The pool is shared k-of-n in the way of Raymond's algorithm: a request is sent to every other thief,
+ * a thief that holds units or has an older request defers its answer, and the requester enters as soon
+ * as the units that may still be in use by the others together with its own fit into the pool.
+ * Since a thief may hold several units at once (a recharging weapon and a new one), every answer
+ * carries a number of units and every peer owes max_held units per request.
+ * There is no RELEASE message, the deferred answers are sent once the units are released.
+ *
+ * The class only keeps the state, sending the messages is left to the caller.
+ */
+class RicartAgrawala
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param id The identifier of the thief.
+     * @param size The total number of thieves.
+     * @param capacity The number of units in the pool.
+     * @param max_held The maximum number of units a single thief can hold at once.
+     */
+    RicartAgrawala(int id, int size, int capacity, int max_held);
+
+    /**
+     * Starts a request for a unit.
+     *
+     * @param clock The Lamport clock of the request.
+     *
+     * @return The thieves the request should be sent to right away, the others still owe an answer
+     *         to the previous request and get it once they paid it off.
+     */
+    std::vector<int> request(int clock);
+
+    /**
+     * Handles a request of another thief.
+     *
+     * @param thief_id The identifier of the requesting thief.
+     * @param clock The Lamport clock of the request.
+     *
+     * @return The number of units to acknowledge right away, the rest is deferred until released.
+     */
+    int receiveRequest(int thief_id, int clock);
+
+    /**
+     * Handles an acknowledgement of another thief.
+     *
+     * @param thief_id The identifier of the acknowledging thief.
+     * @param units The number of acknowledged units.
+     *
+     * @return The thieves the pending request should be sent to now.
+     */
+    std::vector<int> receiveAck(int thief_id, int units);
+
+    /**
+     * Checks whether the pending request can enter the pool.
+     *
+     * @return True if the thief can take a unit, false otherwise.
+     */
+    bool canEnter() const;
+
+    /**
+     * Takes a unit for the pending request.
+     */
+    void enter();
+
+    /**
+     * Releases the oldest held unit.
+     *
+     * @return Pairs of thief identifier and number of units to acknowledge to them.
+     */
+    std::vector<std::pair<int, int>> release();
+
+    /**
+     * @return The Lamport clock of the pending request.
+     */
+    int requestClock() const { return request_clock; }
+
+    /**
+     * @return The number of thieves whose request waits for a unit of this thief.
+     */
+    int queueDepth() const;
+
+private:
+    /**
+     * Checks whether a request has priority over another one.
+     *
+     * @return True if (clock, id) is older than (other_clock, other_id).
+     */
+    static bool older(int clock, int id, int other_clock, int other_id);
+
+    int id;       ///< The identifier of the thief.
+    int capacity; ///< The number of units in the pool.
+    int max_held; ///< The maximum number of units a single thief can hold at once.
+
+    bool requesting = false; ///< Whether there is a pending request.
+    int request_clock = 0;   ///< The Lamport clock of the pending request.
+    std::vector<int> held;   ///< Lamport clocks of the requests of the held units, oldest first.
+
+    std::vector<int> owed;       ///< Units every thief still owes to the pending request.
+    std::vector<int> debt;       ///< Units every thief still owes to previous requests.
+    std::vector<bool> postponed; ///< Whether the pending request waits for the debt to be sent.
+    std::vector<std::vector<int>> deferred; ///< Clocks of own units every thief waits for.
+};
+
+} // namespace mood_thieves
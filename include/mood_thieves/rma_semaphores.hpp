@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <mpi.h>
+
+#include "mood_thieves/config.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * The weapons and the laboratories as FIFO ticket semaphores in an MPI window, arbitrated with one-sided
+ * atomics instead of messages.
+ *
+ * Every pool is a single 64-bit word on its home rank, the tickets taken in the upper half and the units
+ * released in the lower one. Taking a ticket adds one to the upper half with MPI_Fetch_and_op and reads
+ * both halves at once, a ticket is granted once fewer than capacity tickets before it were not released
+ * yet. An uncontended acquisition is therefore a single remote operation, a contended one polls the word
+ * with MPI_NO_OP, and a release is a single remote increment. The window stays locked with
+ * MPI_Win_lock_all for its whole lifetime, every operation is completed with MPI_Win_flush.
+ *
+ * Neither half wraps around: a run takes fewer than 2^32 - 1 tickets of a pool and aborts on the last one, and
+ * since every released unit had a ticket the released units stay below the tickets and never carry into them.
+ */
+class RmaSemaphores
+{
+public:
+    /**
+     * Constructor, allocates the window, collective over comm.
+     *
+     * @param comm The communicator of all thieves.
+     * @param config The runtime configuration.
+     */
+    RmaSemaphores(MPI_Comm comm, const Config &config);
+
+    /**
+     * Destructor, frees the window, collective over comm.
+     */
+    ~RmaSemaphores();
+
+    RmaSemaphores(const RmaSemaphores &) = delete;
+    RmaSemaphores &operator=(const RmaSemaphores &) = delete;
+
+    /**
+     * Takes the next ticket of a pool.
+     *
+     * @param resource_type The pool to take a ticket of.
+     * @param granted Set to whether the ticket may enter right away.
+     *
+     * @return The ticket.
+     */
+    uint32_t take(int resource_type, bool &granted);
+
+    /**
+     * Reads a pool and checks whether a ticket may enter.
+     *
+     * @param resource_type The pool of the ticket.
+     * @param ticket The ticket returned by take.
+     *
+     * @return True if the ticket may enter, false otherwise.
+     */
+    bool poll(int resource_type, uint32_t ticket);
+
+    /**
+     * Returns a unit to a pool.
+     *
+     * @param resource_type The pool to return the unit to.
+     */
+    void release(int resource_type);
+
+private:
+    /**
+     * @return Whether a ticket may enter a pool with the given number of released units.
+     */
+    bool mayEnter(int resource_type, uint32_t ticket, uint32_t released) const;
+
+    MPI_Win window = MPI_WIN_NULL; ///< The window holding the word of every pool on its home rank.
+    int homes[2];                  ///< The rank holding the word of the weapons and the laboratories.
+    int capacities[2];             ///< The number of weapons and laboratories.
+};
+
+} // namespace mood_thieves
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace mood_thieves
+{
+namespace schedule
+{
+
+// Enum representing what the receiving thread handled
+enum Kind : uint8_t
+{
+    MESSAGE = 0,       ///< A message of the peer.
+    TIMER_COMMAND = 1, ///< A command of the timer thread.
+    LOGIC_COMMAND = 2  ///< A command of the business logic thread.
+};
+
+/**
+ * A single step of the receiving thread of a thief.
+ */
+struct Entry
+{
+    int32_t clock;         ///< Lamport clock of the thief once the step started.
+    int32_t message_clock; ///< Lamport clock carried by the message, 0 for a command.
+    int16_t peer;          ///< The sender of the message, -1 for a command.
+    uint8_t kind;          ///< The Kind of the step.
+    uint8_t message_type;  ///< The utils::MessageType of the message or the command.
+    uint8_t resource;      ///< The utils::ResourceType involved, 255 if none.
+    uint8_t padding[3];    ///< Keeps the entry at 16 bytes.
+
+    bool operator==(const Entry &other) const
+    {
+        return clock == other.clock && message_clock == other.message_clock && peer == other.peer &&
+               kind == other.kind && message_type == other.message_type && resource == other.resource;
+    }
+};
+
+/**
+ * Header at the start of every per-thief schedule file.
+ */
+struct FileHeader
+{
+    char magic[4];       ///< Always "MTSC".
+    uint32_t version;    ///< Version of the format.
+    int32_t thief;       ///< The thief that recorded the file.
+    uint32_t entry_size; ///< sizeof(Entry) of the writer.
+};
+
+const uint32_t VERSION = 1;
+
+/**
+ * @return The path of the schedule file of a thief, <prefix>.<thief>.schedule.
+ */
+std::string path(const std::string &prefix, int thief_id);
+
+/**
+ * Writes the steps of the receiving thread of a thief to its schedule file.
+ *
+ * Only the receiving thread appends, entries are buffered and written in blocks.
+ */
+class Recorder
+{
+public:
+    Recorder() = default;
+    Recorder(const Recorder &) = delete;
+    Recorder &operator=(const Recorder &) = delete;
+
+    /**
+     * Destructor, closes the file.
+     */
+    ~Recorder() { close(); }
+
+    /**
+     * Creates the schedule file of a thief.
+     *
+     * @param prefix The path prefix of the file.
+     * @param thief_id The identifier of the thief.
+     *
+     * @return Status code, -1 if the file cannot be opened.
+     */
+    int open(const std::string &prefix, int thief_id);
+
+    /**
+     * Appends a step.
+     *
+     * @param entry The step.
+     */
+    void append(const Entry &entry);
+
+    /**
+     * Writes the buffered steps and closes the file.
+     */
+    void close();
+
+private:
+    FILE *file = nullptr;       ///< The schedule file.
+    std::vector<Entry> entries; ///< Steps not written yet.
+};
+
+/**
+ * The recorded steps of the receiving thread of a thief, followed one by one during a replay.
+ *
+ * Once a step differs from the recording the rest of it no longer applies, the replay stops there.
+ */
+class Replay
+{
+public:
+    /**
+     * Reads the schedule file of a thief.
+     *
+     * @param prefix The path prefix of the file.
+     * @param thief_id The identifier of the thief.
+     *
+     * @return Status code, -1 if the file cannot be read or was not recorded by the thief.
+     */
+    int open(const std::string &prefix, int thief_id);
+
+    /**
+     * @return Whether steps are left to follow, false once all were taken or one differed.
+     */
+    bool following() const { return position < entries.size() && !diverged; }
+
+    /**
+     * @return The next step to take, only valid while following.
+     */
+    const Entry &next() const { return entries[position]; }
+
+    /**
+     * Takes the next step, reports it and stops following if it differs from the recording.
+     *
+     * @param taken The step the thief took.
+     */
+    void take(const Entry &taken);
+
+    /**
+     * @return The number of steps taken so far.
+     */
+    size_t taken() const { return position; }
+
+    /**
+     * @return The number of recorded steps.
+     */
+    size_t length() const { return entries.size(); }
+
+    /**
+     * @return Whether a step differed from the recording.
+     */
+    bool divergent() const { return diverged; }
+
+private:
+    int thief = 0;              ///< The identifier of the thief.
+    std::vector<Entry> entries; ///< The recorded steps.
+    size_t position = 0;        ///< The next step to take.
+    bool diverged = false;      ///< Whether a step differed from the recording.
+};
+
+} // namespace schedule
+} // namespace mood_thieves
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "mood_thieves/arbitration.hpp"
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/utils.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * A pool of a resource split into shards, each arbitrated under the configured protocol by its subscribers only.
+ *
+ * Every thief subscribes to two shards and every shard holds its share of the units, so a shard is arbitrated by
+ * about 2K/M of the K thieves and an acquisition costs messages to them instead of to everyone. A request goes to
+ * the subscribed shard with the fewer requests queued per unit, as seen from the REQUESTs the thief received:
+ * the power of two choices keeps the shards about as busy as one pool would be. Units are released in the order
+ * they were taken, each to its own shard. With a single shard the pool is the Arbitration of all thieves.
+ *
+ * Thieves are numbered within a shard by their position among its subscribers, the shard translates the
+ * identifiers of every message it receives and sends.
+ */
+class ShardedPool
+{
+public:
+    /**
+     * Sends a message about a shard of the resource: the identifier of the thief to send to, the message type,
+     * the Lamport clock of the message, the shard and the protocol specific value.
+     */
+    using Send = std::function<void(int thief_id, int message_type, int clock, int shard, int value)>;
+
+    /**
+     * Constructor
+     *
+     * @param protocol The arbitration protocol.
+     * @param id The identifier of the thief.
+     * @param size The total number of thieves.
+     * @param capacity The number of units in the pool, at least one per shard.
+     * @param max_held The most units the thief holds at once, see RicartAgrawala.
+     * @param ack_horizon Pools queued ahead that hold back an ACK under the broadcast protocol, see LamportQueue.
+     * @param shards The number of shards, 1 arbitrates the pool among all thieves.
+     */
+    ShardedPool(Protocol protocol, int id, int size, int capacity, int max_held, int ack_horizon = 0,
+                int shards = 1);
+
+    /**
+     * @param thief_id The identifier of a thief.
+     * @param shards The number of shards.
+     *
+     * @return The shards the thief subscribes to, two unless there is only one.
+     */
+    static std::vector<int> subscriptions(int thief_id, int shards);
+
+    /**
+     * @param capacity The number of units in the pool.
+     * @param shards The number of shards.
+     * @param shard The shard.
+     *
+     * @return The units of the shard, the units left over go to the first shards.
+     */
+    static int shardCapacity(int capacity, int shards, int shard);
+
+    /**
+     * Starts a request for a unit in the less loaded subscribed shard the thief does not hold its share of yet.
+     *
+     * Where the thief holds its share of every subscribed shard, the request is postponed to the next release.
+     *
+     * @param clock The Lamport clock of the request.
+     * @param send Sends the resulting messages.
+     */
+    void request(int clock, const Send &send);
+
+    /**
+     * Releases a held unit of a shard, nothing if the thief holds none of it.
+     *
+     * @param shard The shard the unit was taken from, as enter() returned it.
+     * @param clock The Lamport clock of the thief.
+     * @param send Sends the resulting messages.
+     */
+    void release(int shard, int clock, const Send &send);
+
+    /**
+     * Gives up the pending request before it entered, see Arbitration::withdraw.
+     *
+     * @param clock The Lamport clock of the thief.
+     * @param send Sends the resulting messages.
+     */
+    void withdraw(int clock, const Send &send);
+
+    /**
+     * Handles a message about a shard, the clock has to be updated with the message already.
+     *
+     * @param message The received message.
+     * @param shard The shard the message is about.
+     * @param clock The Lamport clock of the thief, incremented before every reply.
+     * @param send Sends the resulting messages.
+     */
+    void receive(const utils::message_t &message, int shard, int &clock, const Send &send);
+
+    /**
+     * Handles the FINISH of a thief.
+     *
+     * @param thief_id The identifier of the finished thief.
+     */
+    void receiveFinish(int thief_id);
+
+    /**
+     * @return Whether the pending request can take a unit.
+     */
+    bool canEnter() const;
+
+    /**
+     * Takes the unit of the pending request.
+     *
+     * @return The shard the unit belongs to, the one to release it to.
+     */
+    int enter();
+
+    /**
+     * @return The number of requests of other thieves waiting in the local state of all subscribed shards.
+     */
+    int queueDepth() const;
+
+    /**
+     * @return The shard of the pending request, -1 if none.
+     */
+    int pendingShard() const { return pending >= 0 ? shards[pending].index : -1; }
+
+private:
+    /**
+     * @return Whether a thief subscribes to a shard, as subscriptions() tells without building the list.
+     */
+    static bool subscribes(int thief_id, int shard, int shards);
+
+    /**
+     * A subscribed shard.
+     */
+    struct Shard
+    {
+        int index;                ///< The number of the shard.
+        int capacity;             ///< The units of the shard.
+        int max_held;             ///< The most units of the shard the thief holds at once.
+        std::vector<int> members; ///< The subscribers in increasing order, empty for a single shard of everyone.
+        Arbitration arbitration;  ///< The arbitration among the subscribers, numbered by their position.
+    };
+
+    /**
+     * @return The position of a thief among the subscribers of a shard, -1 if it does not subscribe.
+     */
+    static int localId(const Shard &shard, int thief_id);
+
+    /**
+     * @return Sends the messages of a subscribed shard, translating the thieves to their global identifiers.
+     */
+    static Arbitration::Send sender(const Shard &shard, const Send &send);
+
+    /**
+     * @return The subscribed shard with a number, null if the thief does not subscribe to it.
+     */
+    Shard *find(int shard);
+
+    /**
+     * @return The position of the less loaded shard the thief does not hold its share of, -1 if there is none.
+     */
+    int choose();
+
+    std::vector<Shard> shards; ///< The subscribed shards.
+    int pending = -1;          ///< The position of the shard of the pending request, -1 if none.
+    bool postponed = false;    ///< Whether the pending request waits for a release to choose its shard.
+    std::vector<int> held;     ///< The positions of the shards of the held units, in the order taken.
+    std::minstd_rand random;   ///< Breaks ties between equally loaded shards.
+};
+
+} // namespace mood_thieves
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstdint>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/metrics.hpp"
+#include "mood_thieves/sharded_pool.hpp"
+#include "mood_thieves/utils.hpp"
+#include "mood_thieves/workload.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * Deterministic discrete-event simulation of the thieves in virtual time.
+ *
+ * Every thief runs the arbitration state machines of MoodThieve and the same business logic: request a weapon,
+ * roam, request a laboratory, work, leave and let the weapon recharge. Instead of threads and sleeps, the phases
+ * and the messages are events on a virtual clock. A message arrives after a latency drawn from the configured
+ * distribution, never before an earlier message of the same channel, and the receiver handles one message at a
+ * time taking handle_ns each. The latencies come from one seeded generator and every thief draws its workload
+ * from a generator of its own, so a seed always gives the same run and every protocol the same workload.
+ */
+class Simulator
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param config The configuration, thieves is the number of simulated thieves.
+     */
+    explicit Simulator(const Config &config);
+
+    /**
+     * Runs until every thief made its entries or the duration passed and all weapons recharged.
+     */
+    void run();
+
+    /**
+     * @return The metrics of all thieves, in virtual nanoseconds.
+     */
+    const Metrics &getMetrics() const { return metrics; }
+
+    /**
+     * @return The virtual time of the last event in nanoseconds.
+     */
+    int64_t virtualNs() const { return now; }
+
+    /**
+     * @return The number of handled events.
+     */
+    long eventCount() const { return events; }
+
+    /**
+     * @return The number of times more units were in use than a shard of a pool holds, always 0 for a correct protocol.
+     */
+    long violationCount() const { return violations; }
+
+private:
+    // Enum representing the kind of an event
+    enum EventKind
+    {
+        DELIVER,   ///< A message arrives at its destination.
+        HANDLE,    ///< The busy receiver gets to a message that arrived earlier.
+        LEAD,      ///< The roam of the thief is close enough to its end to request the laboratory.
+        ROAMED,    ///< The thief is done roaming with its weapon.
+        WORKED,    ///< The thief is done in the laboratory.
+        RECHARGED, ///< The weapon of the thief finished recharging.
+        START      ///< The thief starts.
+    };
+
+    struct Event
+    {
+        int64_t time;             ///< Virtual time in nanoseconds.
+        uint64_t sequence;        ///< Order of scheduling, breaks ties so equal times keep FIFO order.
+        EventKind kind;           ///< What happens.
+        int thief;                ///< The thief the event happens to.
+        utils::message_t message; ///< The delivered message, the weapon with its shard of a RECHARGED event.
+
+        bool operator>(const Event &other) const
+        {
+            return time == other.time ? sequence > other.sequence : time > other.time;
+        }
+    };
+
+    /**
+     * Arrival time of the last message of every used channel, open addressing with linear probing.
+     *
+     * Only the channels a protocol talks over are stored, which for Maekawa is far less than size^2.
+     */
+    class ChannelTable
+    {
+    public:
+        /**
+         * @return The arrival time of the last message of the channel, 0 for a new channel.
+         */
+        int64_t &operator[](uint64_t channel);
+
+    private:
+        std::vector<uint64_t> keys;  ///< channel + 1 of every slot, 0 for an empty slot.
+        std::vector<int64_t> values; ///< The arrival time of every slot.
+        size_t used = 0;             ///< The number of occupied slots.
+    };
+
+    struct Thief
+    {
+        Thief(const Config &config, int id) : workload(config, id) {}
+
+        Workload workload;              ///< Draws the phase durations and the victims.
+        int clock = 0;                  ///< The Lamport clock.
+        std::vector<ShardedPool> pools; ///< The arbitration of the weapons and the laboratories.
+        int waiting = -1;               ///< The resource the thief waits for, -1 if none.
+        bool roaming = false;           ///< Whether the thief roams with its weapon.
+        bool lab_granted = false;       ///< Whether the laboratory was taken while the thief still roamed.
+        int64_t request_time[2] = {};   ///< When the pending request of every resource was made.
+        int taken_shards[2] = {};       ///< The shard of the unit of every resource taken last.
+        int entries = 0;                ///< The number of laboratory entries.
+        int64_t receiver_free = 0;      ///< When the receiver is done with the message it handles.
+    };
+
+    /**
+     * Adds an event at a virtual time.
+     */
+    void schedule(int64_t time, EventKind kind, int thief, const utils::message_t &message = {});
+
+    /**
+     * Sends a message, it arrives after a latency but not before the previous message of the channel.
+     */
+    void send(int from, int to, int message_type, int clock, int resource_type, int value);
+
+    /**
+     * Requests a unit of a resource the way MoodThieve::sendRequest does.
+     */
+    void request(int id, int resource_type);
+
+    /**
+     * Releases a unit of a shard of a resource the way MoodThieve::sendRelease does.
+     */
+    void release(int id, int resource_type, int shard);
+
+    /**
+     * Ends the roam of a thief the way MoodThieve::business_logic does: without a victim the laboratory is
+     * withdrawn and the weapon returned, otherwise the thief goes to the laboratory.
+     */
+    void roamed(int id);
+
+    /**
+     * Handles a message the way MoodThieve::handleMessage does.
+     */
+    void handle(int id, const utils::message_t &message);
+
+    /**
+     * @return Sends the messages of a thief about a resource.
+     */
+    ShardedPool::Send sender(int id, int resource_type);
+
+    /**
+     * @return Whether the pending request of the thief can enter.
+     */
+    bool canEnter(int id, int resource_type) const;
+
+    /**
+     * Takes the unit the thief has been waiting for and schedules the end of the phase.
+     */
+    void enter(int id, int resource_type);
+
+    /**
+     * @return A latency drawn from the configured distribution in nanoseconds.
+     */
+    int64_t latency();
+
+    Config config;                      ///< The configuration.
+    int size;                           ///< The number of thieves.
+    std::vector<Thief> thieves;         ///< The state of every thief.
+    Metrics metrics;                    ///< Metrics of all thieves.
+    std::mt19937_64 random;             ///< Draws the latencies.
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> agenda; ///< Events ordered by time.
+    ChannelTable channel_last;          ///< Arrival of the last message of every used channel.
+    uint64_t sequence = 0;              ///< Number of scheduled events.
+    int64_t now = 0;                    ///< The current virtual time in nanoseconds.
+    long events = 0;                    ///< The number of handled events.
+    long violations = 0;                ///< The number of mutual exclusion violations.
+    std::vector<int> in_use[2];         ///< Units of every shard of a resource in use, recharging weapons included.
+};
+
+} // namespace mood_thieves
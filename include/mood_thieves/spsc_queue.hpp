@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace mood_thieves
+{
+
+/**
+ * Bounded lock-free single-producer single-consumer queue.
+ *
+ * A ring of slots indexed by two ever growing counters, the producer only writes the tail and the consumer
+ * only writes the head, so either side is a plain store after an acquire load of the other counter.
+ * The counters live on separate cache lines, the two threads do not bounce a line unless the queue runs empty.
+ */
+template <typename T> class SpscQueue
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param capacity The number of slots, rounded up to a power of two.
+     */
+    explicit SpscQueue(size_t capacity)
+    {
+        size_t slot_count = 1;
+        while (slot_count < capacity)
+        {
+            slot_count *= 2;
+        }
+        slots.resize(slot_count);
+        mask = slot_count - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    /**
+     * Appends an item, only called by the producer.
+     *
+     * @param item The item to append.
+     *
+     * @return True if the item was appended, false if the queue is full.
+     */
+    bool push(const T &item)
+    {
+        size_t position = tail.load(std::memory_order_relaxed);
+        if (position - head.load(std::memory_order_acquire) > mask)
+        {
+            return false;
+        }
+        slots[position & mask] = item;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Takes the oldest item, only called by the consumer.
+     *
+     * @param item The taken item.
+     *
+     * @return True if an item was taken, false if the queue is empty.
+     */
+    bool pop(T &item)
+    {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = slots[position & mask];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> slots;                    ///< The ring of items.
+    size_t mask;                             ///< The number of slots minus one.
+    alignas(64) std::atomic<size_t> head{0}; ///< Items taken so far, written by the consumer.
+    alignas(64) std::atomic<size_t> tail{0}; ///< Items appended so far, written by the producer.
+};
+
+} // namespace mood_thieves
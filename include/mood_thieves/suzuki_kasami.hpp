@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace mood_thieves
+{
+
+/**
+ * Suzuki-Kasami arbitration of a pool of indistinguishable units, one token per unit.
+ *
+ * The tokens start spread over the thieves, a thief holding an idle token enters without any message,
+ * otherwise it broadcasts a REQUEST numbered by its request counter and enters once a TOKEN arrives.
+ * A thief passes an idle token to the oldest request it knows to be outstanding, its own included, and
+ * keeps it otherwise. A token in use, such as a recharging weapon, stays with its holder until released.
+ *
+ * Messages are too small to carry the served numbers and the queue with the token, so every thief keeps
+ * them for the requests it saw. It learns that a request was served from the next one of the same thief,
+ * requests are not numbered on the wire as every thief counts them, from the served request every REQUEST
+ * and TOKEN carries and from the SERVED messages sent ahead of a token: the served requests its sender
+ * learned since its last token to that thief, at most the last size of them. Without them a holder would
+ * pass its token to the oldest request it knows, the one most likely served by another holder already,
+ * and the token would wander between served thieves. A stale view at worst passes a token to a thief
+ * served by another holder, which uses it for its next request or passes it on in turn.
+ *
+ * The class only keeps the state, sending the messages is left to the caller.
+ */
+class SuzukiKasami
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param id The identifier of the thief.
+     * @param size The total number of thieves.
+     * @param tokens The number of units in the pool, token t starts at thief t % size.
+     */
+    SuzukiKasami(int id, int size, int tokens);
+
+    /**
+     * Starts a request for a unit.
+     *
+     * @return True if the request has to be broadcast, false if an idle token is at hand.
+     */
+    bool request();
+
+    /**
+     * Handles a request of another thief, numbered by counting the requests of the thief.
+     *
+     * @param thief_id The identifier of the requesting thief.
+     * @param news A request the sender knew to be served, as returned by news.
+     *
+     * @return The thief to pass an idle token to, -1 if none.
+     */
+    int receiveRequest(int thief_id, int news);
+
+    /**
+     * Handles a token passed by another thief.
+     *
+     * @param news A request the sender knew to be served, as returned by news.
+     *
+     * @return The thief to pass it on to, -1 if the thief keeps it.
+     */
+    int receiveToken(int news);
+
+    /**
+     * Handles a served request sent ahead of a token.
+     *
+     * @param news The served request, as returned by news.
+     */
+    void receiveServed(int news);
+
+    /**
+     * Handles the FINISH of a thief, it is never passed a token again.
+     *
+     * @param thief_id The identifier of the finished thief.
+     */
+    void receiveFinish(int thief_id);
+
+    /**
+     * Checks whether the pending request can enter the pool.
+     *
+     * @return True if the thief can take a unit, false otherwise.
+     */
+    bool canEnter() const;
+
+    /**
+     * Takes a token for the pending request.
+     */
+    void enter();
+
+    /**
+     * Releases a held token.
+     *
+     * @return The thief to pass it to, -1 if the thief keeps it.
+     */
+    int release();
+
+    /**
+     * Picks the served request a token passed to a thief carries, the latest one of another thief.
+     *
+     * @param thief_id The identifier of the thief the token is passed to.
+     *
+     * @return The request as request number * size + thief, -1 if none.
+     */
+    int news(int thief_id) const;
+
+    /**
+     * Picks the served requests to send ahead of a token passed to a thief, those learned since the last
+     * token to it and at most the last size of them, and marks them sent.
+     *
+     * @param thief_id The identifier of the thief the token is passed to.
+     *
+     * @return The requests as request number * size + thief, oldest first.
+     */
+    std::vector<int> takeNews(int thief_id);
+
+    /**
+     * @return The number of requests of other thieves this thief considers outstanding.
+     */
+    int queueDepth() const { return static_cast<int>(queue.size()); }
+
+private:
+    /**
+     * Picks the oldest outstanding request for an idle token not kept for the pending request.
+     *
+     * @return The thief to pass the token to, -1 if none.
+     */
+    int passIdle();
+
+    /**
+     * Marks the served request a message carries as served, if it is news to the thief.
+     */
+    void learn(int news);
+
+    /**
+     * Marks a request of another thief as served.
+     */
+    void serve(int thief_id, int request_number);
+
+    int id;                           ///< The identifier of the thief.
+    int size;                         ///< The total number of thieves.
+    bool requesting = false;          ///< Whether there is a pending request.
+    bool reserved = false;            ///< Whether an idle token is kept for the pending request.
+    int idle = 0;                     ///< Tokens held and not in use.
+    int held = 0;                     ///< Tokens in use.
+    std::vector<int> request_numbers; ///< The highest request number seen from every thief.
+    std::vector<int> served;          ///< The last request of every thief known to be served.
+    std::vector<bool> finished;       ///< Whether every thief sent FINISH.
+    int latest = -1;                  ///< The last served request, as request number * size + thief.
+    int previous = -1;                ///< The last served request of another thief than the latest one.
+    std::deque<int> recent;           ///< The last served requests, at most size of them, oldest first.
+    uint64_t learned = 0;             ///< The number of served requests ever added to recent.
+    std::vector<uint64_t> told;       ///< The value of learned at the last token passed to every thief.
+    std::deque<int> queue;            ///< Thieves with an outstanding request, the thief itself included.
+};
+
+} // namespace mood_thieves
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mood_thieves
+{
+
+/**
+ * Runs callbacks after a delay on a single thread using a hierarchical timer wheel.
+ *
+ * Every level has 64 slots, a slot of level l covers 64^l ticks. A timer is placed on the lowest level whose
+ * span covers its delay and moves one level down every time the wheel reaches its slot, so scheduling and
+ * expiring a timer are O(1) regardless of the number of pending timers. The thread only wakes up for
+ * non-empty slots of the lowest level and for the cascades of the higher ones.
+ */
+class TimerWheel
+{
+public:
+    using Callback = std::function<void()>;
+
+    /**
+     * Constructor, starts the timer thread.
+     *
+     * @param tick The resolution of the wheel.
+     */
+    explicit TimerWheel(std::chrono::microseconds tick = std::chrono::microseconds(100));
+
+    /**
+     * Destructor, stops the timer thread, pending timers are dropped.
+     */
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    /**
+     * Schedules a callback, it runs on the timer thread and must not block.
+     *
+     * @param delay The time after which to run the callback, rounded up to a whole tick.
+     * @param callback The function to run.
+     */
+    void schedule(std::chrono::microseconds delay, Callback callback);
+
+    /**
+     * @return The number of timers that did not run yet.
+     */
+    size_t pending();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int LEVEL_BITS = 6;
+    static constexpr int SLOTS = 1 << LEVEL_BITS;
+    static constexpr int LEVELS = 4;
+
+    struct Timer
+    {
+        uint64_t expiry; ///< The tick to run at.
+        Callback callback;
+    };
+
+    /**
+     * Places a timer in the slot covering its expiry, the mutex has to be held.
+     *
+     * @param timer The timer to place.
+     */
+    void insert(Timer &&timer);
+
+    /**
+     * Advances the wheel by one tick and collects the expired timers, the mutex has to be held.
+     *
+     * @param expired The vector to move the expired timers to.
+     */
+    void advance(std::vector<Timer> &expired);
+
+    /**
+     * @return The next tick the thread has to wake up at, the mutex has to be held.
+     */
+    uint64_t nextWakeup() const;
+
+    /**
+     * @return The number of whole ticks since the start of the wheel.
+     */
+    uint64_t elapsedTicks() const;
+
+    /**
+     * Body of the timer thread.
+     */
+    void run();
+
+    std::chrono::microseconds tick;                                        ///< The resolution of the wheel.
+    Clock::time_point start;                                               ///< The time of tick 0.
+    std::array<std::array<std::vector<Timer>, SLOTS>, LEVELS> wheels;      ///< The slots of every level.
+    uint64_t current = 0;                                                  ///< The last processed tick.
+    size_t count = 0;                                                      ///< The number of pending timers.
+    bool stop = false;                                                     ///< Whether the thread should end.
+    std::mutex mutex;                                                      ///< Mutex protecting the wheel.
+    std::condition_variable wakeup;                                        ///< Wakes the thread up earlier.
+    std::thread thread;                                                    ///< The timer thread.
+};
+
+} // namespace mood_thieves
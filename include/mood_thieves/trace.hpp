@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace mood_thieves
+{
+namespace trace
+{
+
+// Enum representing the kind of a trace record
+enum Kind : uint8_t
+{
+    SEND = 0,           ///< A message was handed to the batcher.
+    RECEIVE = 1,        ///< A message was handled by the receiving thread.
+    REQUEST = 2,        ///< The thief started waiting for a resource.
+    ENTER = 3,          ///< The thief entered the critical section of a resource.
+    EXIT = 4,           ///< The thief left the critical section of a resource.
+    RECHARGE_START = 5, ///< A weapon started recharging.
+    RECHARGE_END = 6,   ///< A weapon finished recharging and was released.
+    THREAD_NAME = 7,    ///< First record of a thread, message_type holds its Role.
+    WITHDRAW = 8        ///< The thief gave up waiting for a resource.
+};
+
+// Enum representing the role of a traced thread
+enum Role : uint8_t
+{
+    UNNAMED = 0,  ///< A thread that did not set its role.
+    RECEIVER = 1, ///< The thread receiving messages.
+    LOGIC = 2,    ///< The thread running the business logic.
+    TIMER = 3     ///< The thread running the timer callbacks.
+};
+
+/**
+ * A single binary trace record.
+ */
+struct Record
+{
+    uint64_t time_ns;      ///< steady_clock time of the event in nanoseconds.
+    int32_t clock;         ///< Lamport clock of the thief at the event.
+    int32_t message_clock; ///< Lamport clock carried by the message, for sends and receives.
+    int16_t peer;          ///< The other thief of a send or receive, -1 otherwise.
+    uint16_t thread;       ///< Index of the recording thread within the rank.
+    uint8_t kind;          ///< The Kind of the record.
+    uint8_t resource;      ///< The utils::ResourceType involved, 255 if none.
+    uint8_t message_type;  ///< The utils::MessageType of a send or receive, the Role of THREAD_NAME.
+    uint8_t unit;          ///< The protocol specific value of the message, truncated.
+};
+
+/**
+ * Header at the start of every per-rank trace file.
+ */
+struct FileHeader
+{
+    char magic[4];            ///< Always "MTTR".
+    uint32_t version;         ///< Version of the format.
+    int32_t rank;             ///< The rank that wrote the file.
+    uint32_t record_size;     ///< sizeof(Record) of the writer.
+    int64_t system_offset_ns; ///< system_clock minus steady_clock when the file was opened.
+};
+
+const uint32_t VERSION = 1;
+
+/**
+ * Whether records are collected, checked before anything else so disabled tracing costs a relaxed load.
+ */
+inline std::atomic<bool> enabled{false};
+
+/**
+ * Starts the flushing thread writing to <prefix>.<rank>.trace and enables tracing.
+ *
+ * @param prefix The path prefix of the trace file.
+ * @param rank The rank of the process.
+ *
+ * @return Status code, -1 if the file cannot be opened.
+ */
+int open(const std::string &prefix, int rank);
+
+/**
+ * Disables tracing, writes all buffered records and closes the file.
+ */
+void close();
+
+/**
+ * Switches tracing on or off at runtime if a trace file is open, safe to call from a signal handler.
+ */
+void toggle();
+
+/**
+ * Sets the role recorded for the calling thread when it records its first event.
+ *
+ * @param role The role of the calling thread.
+ */
+void set_thread_role(Role role);
+
+/**
+ * Appends a record to the ring buffer of the calling thread, drops it if the ring is full.
+ */
+void write(Kind kind, int clock, int peer, int resource, int message_type, int message_clock, int unit);
+
+/**
+ * Records an event if tracing is enabled.
+ *
+ * @param kind The kind of the event.
+ * @param clock The Lamport clock of the thief.
+ * @param peer The other thief of a send or receive.
+ * @param resource The resource type involved.
+ * @param message_type The message type of a send or receive.
+ * @param message_clock The Lamport clock carried by the message.
+ * @param unit The protocol specific value of the message.
+ */
+inline void record(Kind kind, int clock, int peer = -1, int resource = -1, int message_type = 0,
+                   int message_clock = 0, int unit = 0)
+{
+    if (!enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    write(kind, clock, peer, resource, message_type, message_clock, unit);
+}
+
+} // namespace trace
+} // namespace mood_thieves
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+#include "mood_thieves/batcher.hpp"
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/receive_engine.hpp"
+#include "mood_thieves/utils.hpp"
+
+namespace mood_thieves
+{
+
+class Mailbox;
+
+/**
+ * Moves messages between thieves.
+ *
+ * Sending may happen from any thread of the thief, receiving only from its receiving thread.
+ * Messages between a pair of thieves are delivered in the order they were posted.
+ */
+class Transport
+{
+public:
+    using Handler = std::function<void(const utils::message_t &)>;
+
+    virtual ~Transport() = default;
+
+    /**
+     * Hands a message to the transport.
+     *
+     * @param thief_id The identifier of the thief to send to.
+     * @param message The message to send.
+     * @param urgent Whether the message has to leave right away, deferred ones may wait for a batch.
+     */
+    virtual void post(int thief_id, const utils::message_t &message, bool urgent) = 0;
+
+    /**
+     * Sends the deferred messages that waited longer than the batch delay.
+     */
+    virtual void flushExpired() = 0;
+
+    /**
+     * Sends all deferred messages.
+     */
+    virtual void flushAll() = 0;
+
+    /**
+     * Handles all messages that already arrived without blocking.
+     *
+     * @param handler The function to call for every received message.
+     *
+     * @return The number of handled messages.
+     */
+    virtual int poll(const Handler &handler) = 0;
+
+    /**
+     * Blocks until at least one message arrives or the transport is woken and handles all arrived messages.
+     *
+     * @param handler The function to call for every received message.
+     *
+     * @return The number of handled messages.
+     */
+    virtual int wait(const Handler &handler) = 0;
+
+    /**
+     * Makes the wait in progress return, or the next one if none is, safe to call from any thread.
+     */
+    virtual void wake() = 0;
+
+    /**
+     * @return The number of transfers issued so far, a transfer may carry a batch of messages.
+     */
+    virtual long batchesSent() const = 0;
+};
+
+/**
+ * Transport over MPI, every thief is a rank of the communicator.
+ *
+ * Messages are coalesced per destination by a Batcher and received through the persistent receives of
+ * a ReceiveEngine, or with MPI_Iprobe and MPI_Recv under the spin policy. Messages a thief posts to itself
+ * never reach MPI, they wait in a Mailbox handled before the received ones, and a receiver blocked in MPI
+ * meanwhile, or woken by another thread of the thief, is released by an empty batch.
+ */
+class MpiTransport : public Transport
+{
+public:
+    /**
+     * Constructor, posts the receives.
+     *
+     * @param batch_type The MPI type of a single batch entry, see utils::initialize_batch_type.
+     * @param comm The communicator of all thieves.
+     * @param size The number of thieves.
+     * @param config The configuration holding the receive policy and the batching bounds.
+     */
+    MpiTransport(MPI_Datatype batch_type, MPI_Comm comm, int size, const Config &config);
+
+    ~MpiTransport() override;
+
+    void post(int thief_id, const utils::message_t &message, bool urgent) override;
+    void flushExpired() override;
+    void flushAll() override;
+    int poll(const Handler &handler) override;
+    int wait(const Handler &handler) override;
+    void wake() override;
+    long batchesSent() const override { return batcher.batchesSent(); }
+
+private:
+    /**
+     * Handles the messages the thief posted to itself.
+     *
+     * @param handler The function to call for every message.
+     *
+     * @return The number of handled messages.
+     */
+    int pollOwn(const Handler &handler);
+
+    /**
+     * Handles all messages that already arrived through MPI without blocking.
+     */
+    int pollMpi(const Handler &handler);
+
+    /**
+     * Sends an empty batch to the thief itself if its receiver may be blocked in MPI.
+     */
+    void unblock();
+
+    MPI_Datatype batch_type;                     ///< The MPI type of a single batch entry.
+    MPI_Comm comm;                               ///< The communicator of all thieves.
+    int rank;                                    ///< The rank of the thief in comm.
+    Batcher batcher;                             ///< Coalesces the messages sent to every thief.
+    std::unique_ptr<ReceiveEngine> engine;       ///< The persistent receives, none under the spin policy.
+    std::vector<utils::wire_message_t> messages; ///< Receive buffer of the spin policy.
+    std::unique_ptr<Mailbox> own;                ///< The messages the thief posted to itself.
+    std::atomic<bool> blocked{false};            ///< Whether the receiver may be blocked in MPI.
+    std::atomic<bool> woken{false};              ///< Whether wake was called since a wait last checked.
+};
+
+} // namespace mood_thieves
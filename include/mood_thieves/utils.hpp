@@ -1,7 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <mpi.h>
-#include <mutex>
+#include <pthread.h>
 
 namespace mood_thieves
 {
@@ -15,14 +19,53 @@ enum ResourceType
     LABORATORY
 };
 
+/**
+ * The resource type a message about a shard of a pool carries, the shard travels in the bits above the resource.
+ *
+ * @param resource_type The type of the resource.
+ * @param shard The shard of its pool.
+ *
+ * @return The resource type of the message.
+ */
+inline int shard_resource(int resource_type, int shard)
+{
+    return resource_type + shard * 2;
+}
+
+/**
+ * @return The type of the resource a message is about, without its shard.
+ */
+inline int resource_of(int resource_type)
+{
+    return resource_type < 0 ? resource_type : resource_type % 2;
+}
+
+/**
+ * @return The shard of the pool a message is about.
+ */
+inline int shard_of(int resource_type)
+{
+    return resource_type < 0 ? 0 : resource_type / 2;
+}
+
 // Enum representing the message type
 enum MessageType
 {
     REQUEST,
     ACK,
-    RELEASE
+    RELEASE,
+    INQUIRE,
+    YIELD,
+    FAILED,
+    FINISH,
+    TOKEN,
+    WITHDRAW,
+    SERVED
 };
 
+// Tag of every MPI message, the type of each message travels inside the batch
+const int BATCH_TAG = 0;
+
 /**
  * Struct to hold data for a messages to send.
  */
@@ -31,6 +74,7 @@ struct message_data_t
     int id;            ///< Id of the thread
     int clock;         ///< Lamport clock value
     int resource_type; ///< Type of the resource
+    int value;         ///< Protocol specific value, e.g. the number of units an ACK grants
 };
 
 /**
@@ -40,56 +84,143 @@ struct message_t
 {
     int type;            ///< Type of the message
     message_data_t data; ///< Data of the message
+    int to = 0;          ///< Id of the receiving thief, tells apart the thieves hosted by a rank
 };
 
+/**
+ * A message_t packed into four 32-bit words as it travels in a batch.
+ */
+struct wire_message_t
+{
+    uint32_t id_type;     ///< Id of the sender in the lower 24 bits, type of the message in the upper 8
+    uint32_t to_resource; ///< Id of the receiving thief in the lower 24 bits, type of the resource + 1 in the upper 8
+    int32_t clock;        ///< Lamport clock value
+    int32_t value;        ///< Protocol specific value
+};
+
+static_assert(sizeof(wire_message_t) == 16, "A batch entry is four 32-bit words");
+
+// Largest thief id a wire_message_t can carry
+const int MAX_WIRE_ID = (1 << 24) - 1;
+
+/**
+ * Packs a message for the wire, its ids have to be at most MAX_WIRE_ID.
+ *
+ * @param message The message to pack.
+ *
+ * @return The packed message.
+ */
+inline wire_message_t pack(const message_t &message)
+{
+    return {static_cast<uint32_t>(message.data.id) | static_cast<uint32_t>(message.type) << 24,
+            static_cast<uint32_t>(message.to) | static_cast<uint32_t>(message.data.resource_type + 1) << 24,
+            message.data.clock, message.data.value};
+}
+
+/**
+ * Unpacks a message received from the wire.
+ *
+ * @param wire The packed message.
+ *
+ * @return The message.
+ */
+inline message_t unpack(const wire_message_t &wire)
+{
+    return {static_cast<int>(wire.id_type >> 24),
+            {static_cast<int>(wire.id_type & MAX_WIRE_ID), wire.clock, static_cast<int>(wire.to_resource >> 24) - 1,
+             wire.value},
+            static_cast<int>(wire.to_resource & MAX_WIRE_ID)};
+}
+
 /**
  * Struct to hold the Lamport clock and the id of the thread.
+ *
+ * The clock is a single atomic, every thread may advance it without a lock.
  */
 struct LamportClock
 {
     /**
-     * Lock the clock.
+     * Update the clock with the maximum of the current clock and the given clock value and increment it.
      *
-     * Applies the mutex to the clock.
+     * @param other_clock The clock value carried by a received message.
+     *
+     * @return The clock after the update.
      */
-    void lock() { _mutex.lock(); }
+    int receive(int other_clock)
+    {
+        int current = clock.load(std::memory_order_relaxed);
+        while (!clock.compare_exchange_weak(current, std::max(current, other_clock) + 1, std::memory_order_relaxed))
+        {
+        }
+        return std::max(current, other_clock) + 1;
+    }
 
     /**
-     * Unlock the clock.
+     * Increment the clock.
      *
-     * Releases the mutex from the clock.
+     * @return The clock after the increment, the value to stamp a sent message with.
      */
-    void unlock() { _mutex.unlock(); }
+    int increment() { return clock.fetch_add(1, std::memory_order_relaxed) + 1; }
 
     /**
-     * Update the clock with the maximum of the current clock and the given clock.
-     *
-     * @param other_clock The clock to compare with.
+     * @return The current value of the clock.
      */
-    void update(const LamportClock &other_clock) { clock = std::max(clock, other_clock.clock); }
+    int value() const { return clock.load(std::memory_order_relaxed); }
 
     /**
-     * Increment the clock.
+     * Move the clock forward to a value ticked by a copy of it, only called by the thread that alone ticks it.
+     *
+     * @param ticked The ticked copy.
      */
-    void increment() { clock++; }
+    void advance(int ticked) { clock.store(std::max(value(), ticked), std::memory_order_relaxed); }
 
     /**
      * Constructor.
      *
      * @param id The id of the thread.
      */
-    LamportClock(int id) : clock(0), id(id), _mutex(){};
+    LamportClock(int id) : clock(0), id(id){};
 
     /**
      * Constructor.
      *
      * @param clock The clock to copy.
      */
-    LamportClock(const LamportClock &clock) : clock(clock.clock), id(clock.id), _mutex(){};
+    LamportClock(const LamportClock &clock) : clock(clock.value()), id(clock.id){};
 
-    int clock;         ///< Lamport clock
-    int id;            ///< Id of the thread
-    std::mutex _mutex; ///< Mutex responsible for locking the clock
+    std::atomic<int> clock; ///< Lamport clock
+    int id;                 ///< Id of the thread
+};
+
+/**
+ * Wakes a thread sleeping with a timeout, a futex word counting the rings.
+ *
+ * Ringing is a single atomic increment while nobody sleeps, it only enters the kernel to wake a sleeper.
+ */
+class Doorbell
+{
+public:
+    /**
+     * Wakes the sleeping thread, safe to call from any thread.
+     */
+    void ring();
+
+    /**
+     * @return The number of rings so far, read before checking for work and passed to sleep.
+     */
+    uint32_t rings() const { return count.load(std::memory_order_acquire); }
+
+    /**
+     * Sleeps until the doorbell rings after the counter was read or the timeout passes.
+     *
+     * @param seen The counter read before the last check for work.
+     * @param timeout The longest time to sleep.
+     */
+    void sleep(uint32_t seen, std::chrono::microseconds timeout);
+
+private:
+    std::atomic<uint32_t> count{0};    ///< The rings so far, the futex word.
+    std::atomic<bool> sleeping{false}; ///< Whether the owner may be sleeping on the futex.
 };
 
 /**
@@ -101,15 +232,40 @@ struct LamportClock
  */
 int check_thread_support(int provided);
 
+/**
+ * Get the CPU time consumed so far by all threads of the process.
+ *
+ * @return The CPU time in seconds.
+ */
+double process_cpu_time();
+
+/**
+ * Get the CPU time consumed so far by a single thread of the process.
+ *
+ * @param thread The thread to query.
+ *
+ * @return The CPU time in seconds.
+ */
+double thread_cpu_time(pthread_t thread);
+
 /**
  * Initialize the message type for MPI.
- * The message type is a struct containing the Lamport clock
- * and the id of the thread.
+ * The message type is a message_data_t: the id of the thread, the Lamport clock,
+ * the type of the resource and the protocol specific value.
  *
  * @param message_type The MPI_Datatype to initialize.
  */
 void initialize_message_type(MPI_Datatype &message_type);
 
+/**
+ * Initialize the batch entry type for MPI.
+ * A batch is a variable number of these entries sent as a single MPI message,
+ * each entry is a wire_message_t: a message_t packed into four 32-bit words.
+ *
+ * @param batch_type The MPI_Datatype to initialize.
+ */
+void initialize_batch_type(MPI_Datatype &batch_type);
+
 /**
  * Free the message type for MPI.
  *
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <random>
+
+#include "mood_thieves/config.hpp"
+
+namespace mood_thieves
+{
+
+/**
+ * Draws the durations of the phases of the business logic of a thief and whether a roam finds a victim.
+ *
+ * Every phase takes its configured mean under the configured distribution. A trace is replayed in its order from
+ * a position drawn per thief, so its bursts stay bursts without every thief running through them in lockstep.
+ * The generator is seeded from the seed and the identifier of the thief, so a seed gives every thief the same
+ * workload whatever the protocol or the host running it.
+ */
+class Workload
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param config The runtime configuration.
+     * @param id The identifier of the thief.
+     */
+    Workload(const Config &config, int id);
+
+    /**
+     * @return Microseconds of the next roam.
+     */
+    int roamUs() { return draw(phases[0]); }
+
+    /**
+     * @return Microseconds of the next stay in the laboratory.
+     */
+    int laboratoryUs() { return draw(phases[1]); }
+
+    /**
+     * @return Microseconds of the next recharge.
+     */
+    int rechargeUs() { return draw(phases[2]); }
+
+    /**
+     * @return Whether the roam just ended found a victim, otherwise the laboratory is not needed.
+     */
+    bool findsVictim();
+
+private:
+    struct Phase
+    {
+        PhaseTime time;  ///< The distribution of the duration.
+        int mean_us;     ///< The mean duration.
+        size_t next = 0; ///< The next sample of a trace.
+    };
+
+    /**
+     * @return Microseconds of the next occurrence of a phase.
+     */
+    int draw(Phase &phase);
+
+    std::mt19937_64 random;    ///< The source of every draw.
+    Phase phases[3];           ///< The roam, the laboratory and the recharge.
+    double victim_probability; ///< Chance a roam finds a victim.
+};
+
+} // namespace mood_thieves
@@ -0,0 +1,305 @@
+#include "mood_thieves/arbitration.hpp"
+
+namespace mood_thieves
+{
+
+Arbitration::Arbitration(Protocol protocol, int id, int size, int capacity, int max_held, int ack_horizon)
+    : id(id), size(size)
+{
+    if (protocol == Protocol::RICART_AGRAWALA)
+    {
+        ra = std::make_unique<RicartAgrawala>(id, size, capacity, max_held);
+    }
+    else if (protocol == Protocol::MAEKAWA)
+    {
+        maekawa = std::make_unique<Maekawa>(id, size, capacity);
+    }
+    else if (protocol == Protocol::SUZUKI_KASAMI)
+    {
+        sk = std::make_unique<SuzukiKasami>(id, size, capacity);
+    }
+    else
+    {
+        queue = std::make_unique<LamportQueue>(id, size, capacity, ack_horizon);
+    }
+}
+
+void Arbitration::sendMaekawa(const std::vector<Maekawa::Action> &actions, int request_clock, int clock,
+                              const Send &send)
+{
+    for (const Maekawa::Action &action : actions)
+    {
+        int message_clock = action.message_type == utils::MessageType::REQUEST ? request_clock : clock;
+        send(action.thief_id, action.message_type, message_clock, action.unit);
+    }
+}
+
+void Arbitration::sendToken(int thief_id, int clock, const Send &send)
+{
+    if (thief_id >= 0)
+    {
+        // Ahead of the token, so its next pass goes to a request not served already
+        for (int news : sk->takeNews(thief_id))
+        {
+            send(thief_id, utils::MessageType::SERVED, clock, news);
+        }
+        send(thief_id, utils::MessageType::TOKEN, clock, sk->news(thief_id));
+    }
+}
+
+void Arbitration::request(int clock, const Send &send)
+{
+    if (abandoned)
+    {
+        // The abandoned request is still pending, it serves the new one
+        abandoned = false;
+        return;
+    }
+    if (ra)
+    {
+        for (int thief_id : ra->request(clock))
+        {
+            send(thief_id, utils::MessageType::REQUEST, clock, 0);
+        }
+        return;
+    }
+    if (maekawa)
+    {
+        sendMaekawa(maekawa->request(clock), clock, clock, send);
+        return;
+    }
+    if (sk)
+    {
+        if (!sk->request())
+        {
+            return;
+        }
+        for (int i = 0; i < size; i++)
+        {
+            if (i != id)
+            {
+                send(i, utils::MessageType::REQUEST, clock, sk->news(i));
+            }
+        }
+        return;
+    }
+    queue->request(clock);
+    for (int i = 0; i < size; i++)
+    {
+        send(i, utils::MessageType::REQUEST, clock, 0);
+    }
+}
+
+void Arbitration::release(int clock, const Send &send)
+{
+    if (ra)
+    {
+        // Instead of a RELEASE the deferred ACKs are sent
+        for (auto &[thief_id, units] : ra->release())
+        {
+            send(thief_id, utils::MessageType::ACK, clock, units);
+        }
+        // The released unit may be the one the abandoned request of the thief itself waits for
+        releaseAbandoned(clock, send);
+        return;
+    }
+    if (maekawa)
+    {
+        // So may the released votes
+        sendMaekawa(maekawa->release(), clock, clock, send);
+        releaseAbandoned(clock, send);
+        return;
+    }
+    if (sk)
+    {
+        sendToken(sk->release(), clock, send);
+        // So may the released token
+        releaseAbandoned(clock, send);
+        return;
+    }
+    queue->release();
+    for (int i = 0; i < size; i++)
+    {
+        send(i, utils::MessageType::RELEASE, clock, 0);
+    }
+}
+
+void Arbitration::withdraw(int clock, const Send &send)
+{
+    if (queue)
+    {
+        int request_clock = queue->requestClock();
+        queue->withdraw();
+        for (int i = 0; i < size; i++)
+        {
+            send(i, utils::MessageType::WITHDRAW, clock, request_clock);
+        }
+        return;
+    }
+    abandoned = true;
+}
+
+void Arbitration::releaseAbandoned(int &clock, const Send &send)
+{
+    if (!abandoned || !(ra ? ra->canEnter() : maekawa ? maekawa->canEnter() : sk->canEnter()))
+    {
+        return;
+    }
+    abandoned = false;
+    enter();
+    clock++;
+    release(clock, send);
+}
+
+void Arbitration::receive(const utils::message_t &message, int &clock, const Send &send)
+{
+    handle(message, clock, send);
+    releaseAbandoned(clock, send);
+}
+
+void Arbitration::handle(const utils::message_t &message, int &clock, const Send &send)
+{
+    const utils::message_data_t &data = message.data;
+    if (ra)
+    {
+        if (message.type == utils::MessageType::REQUEST)
+        {
+            int units = ra->receiveRequest(data.id, data.clock);
+            if (units > 0)
+            {
+                clock++;
+                send(data.id, utils::MessageType::ACK, clock, units);
+            }
+        }
+        else if (message.type == utils::MessageType::ACK)
+        {
+            // The pending request can be sent once the previous one is paid off
+            for (int thief_id : ra->receiveAck(data.id, data.value))
+            {
+                send(thief_id, utils::MessageType::REQUEST, ra->requestClock(), 0);
+            }
+        }
+        return;
+    }
+    if (sk)
+    {
+        if (message.type == utils::MessageType::SERVED)
+        {
+            sk->receiveServed(data.value);
+            return;
+        }
+        int thief_id = message.type == utils::MessageType::REQUEST ? sk->receiveRequest(data.id, data.value)
+                       : message.type == utils::MessageType::TOKEN ? sk->receiveToken(data.value)
+                                                                   : -1;
+        if (thief_id >= 0)
+        {
+            clock++;
+            sendToken(thief_id, clock, send);
+        }
+        return;
+    }
+    if (maekawa)
+    {
+        std::vector<Maekawa::Action> actions = maekawa->receive(message.type, data.id, data.clock, data.value);
+        clock++;
+        sendMaekawa(actions, maekawa->requestClock(), clock, send);
+        return;
+    }
+    // An ACK carries the clock of the request it answers
+    if (message.type == utils::MessageType::REQUEST)
+    {
+        if (queue->receiveRequest(data.id, data.clock))
+        {
+            clock++;
+            send(data.id, utils::MessageType::ACK, clock, data.clock);
+        }
+    }
+    else if (message.type == utils::MessageType::RELEASE || message.type == utils::MessageType::WITHDRAW)
+    {
+        if (message.type == utils::MessageType::RELEASE)
+        {
+            queue->receiveRelease(data.id, data.clock);
+        }
+        else
+        {
+            queue->receiveWithdraw(data.id, data.clock, data.value);
+        }
+        for (auto &[thief_id, request_clock] : queue->dueAcks())
+        {
+            clock++;
+            send(thief_id, utils::MessageType::ACK, clock, request_clock);
+        }
+    }
+    else if (message.type == utils::MessageType::ACK)
+    {
+        queue->receiveAck(data.id, data.value);
+    }
+}
+
+void Arbitration::receiveFinish(int thief_id)
+{
+    if (sk)
+    {
+        sk->receiveFinish(thief_id);
+    }
+}
+
+bool Arbitration::canEnter() const
+{
+    if (abandoned)
+    {
+        return false;
+    }
+    if (sk)
+    {
+        return sk->canEnter();
+    }
+    if (ra)
+    {
+        return ra->canEnter();
+    }
+    if (maekawa)
+    {
+        return maekawa->canEnter();
+    }
+    return queue->canEnter();
+}
+
+void Arbitration::enter()
+{
+    if (ra)
+    {
+        ra->enter();
+    }
+    else if (maekawa)
+    {
+        maekawa->enter();
+    }
+    else if (sk)
+    {
+        sk->enter();
+    }
+    else
+    {
+        queue->enter();
+    }
+}
+
+int Arbitration::queueDepth() const
+{
+    if (sk)
+    {
+        return sk->queueDepth();
+    }
+    if (ra)
+    {
+        return ra->queueDepth();
+    }
+    if (maekawa)
+    {
+        return maekawa->queueDepth();
+    }
+    return queue->queueDepth();
+}
+
+} // namespace mood_thieves
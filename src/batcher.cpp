@@ -0,0 +1,84 @@
+#include "mood_thieves/batcher.hpp"
+#include <utility>
+
+namespace mood_thieves
+{
+
+Batcher::Batcher(MPI_Datatype batch_type, MPI_Comm comm, int size, int max_batch, int flush_delay_us)
+    : batch_type(batch_type), comm(comm), max_batch(max_batch), flush_delay(std::chrono::microseconds(flush_delay_us)),
+      buffers(size), in_flight(size), requests(size, MPI_REQUEST_NULL), oldest(size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        buffers[i].reserve(max_batch);
+        in_flight[i].reserve(max_batch);
+    }
+}
+
+Batcher::~Batcher()
+{
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+void Batcher::post(int thief_id, const utils::message_t &message, bool urgent)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<utils::wire_message_t> &buffer = buffers[thief_id];
+    if (buffer.empty())
+    {
+        oldest[thief_id] = Clock::now();
+        waiting++;
+    }
+    buffer.push_back(utils::pack(message));
+    if (urgent || buffer.size() >= max_batch || flush_delay.count() == 0)
+    {
+        flush(thief_id);
+    }
+}
+
+void Batcher::flushExpired()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (waiting == 0)
+    {
+        return;
+    }
+    Clock::time_point deadline = Clock::now() - flush_delay;
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        if (!buffers[i].empty() && oldest[i] <= deadline)
+        {
+            flush(i);
+        }
+    }
+}
+
+void Batcher::flushAll()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (waiting == 0)
+    {
+        return;
+    }
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        if (!buffers[i].empty())
+        {
+            flush(i);
+        }
+    }
+}
+
+void Batcher::flush(int thief_id)
+{
+    // The previous batch to the destination left long ago unless it is a slow one
+    MPI_Wait(&requests[thief_id], MPI_STATUS_IGNORE);
+    std::swap(buffers[thief_id], in_flight[thief_id]);
+    buffers[thief_id].clear();
+    std::vector<utils::wire_message_t> &batch = in_flight[thief_id];
+    MPI_Isend(batch.data(), batch.size(), batch_type, thief_id, utils::BATCH_TAG, comm, &requests[thief_id]);
+    waiting--;
+    batches_sent++;
+}
+
+} // namespace mood_thieves
@@ -0,0 +1,597 @@
+#include "mood_thieves/config.hpp"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+namespace mood_thieves
+{
+
+namespace
+{
+
+/**
+ * Parse a non-negative integer.
+ *
+ * @param value The text to parse.
+ * @param result The parsed value.
+ *
+ * @return True if the whole text is a non-negative integer, false otherwise.
+ */
+bool parse_int(const std::string &value, int &result)
+{
+    if (value.empty())
+    {
+        return false;
+    }
+    char *end = nullptr;
+    long parsed = strtol(value.c_str(), &end, 10);
+    if (*end != '\0' || parsed < 0 || parsed > 0x7fffffff)
+    {
+        return false;
+    }
+    result = static_cast<int>(parsed);
+    return true;
+}
+
+/**
+ * Parse a non-negative number.
+ *
+ * @param value The text to parse.
+ * @param result The parsed value.
+ *
+ * @return True if the whole text is a non-negative number, false otherwise.
+ */
+bool parse_double(const std::string &value, double &result)
+{
+    if (value.empty())
+    {
+        return false;
+    }
+    char *end = nullptr;
+    result = strtod(value.c_str(), &end);
+    return *end == '\0' && result >= 0;
+}
+
+/**
+ * Parse a latency of the form distribution:first[:second].
+ *
+ * @param value The text to parse.
+ * @param result The parsed latency.
+ *
+ * @return True if the text names a distribution with valid parameters, false otherwise.
+ */
+bool parse_latency(const std::string &value, Latency &result)
+{
+    size_t first = value.find(':');
+    if (first == std::string::npos)
+    {
+        return false;
+    }
+    std::string name = value.substr(0, first);
+    size_t second = value.find(':', first + 1);
+    if (!parse_double(value.substr(first + 1, second - first - 1), result.first_us))
+    {
+        return false;
+    }
+    result.second_us = 0;
+    if (second != std::string::npos && !parse_double(value.substr(second + 1), result.second_us))
+    {
+        return false;
+    }
+
+    if (name == "const")
+    {
+        result.distribution = LatencyDistribution::CONSTANT;
+        return second == std::string::npos;
+    }
+    if (name == "uniform")
+    {
+        result.distribution = LatencyDistribution::UNIFORM;
+        return second != std::string::npos && result.second_us >= result.first_us;
+    }
+    if (name == "exp")
+    {
+        result.distribution = LatencyDistribution::EXPONENTIAL;
+        return second != std::string::npos;
+    }
+    if (name == "lognormal")
+    {
+        result.distribution = LatencyDistribution::LOGNORMAL;
+        return second != std::string::npos && result.first_us > 0;
+    }
+    return false;
+}
+
+/**
+ * Read the durations of a phase from a file of whitespace separated microseconds.
+ *
+ * @param path The file to read.
+ * @param result The read durations.
+ *
+ * @return True if the file holds at least one duration and nothing else, false otherwise.
+ */
+bool read_samples(const std::string &path, std::vector<int> &result)
+{
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "[ERROR]: Cannot open %s\n", path.c_str());
+        return false;
+    }
+    result.clear();
+    char token[32];
+    int sample = 0;
+    bool valid = true;
+    while (valid && fscanf(file, "%31s", token) == 1)
+    {
+        valid = parse_int(token, sample);
+        result.push_back(sample);
+    }
+    fclose(file);
+    return valid && !result.empty();
+}
+
+/**
+ * Parse the duration of a phase, either microseconds or distribution:mean[:shape] or trace:path.
+ *
+ * @param value The text to parse.
+ * @param mean_us The parsed mean in microseconds.
+ * @param result The parsed distribution.
+ *
+ * @return True if the text is a duration or names a distribution with valid parameters, false otherwise.
+ */
+bool parse_phase(const std::string &value, int &mean_us, PhaseTime &result)
+{
+    result = PhaseTime();
+    size_t first = value.find(':');
+    if (first == std::string::npos)
+    {
+        return parse_int(value, mean_us);
+    }
+    std::string name = value.substr(0, first);
+    if (name == "trace")
+    {
+        result.distribution = PhaseDistribution::TRACE;
+        if (!read_samples(value.substr(first + 1), result.samples_us))
+        {
+            return false;
+        }
+        double sum = 0;
+        for (int sample : result.samples_us)
+        {
+            sum += sample;
+        }
+        mean_us = static_cast<int>(sum / result.samples_us.size() + 0.5);
+        return true;
+    }
+    size_t second = value.find(':', first + 1);
+    if (!parse_int(value.substr(first + 1, second - first - 1), mean_us))
+    {
+        return false;
+    }
+    if (second != std::string::npos && !parse_double(value.substr(second + 1), result.shape))
+    {
+        return false;
+    }
+
+    if (name == "exp")
+    {
+        result.distribution = PhaseDistribution::EXPONENTIAL;
+        return second == std::string::npos;
+    }
+    if (name == "lognormal")
+    {
+        result.distribution = PhaseDistribution::LOGNORMAL;
+        return second != std::string::npos;
+    }
+    if (name == "pareto")
+    {
+        result.distribution = PhaseDistribution::PARETO;
+        return second != std::string::npos && result.shape > 1;
+    }
+    return false;
+}
+
+/**
+ * @return The shortest duration a phase can be drawn with in microseconds.
+ */
+int shortest_us(const PhaseTime &phase, int mean_us)
+{
+    switch (phase.distribution)
+    {
+    case PhaseDistribution::CONSTANT:
+        return mean_us;
+    case PhaseDistribution::PARETO:
+        return static_cast<int>(mean_us * (phase.shape - 1) / phase.shape);
+    case PhaseDistribution::TRACE:
+        return *std::min_element(phase.samples_us.begin(), phase.samples_us.end());
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @return The longest duration a phase can be drawn with in microseconds, -1 if there is no bound.
+ */
+int longest_us(const PhaseTime &phase, int mean_us)
+{
+    switch (phase.distribution)
+    {
+    case PhaseDistribution::CONSTANT:
+        return mean_us;
+    case PhaseDistribution::TRACE:
+        return *std::max_element(phase.samples_us.begin(), phase.samples_us.end());
+    default:
+        return -1;
+    }
+}
+
+/**
+ * Parse the name of a receive policy.
+ *
+ * @param value The text to parse.
+ * @param result The parsed policy.
+ *
+ * @return True if the text names a policy, false otherwise.
+ */
+bool parse_receive_policy(const std::string &value, ReceivePolicy &result)
+{
+    if (value == "spin")
+    {
+        result = ReceivePolicy::SPIN;
+    }
+    else if (value == "adaptive")
+    {
+        result = ReceivePolicy::ADAPTIVE;
+    }
+    else if (value == "block")
+    {
+        result = ReceivePolicy::BLOCK;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parse the name of a protocol.
+ *
+ * @param value The text to parse.
+ * @param result The parsed protocol.
+ *
+ * @return True if the text names a protocol, false otherwise.
+ */
+bool parse_protocol(const std::string &value, Protocol &result)
+{
+    if (value == "broadcast")
+    {
+        result = Protocol::BROADCAST;
+    }
+    else if (value == "ricart-agrawala")
+    {
+        result = Protocol::RICART_AGRAWALA;
+    }
+    else if (value == "maekawa")
+    {
+        result = Protocol::MAEKAWA;
+    }
+    else if (value == "suzuki-kasami")
+    {
+        result = Protocol::SUZUKI_KASAMI;
+    }
+    else if (value == "rma")
+    {
+        result = Protocol::RMA;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parse the name of a metrics format.
+ *
+ * @param value The text to parse.
+ * @param result The parsed format.
+ *
+ * @return True if the text names a format, false otherwise.
+ */
+bool parse_metrics_format(const std::string &value, MetricsFormat &result)
+{
+    if (value == "off")
+    {
+        result = MetricsFormat::OFF;
+    }
+    else if (value == "text")
+    {
+        result = MetricsFormat::TEXT;
+    }
+    else if (value == "json")
+    {
+        result = MetricsFormat::JSON;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parse the name of a transport.
+ *
+ * @param value The text to parse.
+ * @param result The parsed transport.
+ *
+ * @return True if the text names a transport, false otherwise.
+ */
+bool parse_transport(const std::string &value, TransportBackend &result)
+{
+    if (value == "mpi")
+    {
+        result = TransportBackend::MPI;
+    }
+    else if (value == "in-process")
+    {
+        result = TransportBackend::IN_PROCESS;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parse the name of an executor.
+ *
+ * @param value The text to parse.
+ * @param result The parsed executor.
+ *
+ * @return True if the text names an executor, false otherwise.
+ */
+bool parse_executor(const std::string &value, ExecutorKind &result)
+{
+    if (value == "threads")
+    {
+        result = ExecutorKind::THREADS;
+    }
+    else if (value == "coroutines")
+    {
+        result = ExecutorKind::COROUTINES;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parse the name of a topology.
+ *
+ * @param value The text to parse.
+ * @param result The parsed topology.
+ *
+ * @return True if the text names a topology, false otherwise.
+ */
+bool parse_topology(const std::string &value, Topology &result)
+{
+    if (value == "flat")
+    {
+        result = Topology::FLAT;
+    }
+    else if (value == "node")
+    {
+        result = Topology::NODE;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int max_weapons_held(const Config &config)
+{
+    // Every cycle takes at least the shortest roaming and laboratory phases
+    int cycle_us = shortest_us(config.weapon_time, config.weapon_us) +
+                   shortest_us(config.laboratory_time, config.laboratory_us);
+    int recharge_us = longest_us(config.recharge_time, config.recharge_us);
+    if (cycle_us == 0 || recharge_us == -1)
+    {
+        return config.weapons;
+    }
+    return std::min(config.weapons, 1 + (recharge_us + cycle_us - 1) / cycle_us);
+}
+
+int parse_config(int argc, char **argv, Config &config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        size_t separator = argument.find('=');
+        if (argument.rfind("--", 0) != 0 || separator == std::string::npos)
+        {
+            fprintf(stderr, "[ERROR]: Invalid argument %s, expected --name=value\n", argv[i]);
+            return -1;
+        }
+        std::string name = argument.substr(2, separator - 2);
+        std::string value = argument.substr(separator + 1);
+
+        bool valid = false;
+        if (name == "protocol")
+        {
+            valid = parse_protocol(value, config.protocol);
+        }
+        else if (name == "receive")
+        {
+            valid = parse_receive_policy(value, config.receive_policy);
+        }
+        else if (name == "receive-slots")
+        {
+            valid = parse_int(value, config.receive_slots) && config.receive_slots > 0;
+        }
+        else if (name == "spin-iterations")
+        {
+            valid = parse_int(value, config.spin_iterations);
+        }
+        else if (name == "yield-iterations")
+        {
+            valid = parse_int(value, config.yield_iterations);
+        }
+        else if (name == "max-backoff-us")
+        {
+            valid = parse_int(value, config.max_backoff_us) && config.max_backoff_us > 0;
+        }
+        else if (name == "batch-size")
+        {
+            valid = parse_int(value, config.batch_size) && config.batch_size > 0;
+        }
+        else if (name == "batch-delay-us")
+        {
+            valid = parse_int(value, config.batch_delay_us);
+        }
+        else if (name == "trace")
+        {
+            config.trace_prefix = value;
+            valid = !value.empty();
+        }
+        else if (name == "record")
+        {
+            config.record_prefix = value;
+            valid = !value.empty();
+        }
+        else if (name == "replay")
+        {
+            config.replay_prefix = value;
+            valid = !value.empty();
+        }
+        else if (name == "entries")
+        {
+            valid = parse_int(value, config.entries);
+        }
+        else if (name == "metrics")
+        {
+            valid = parse_metrics_format(value, config.metrics_format);
+        }
+        else if (name == "metrics-file")
+        {
+            config.metrics_file = value;
+            valid = !value.empty();
+        }
+        else if (name == "metrics-interval-ms")
+        {
+            valid = parse_int(value, config.metrics_interval_ms);
+        }
+        else if (name == "weapons")
+        {
+            valid = parse_int(value, config.weapons) && config.weapons > 0;
+        }
+        else if (name == "laboratories")
+        {
+            valid = parse_int(value, config.laboratories) && config.laboratories > 0;
+        }
+        else if (name == "weapon-us")
+        {
+            valid = parse_phase(value, config.weapon_us, config.weapon_time);
+        }
+        else if (name == "laboratory-us")
+        {
+            valid = parse_phase(value, config.laboratory_us, config.laboratory_time);
+        }
+        else if (name == "recharge-us")
+        {
+            valid = parse_phase(value, config.recharge_us, config.recharge_time);
+        }
+        else if (name == "duration-ms")
+        {
+            valid = parse_int(value, config.duration_ms);
+        }
+        else if (name == "transport")
+        {
+            valid = parse_transport(value, config.transport);
+        }
+        else if (name == "executor")
+        {
+            valid = parse_executor(value, config.executor);
+        }
+        else if (name == "thieves")
+        {
+            valid = parse_int(value, config.thieves) && config.thieves > 0;
+        }
+        else if (name == "topology")
+        {
+            valid = parse_topology(value, config.topology);
+        }
+        else if (name == "node-size")
+        {
+            valid = parse_int(value, config.node_size) && config.node_size >= 0;
+        }
+        else if (name == "lease")
+        {
+            valid = parse_int(value, config.lease) && config.lease > 0;
+        }
+        else if (name == "latency")
+        {
+            valid = parse_latency(value, config.latency);
+        }
+        else if (name == "handle-ns")
+        {
+            valid = parse_int(value, config.handle_ns);
+        }
+        else if (name == "seed")
+        {
+            valid = parse_int(value, config.seed);
+        }
+        else if (name == "ack-horizon")
+        {
+            valid = parse_int(value, config.ack_horizon) && config.ack_horizon >= 0;
+        }
+        else if (name == "lab-lead-us")
+        {
+            valid = parse_int(value, config.lab_lead_us) && config.lab_lead_us >= 0;
+        }
+        else if (name == "victim-probability")
+        {
+            valid = parse_double(value, config.victim_probability) && config.victim_probability > 0 &&
+                    config.victim_probability <= 1;
+        }
+        else if (name == "shards")
+        {
+            valid = parse_int(value, config.shards) && config.shards > 0 && config.shards <= MAX_SHARDS;
+        }
+        else
+        {
+            fprintf(stderr, "[ERROR]: Unknown argument --%s\n", name.c_str());
+            return -1;
+        }
+
+        if (!valid)
+        {
+            fprintf(stderr, "[ERROR]: Invalid value for --%s: %s\n", name.c_str(), value.c_str());
+            return -1;
+        }
+    }
+    // Every thief subscribes to two shards, with two of them everyone arbitrates both and nothing is saved
+    if (config.shards == 2)
+    {
+        fprintf(stderr, "[ERROR]: Two shards are arbitrated by every thief, use one or at least three\n");
+        return -1;
+    }
+    if (config.shards > std::min(config.weapons, config.laboratories))
+    {
+        fprintf(stderr, "[ERROR]: Every one of the %d shards needs a weapon and a laboratory\n", config.shards);
+        return -1;
+    }
+    return 0;
+}
+
+} // namespace mood_thieves
@@ -0,0 +1,216 @@
+#include "mood_thieves/coroutine_thief.hpp"
+#include "mood_thieves/trace.hpp"
+#include <algorithm>
+#include <stdio.h>
+#include <utility>
+
+namespace mood_thieves
+{
+
+CoroutineThief::CoroutineThief(Executor &executor, Metrics &metrics, int id, int size, const Config &config)
+    : executor(executor), metrics(metrics), id(id), size(size), config(config),
+      started(std::chrono::steady_clock::now()),
+      workload(config, id), max_weapons(max_weapons_held(config))
+{
+    pools.emplace_back(config.protocol, id, size, config.weapons, max_weapons, config.ack_horizon,
+                       config.shards);
+    pools.emplace_back(config.protocol, id, size, config.laboratories, 1, config.ack_horizon, config.shards);
+}
+
+int64_t CoroutineThief::elapsedNs() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+Task CoroutineThief::run()
+{
+    while (true)
+    {
+        // Peers count on no thief holding more than max_weapons, however late a recharge ends
+        co_await Recharged{*this, max_weapons - 1};
+        co_await acquire(utils::ResourceType::WEAPON);
+        // The laboratory may be requested before the roam ends to collect its ACKs meanwhile
+        int roam_us = workload.roamUs();
+        int lead_us = std::min(config.lab_lead_us, roam_us);
+        co_await executor.sleep_for(std::chrono::microseconds(roam_us - lead_us));
+        if (lead_us > 0)
+        {
+            request(utils::ResourceType::LABORATORY);
+        }
+        co_await executor.sleep_for(std::chrono::microseconds(lead_us));
+
+        if (!workload.findsVictim())
+        {
+            abandon(lead_us > 0);
+            if (config.duration_ms > 0 && elapsedNs() >= config.duration_ms * int64_t{1000000})
+            {
+                break;
+            }
+            continue;
+        }
+        if (lead_us > 0)
+        {
+            co_await Granted{*this, utils::ResourceType::LABORATORY};
+        }
+        else
+        {
+            co_await acquire(utils::ResourceType::LABORATORY);
+        }
+        laboratory_entries++;
+        co_await executor.sleep_for(std::chrono::microseconds(workload.laboratoryUs()));
+
+        clock++;
+        trace::record(trace::EXIT, clock, -1, utils::ResourceType::LABORATORY);
+        pools[utils::ResourceType::LABORATORY].release(taken_shards[utils::ResourceType::LABORATORY], clock,
+                                                       sender(utils::ResourceType::LABORATORY));
+
+        recharging++;
+        executor.spawn(recharge(taken_shards[utils::ResourceType::WEAPON]));
+
+        if ((config.entries > 0 && laboratory_entries >= config.entries) ||
+            (config.duration_ms > 0 && elapsedNs() >= config.duration_ms * int64_t{1000000}))
+        {
+            break;
+        }
+    }
+
+    printf("[%d] LEFT LAB | CLOCK: %d | ENTRIES: %d\n", id, clock, laboratory_entries);
+
+    // Channels are FIFO, nothing may follow the FINISH
+    co_await Recharged{*this, 0};
+    clock++;
+    for (int i = 0; i < size; i++)
+    {
+        send(i, utils::MessageType::FINISH, clock, -1, 0);
+    }
+}
+
+Task CoroutineThief::recharge(int shard)
+{
+    trace::record(trace::RECHARGE_START, clock, -1, utils::ResourceType::WEAPON);
+    co_await executor.sleep_for(std::chrono::microseconds(workload.rechargeUs()));
+    clock++;
+    trace::record(trace::RECHARGE_END, clock, -1, utils::ResourceType::WEAPON);
+    pools[utils::ResourceType::WEAPON].release(shard, clock, sender(utils::ResourceType::WEAPON));
+    if (waiting == utils::ResourceType::WEAPON && pools[utils::ResourceType::WEAPON].canEnter())
+    {
+        enter(utils::ResourceType::WEAPON);
+        executor.wake(std::exchange(waiting_handle, {}));
+    }
+    if (--recharging <= recharged_most && recharged_handle)
+    {
+        executor.wake(std::exchange(recharged_handle, {}));
+    }
+}
+
+bool CoroutineThief::request(int resource_type)
+{
+    clock++;
+    trace::record(trace::REQUEST, clock, -1, resource_type);
+    request_ns[resource_type] = elapsedNs();
+    waiting = resource_type;
+    pools[resource_type].request(clock, sender(resource_type));
+    if (!pools[resource_type].canEnter())
+    {
+        return false;
+    }
+    enter(resource_type);
+    return true;
+}
+
+void CoroutineThief::abandon(bool requested)
+{
+    // Nobody to rob, the laboratory is not needed and the unused weapon goes back without recharging
+    clock++;
+    if (waiting == utils::ResourceType::LABORATORY)
+    {
+        trace::record(trace::WITHDRAW, clock, -1, utils::ResourceType::LABORATORY);
+        pools[utils::ResourceType::LABORATORY].withdraw(clock, sender(utils::ResourceType::LABORATORY));
+        waiting = -1;
+    }
+    else if (requested)
+    {
+        trace::record(trace::EXIT, clock, -1, utils::ResourceType::LABORATORY);
+        pools[utils::ResourceType::LABORATORY].release(taken_shards[utils::ResourceType::LABORATORY], clock,
+                                                       sender(utils::ResourceType::LABORATORY));
+    }
+    trace::record(trace::EXIT, clock, -1, utils::ResourceType::WEAPON);
+    pools[utils::ResourceType::WEAPON].release(taken_shards[utils::ResourceType::WEAPON], clock,
+                                               sender(utils::ResourceType::WEAPON));
+}
+
+void CoroutineThief::enter(int resource_type)
+{
+    metrics.record(resource_type == utils::ResourceType::WEAPON ? Metrics::ACQUIRE_WEAPON
+                                                                : Metrics::ACQUIRE_LABORATORY,
+                   elapsedNs() - request_ns[resource_type]);
+    trace::record(trace::ENTER, clock, -1, resource_type);
+    taken_shards[resource_type] = pools[resource_type].enter();
+    waiting = -1;
+}
+
+void CoroutineThief::handleMessage(const utils::message_t &message)
+{
+    const utils::message_data_t &data = message.data;
+    clock = std::max(clock, data.clock) + 1;
+    trace::record(trace::RECEIVE, clock, data.id, data.resource_type, message.type, data.clock, data.value);
+    metrics.countReceived(message.type);
+
+    if (message.type == utils::MessageType::FINISH)
+    {
+        finished_thieves++;
+        for (ShardedPool &pool : pools)
+        {
+            pool.receiveFinish(data.id);
+        }
+        return;
+    }
+    int resource_type = utils::resource_of(data.resource_type);
+    if (resource_type != utils::ResourceType::WEAPON && resource_type != utils::ResourceType::LABORATORY)
+    {
+        return;
+    }
+    if (message.type == utils::MessageType::ACK)
+    {
+        metrics.record(Metrics::ACK_RTT, elapsedNs() - request_ns[resource_type]);
+    }
+
+    ShardedPool &pool = pools[resource_type];
+    handling = true;
+    pool.receive(message, utils::shard_of(data.resource_type), clock, sender(resource_type));
+    handling = false;
+    if (message.type == utils::MessageType::REQUEST)
+    {
+        metrics.record(resource_type == utils::ResourceType::WEAPON ? Metrics::QUEUE_WEAPON
+                                                                    : Metrics::QUEUE_LABORATORY,
+                       pool.queueDepth());
+    }
+
+    // Enter right away, so no other message gets between the grant and taking the unit
+    if (waiting == resource_type && pool.canEnter())
+    {
+        enter(resource_type);
+        // A laboratory requested during the roam may be granted before the thief awaits it
+        if (waiting_handle)
+        {
+            executor.wake(std::exchange(waiting_handle, {}));
+        }
+    }
+}
+
+ShardedPool::Send CoroutineThief::sender(int resource_type)
+{
+    return [this, resource_type](int thief_id, int message_type, int message_clock, int shard, int value)
+    { send(thief_id, message_type, message_clock, utils::shard_resource(resource_type, shard), value); };
+}
+
+void CoroutineThief::send(int thief_id, int message_type, int message_clock, int resource_type, int value)
+{
+    // Replies of a handler wait for a batch, requests and messages of the business logic piggyback them
+    bool urgent = message_type == utils::MessageType::REQUEST || !handling;
+    metrics.countSent(message_type);
+    trace::record(trace::SEND, message_clock, thief_id, resource_type, message_type, message_clock, value);
+    executor.post(thief_id, {message_type, {id, message_clock, resource_type, value}}, urgent);
+}
+
+} // namespace mood_thieves
@@ -0,0 +1,273 @@
+#include "mood_thieves/distributed_semaphore.hpp"
+#include <algorithm>
+#include <future>
+
+namespace mood_thieves
+{
+
+DistributedSemaphore::Guard &DistributedSemaphore::Guard::operator=(Guard &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        semaphore = other.semaphore;
+        pool = other.pool;
+        other.semaphore = nullptr;
+    }
+    return *this;
+}
+
+void DistributedSemaphore::Guard::release()
+{
+    if (semaphore != nullptr)
+    {
+        semaphore->release(pool);
+        semaphore = nullptr;
+    }
+}
+
+void DistributedSemaphore::Guard::release_after(std::chrono::microseconds delay)
+{
+    if (semaphore != nullptr)
+    {
+        semaphore->release_after(pool, delay);
+        semaphore = nullptr;
+    }
+}
+
+DistributedSemaphore::DistributedSemaphore(Transport &transport, int id, int size, Protocol protocol,
+                                           const std::vector<SemaphorePool> &pools)
+    : transport(transport), id(id), size(size)
+{
+    for (const SemaphorePool &pool : pools)
+    {
+        int max_held = pool.max_held > 0 ? std::min(pool.max_held, pool.capacity) : pool.capacity;
+        this->pools.push_back({pool.name, max_held, Arbitration(protocol, id, size, pool.capacity, max_held), {}});
+    }
+    receiver = std::thread(&DistributedSemaphore::receiveMessages, this);
+}
+
+DistributedSemaphore::~DistributedSemaphore()
+{
+    finish();
+}
+
+int DistributedSemaphore::pool(const std::string &name) const
+{
+    for (size_t index = 0; index < pools.size(); index++)
+    {
+        if (pools[index].name == name)
+        {
+            return static_cast<int>(index);
+        }
+    }
+    return -1;
+}
+
+void DistributedSemaphore::acquire(int pool)
+{
+    try_acquire_until(pool, Clock::time_point::max());
+}
+
+bool DistributedSemaphore::try_acquire_until(int pool, Clock::time_point deadline)
+{
+    std::promise<bool> acquired;
+    std::future<bool> result = acquired.get_future();
+    acquire_async(pool, [&acquired](bool taken) { acquired.set_value(taken); }, deadline);
+    return result.get();
+}
+
+void DistributedSemaphore::acquire_async(int pool, Callback callback, Clock::time_point deadline)
+{
+    Ready ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t ticket = next_ticket++;
+        pools[pool].waiters.push_back({ticket, std::move(callback)});
+        if (deadline != Clock::time_point::max())
+        {
+            timers.schedule(std::chrono::ceil<std::chrono::microseconds>(deadline - Clock::now()),
+                            [this, pool, ticket] { expire(pool, ticket); });
+        }
+        progress(pool, ready);
+    }
+    complete(ready);
+}
+
+DistributedSemaphore::Guard DistributedSemaphore::guard(int pool)
+{
+    acquire(pool);
+    return Guard(*this, pool);
+}
+
+DistributedSemaphore::Guard DistributedSemaphore::try_guard_for(int pool, std::chrono::microseconds timeout)
+{
+    return try_acquire_for(pool, timeout) ? Guard(*this, pool) : Guard();
+}
+
+void DistributedSemaphore::release(int pool)
+{
+    Ready ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Pool &state = pools[pool];
+        if (state.held == 0)
+        {
+            fprintf(stderr, "[ERROR]: Participant %d releases a unit of %s it does not hold\n", id,
+                    state.name.c_str());
+            return;
+        }
+        clock++;
+        state.arbitration.release(clock, sender(pool));
+        state.held--;
+        progress(pool, ready);
+    }
+    complete(ready);
+}
+
+void DistributedSemaphore::release_after(int pool, std::chrono::microseconds delay)
+{
+    timers.schedule(delay, [this, pool] { release(pool); });
+}
+
+void DistributedSemaphore::finish()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!finishing)
+    {
+        finishing = true;
+        clock++;
+        for (int thief_id = 0; thief_id < size; thief_id++)
+        {
+            transport.post(thief_id, {utils::MessageType::FINISH, {id, clock, -1, 0}}, true);
+        }
+    }
+    // Every participant answers requests until the last one left
+    finished.wait(lock, [this] { return finished_count == size; });
+    lock.unlock();
+    if (receiver.joinable())
+    {
+        receiver.join();
+    }
+}
+
+void DistributedSemaphore::receiveMessages()
+{
+    Transport::Handler handler = [this](const utils::message_t &message)
+    {
+        Ready ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            handleMessage(message, ready);
+        }
+        complete(ready);
+    };
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (finished_count == size)
+            {
+                break;
+            }
+        }
+        transport.wait(handler);
+        transport.flushAll();
+    }
+    transport.flushAll();
+}
+
+void DistributedSemaphore::handleMessage(const utils::message_t &message, Ready &ready)
+{
+    const utils::message_data_t &data = message.data;
+    clock = std::max(clock, data.clock) + 1;
+    if (message.type == utils::MessageType::FINISH)
+    {
+        for (Pool &pool : pools)
+        {
+            pool.arbitration.receiveFinish(data.id);
+        }
+        if (++finished_count == size)
+        {
+            finished.notify_all();
+        }
+        return;
+    }
+    if (data.resource_type < 0 || data.resource_type >= static_cast<int>(pools.size()))
+    {
+        fprintf(stderr, "[ERROR]: Participant %d got a message about an unknown pool %d\n", id, data.resource_type);
+        return;
+    }
+    pools[data.resource_type].arbitration.receive(message, clock, sender(data.resource_type));
+    progress(data.resource_type, ready);
+}
+
+void DistributedSemaphore::progress(int pool, Ready &ready)
+{
+    Pool &state = pools[pool];
+    while (!state.waiters.empty())
+    {
+        if (!state.requesting)
+        {
+            // A participant holding its share takes no further unit until it releases one
+            if (state.held >= state.max_held)
+            {
+                return;
+            }
+            clock++;
+            state.arbitration.request(clock, sender(pool));
+            state.requesting = true;
+        }
+        if (!state.arbitration.canEnter())
+        {
+            return;
+        }
+        state.arbitration.enter();
+        state.requesting = false;
+        state.held++;
+        ready.emplace_back(std::move(state.waiters.front().callback), true);
+        state.waiters.pop_front();
+    }
+}
+
+void DistributedSemaphore::expire(int pool, uint64_t ticket)
+{
+    Ready ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Pool &state = pools[pool];
+        auto waiter = std::find_if(state.waiters.begin(), state.waiters.end(),
+                                   [ticket](const Waiter &candidate) { return candidate.ticket == ticket; });
+        // Granted before the deadline
+        if (waiter == state.waiters.end())
+        {
+            return;
+        }
+        if (waiter == state.waiters.begin() && state.requesting)
+        {
+            clock++;
+            state.arbitration.withdraw(clock, sender(pool));
+            state.requesting = false;
+        }
+        ready.emplace_back(std::move(waiter->callback), false);
+        state.waiters.erase(waiter);
+        progress(pool, ready);
+    }
+    complete(ready);
+}
+
+void DistributedSemaphore::complete(Ready &ready)
+{
+    for (auto &[callback, acquired] : ready)
+    {
+        callback(acquired);
+    }
+}
+
+Arbitration::Send DistributedSemaphore::sender(int pool)
+{
+    return [this, pool](int thief_id, int message_type, int message_clock, int value)
+    { transport.post(thief_id, {message_type, {id, message_clock, pool, value}}, true); };
+}
+
+} // namespace mood_thieves
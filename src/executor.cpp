@@ -0,0 +1,102 @@
+#include "mood_thieves/executor.hpp"
+#include "mood_thieves/receive_engine.hpp"
+
+namespace mood_thieves
+{
+
+Executor::Executor(Transport &transport, int rank, int thieves_per_rank, const Config &config)
+    : transport(transport), rank(rank), thieves_per_rank(thieves_per_rank), config(config)
+{
+}
+
+Executor::~Executor()
+{
+    for (void *address : spawned)
+    {
+        std::coroutine_handle<>::from_address(address).destroy();
+    }
+}
+
+void Executor::spawn(Task task)
+{
+    std::coroutine_handle<> handle = task.release();
+    spawned.insert(handle.address());
+    ready.push_back(handle);
+}
+
+void Executor::resume(std::coroutine_handle<> handle)
+{
+    handle.resume();
+    if (handle.done())
+    {
+        spawned.erase(handle.address());
+        handle.destroy();
+    }
+}
+
+void Executor::post(int thief_id, utils::message_t message, bool urgent)
+{
+    message.to = thief_id;
+    int destination = thief_id / thieves_per_rank;
+    if (destination == rank)
+    {
+        local.push_back(message);
+        local_messages++;
+        return;
+    }
+    transport.post(destination, message, urgent);
+}
+
+void Executor::run(const Transport::Handler &handler, const std::function<bool()> &done)
+{
+    IdlePolicy idle_policy(config);
+    while (!spawned.empty() || !done())
+    {
+        bool progressed = false;
+        Clock::time_point now = Clock::now();
+        while (!timers.empty() && timers.top().wake_at <= now)
+        {
+            ready.push_back(timers.top().handle);
+            timers.pop();
+        }
+        while (!ready.empty())
+        {
+            std::coroutine_handle<> handle = ready.front();
+            ready.pop_front();
+            resume(handle);
+            progressed = true;
+        }
+        // Handlers may add local messages and wake coroutines, both are picked up by the next round
+        while (!local.empty())
+        {
+            utils::message_t message = local.front();
+            local.pop_front();
+            handler(message);
+            progressed = true;
+        }
+        if (transport.poll(handler) > 0)
+        {
+            transport.flushExpired();
+            progressed = true;
+        }
+        if (progressed)
+        {
+            idle_policy.reset();
+            continue;
+        }
+
+        // Deferred messages go out once the rank runs out of work, so nothing waits on an idle rank
+        transport.flushAll();
+        if (config.receive_policy == ReceivePolicy::BLOCK && timers.empty())
+        {
+            transport.wait(handler);
+        }
+        else if (config.receive_policy != ReceivePolicy::SPIN)
+        {
+            idle_policy.idle();
+        }
+    }
+    transport.flushAll();
+}
+
+} // namespace mood_thieves
@@ -0,0 +1,118 @@
+#include "mood_thieves/in_process_transport.hpp"
+
+namespace mood_thieves
+{
+
+Mailbox::Mailbox() : tail(&stub), head(&stub)
+{
+}
+
+Mailbox::~Mailbox()
+{
+    utils::message_t message;
+    while (pop(message))
+    {
+    }
+}
+
+void Mailbox::link(Node *node)
+{
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node *previous = tail.exchange(node, std::memory_order_acq_rel);
+    // Between the exchange and this store the consumer sees the queue end at previous
+    previous->next.store(node, std::memory_order_release);
+}
+
+void Mailbox::push(const utils::message_t &message)
+{
+    Node *node = new Node;
+    node->message = message;
+    link(node);
+    wake();
+}
+
+void Mailbox::wake()
+{
+    push_count.fetch_add(1, std::memory_order_release);
+    push_count.notify_one();
+}
+
+bool Mailbox::pop(utils::message_t &message)
+{
+    Node *first = head;
+    Node *next = first->next.load(std::memory_order_acquire);
+    if (first == &stub)
+    {
+        if (next == nullptr)
+        {
+            return false;
+        }
+        head = next;
+        first = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr)
+    {
+        head = next;
+        message = first->message;
+        delete first;
+        return true;
+    }
+    if (first != tail.load(std::memory_order_acquire))
+    {
+        // A producer exchanged the tail but did not link its node yet
+        return false;
+    }
+    // The last node can only be taken once the stub is linked behind it
+    link(&stub);
+    next = first->next.load(std::memory_order_acquire);
+    if (next == nullptr)
+    {
+        return false;
+    }
+    head = next;
+    message = first->message;
+    delete first;
+    return true;
+}
+
+void InProcessTransport::post(int thief_id, const utils::message_t &message, bool)
+{
+    network.mailbox(thief_id).push(message);
+    sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+int InProcessTransport::poll(const Handler &handler)
+{
+    int handled = 0;
+    utils::message_t message;
+    while (own.pop(message))
+    {
+        handler(message);
+        handled++;
+    }
+    return handled;
+}
+
+void InProcessTransport::wake()
+{
+    woken.store(true);
+    own.wake();
+}
+
+int InProcessTransport::wait(const Handler &handler)
+{
+    while (true)
+    {
+        // Read the counter first, a push completing after the empty poll changes it
+        uint32_t seen = own.pushes();
+        int handled = poll(handler);
+        if (handled > 0 || woken.exchange(false))
+        {
+            return handled;
+        }
+        own.waitForPush(seen);
+    }
+}
+
+} // namespace mood_thieves
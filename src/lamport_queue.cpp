@@ -0,0 +1,129 @@
+#include "mood_thieves/lamport_queue.hpp"
+
+namespace mood_thieves
+{
+
+LamportQueue::LamportQueue(int id, int size, int capacity, int ack_horizon)
+    : id(id), size(size), capacity(capacity), horizon(ack_horizon * capacity), acked(size, false), queue(size)
+{
+}
+
+void LamportQueue::request(int clock)
+{
+    requesting = true;
+    request_clock = clock;
+    acks = 0;
+    acked.assign(size, false);
+    queue.watch(RequestTable::key(clock, id));
+    // The REQUEST is later than every held back request, it answers them all
+    owed.clear();
+}
+
+void LamportQueue::acknowledge(int thief_id)
+{
+    if (requesting && !acked[thief_id])
+    {
+        acked[thief_id] = true;
+        acks++;
+    }
+}
+
+bool LamportQueue::receiveRequest(int thief_id, int clock)
+{
+    queue.insert(thief_id, clock);
+    if (clock > request_clock && thief_id != id)
+    {
+        acknowledge(thief_id);
+    }
+    uint64_t key = RequestTable::key(clock, thief_id);
+    if (horizon <= 0 || thief_id == id || queue.countBefore(key) < horizon)
+    {
+        return true;
+    }
+    owed.insert(key);
+    return false;
+}
+
+void LamportQueue::receiveAck(int thief_id, int clock)
+{
+    if (clock == request_clock)
+    {
+        acknowledge(thief_id);
+    }
+}
+
+void LamportQueue::receiveRelease(int thief_id, int clock)
+{
+    if (thief_id == id)
+    {
+        return;
+    }
+    if (clock > request_clock)
+    {
+        acknowledge(thief_id);
+    }
+    // A request answered by a later message may be released before its held back ACK is due
+    uint64_t oldest = queue.oldest(thief_id);
+    owed.erase(oldest);
+    queue.remove(thief_id, oldest);
+}
+
+void LamportQueue::receiveWithdraw(int thief_id, int clock, int request_clock)
+{
+    if (thief_id != id && clock > this->request_clock)
+    {
+        acknowledge(thief_id);
+    }
+    uint64_t key = RequestTable::key(request_clock, thief_id);
+    owed.erase(key);
+    queue.remove(thief_id, key);
+}
+
+std::vector<std::pair<int, int>> LamportQueue::dueAcks()
+{
+    // Positions follow the order of the keys, only the oldest held back ones can have moved within the horizon
+    std::vector<std::pair<int, int>> due;
+    while (!owed.empty() && queue.countBefore(*owed.begin()) < horizon)
+    {
+        uint64_t key = *owed.begin();
+        due.emplace_back(static_cast<int>(key & UINT32_MAX), static_cast<int>(key >> 32));
+        owed.erase(owed.begin());
+    }
+    return due;
+}
+
+bool LamportQueue::canEnter() const
+{
+    if (!requesting || acks != size)
+    {
+        return false;
+    }
+    uint64_t key = RequestTable::key(request_clock, id);
+    return queue.contains(id, key) && queue.countBefore(key) < capacity;
+}
+
+void LamportQueue::enter()
+{
+    requesting = false;
+}
+
+void LamportQueue::release()
+{
+    // The pending request is younger than every held unit
+    uint64_t oldest = queue.oldest(id);
+    if (!(requesting && oldest == RequestTable::key(request_clock, id)))
+    {
+        queue.remove(id, oldest);
+    }
+    // So is the RELEASE than every held back request
+    owed.clear();
+}
+
+void LamportQueue::withdraw()
+{
+    requesting = false;
+    // The WITHDRAW is later than every held back request, it answers them all
+    owed.clear();
+}
+
+} // namespace mood_thieves
@@ -0,0 +1,227 @@
+#include "mood_thieves/maekawa.hpp"
+#include "mood_thieves/utils.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace mood_thieves
+{
+
+std::vector<int> grid_quorum(int id, int size)
+{
+    int columns = std::ceil(std::sqrt(size));
+    int row = id / columns;
+    int column = id % columns;
+
+    std::vector<int> quorum;
+    for (int i = row * columns; i < std::min((row + 1) * columns, size); i++)
+    {
+        quorum.push_back(i);
+    }
+    for (int i = column; i < size; i += columns)
+    {
+        if (i / columns != row)
+        {
+            quorum.push_back(i);
+        }
+    }
+    std::sort(quorum.begin(), quorum.end());
+    return quorum;
+}
+
+Maekawa::Maekawa(int id, int size, int units)
+    : id(id), units(units), quorum(grid_quorum(id, size)), granted(size, false), arbiters(units)
+{
+}
+
+std::vector<Maekawa::Action> Maekawa::request(int clock)
+{
+    // Spread the requests over the units, skipping the ones already held
+    do
+    {
+        request_unit = (id + requests++) % units;
+    } while (std::find(held.begin(), held.end(), request_unit) != held.end() &&
+             static_cast<int>(held.size()) < units);
+
+    requesting = true;
+    request_clock = clock;
+    failed = false;
+    inquired.clear();
+    std::fill(granted.begin(), granted.end(), false);
+
+    std::vector<Action> actions;
+    for (int thief_id : quorum)
+    {
+        actions.push_back({utils::MessageType::REQUEST, thief_id, request_unit});
+    }
+    return actions;
+}
+
+std::vector<Maekawa::Action> Maekawa::receive(int message_type, int thief_id, int clock, int unit)
+{
+    std::vector<Action> actions;
+    switch (message_type)
+    {
+    case utils::MessageType::REQUEST:
+        arbitrateRequest(thief_id, clock, unit, actions);
+        break;
+    case utils::MessageType::RELEASE:
+        arbitrateRelease(thief_id, unit, actions);
+        break;
+    case utils::MessageType::YIELD:
+        arbitrateYield(thief_id, unit, actions);
+        break;
+    case utils::MessageType::ACK:
+        if (requesting && unit == request_unit)
+        {
+            granted[thief_id] = true;
+        }
+        break;
+    case utils::MessageType::FAILED:
+        if (requesting && unit == request_unit)
+        {
+            failed = true;
+            yieldInquired(actions);
+        }
+        break;
+    case utils::MessageType::INQUIRE:
+        // An inquiry about a grant the thief no longer has is stale
+        if (!requesting || unit != request_unit || !granted[thief_id])
+        {
+            break;
+        }
+        inquired.push_back(thief_id);
+        if (failed)
+        {
+            yieldInquired(actions);
+        }
+        break;
+    }
+    return actions;
+}
+
+bool Maekawa::canEnter() const
+{
+    if (!requesting)
+    {
+        return false;
+    }
+    for (int thief_id : quorum)
+    {
+        if (!granted[thief_id])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Maekawa::enter()
+{
+    requesting = false;
+    inquired.clear();
+    held.push_back(request_unit);
+}
+
+std::vector<Maekawa::Action> Maekawa::release()
+{
+    std::vector<Action> actions;
+    if (held.empty())
+    {
+        return actions;
+    }
+    int unit = held.front();
+    held.erase(held.begin());
+    for (int thief_id : quorum)
+    {
+        actions.push_back({utils::MessageType::RELEASE, thief_id, unit});
+    }
+    return actions;
+}
+
+void Maekawa::yieldInquired(std::vector<Action> &actions)
+{
+    for (int thief_id : inquired)
+    {
+        granted[thief_id] = false;
+        actions.push_back({utils::MessageType::YIELD, thief_id, request_unit});
+    }
+    inquired.clear();
+}
+
+void Maekawa::grantNext(Arbiter &arbiter, int unit, std::vector<Action> &actions)
+{
+    arbiter.inquired = false;
+    if (arbiter.waiting.empty())
+    {
+        arbiter.locked = false;
+        return;
+    }
+    arbiter.locked = true;
+    arbiter.holder = arbiter.waiting.front();
+    arbiter.waiting.erase(arbiter.waiting.begin());
+    waiting_requests--;
+    actions.push_back({utils::MessageType::ACK, arbiter.holder.id, unit});
+}
+
+void Maekawa::arbitrateRequest(int thief_id, int clock, int unit, std::vector<Action> &actions)
+{
+    Arbiter &arbiter = arbiters[unit];
+    Entry entry{clock, thief_id, false};
+    if (!arbiter.locked)
+    {
+        arbiter.locked = true;
+        arbiter.holder = entry;
+        actions.push_back({utils::MessageType::ACK, thief_id, unit});
+        return;
+    }
+
+    auto position = std::lower_bound(arbiter.waiting.begin(), arbiter.waiting.end(), entry);
+    bool first = position == arbiter.waiting.begin();
+    position = arbiter.waiting.insert(position, entry);
+    waiting_requests++;
+
+    if (!first || arbiter.holder < entry)
+    {
+        position->failed = true;
+        actions.push_back({utils::MessageType::FAILED, thief_id, unit});
+        return;
+    }
+
+    // The new request is the oldest one, the one it displaced has to wait as well
+    if (arbiter.waiting.size() > 1 && !arbiter.waiting[1].failed)
+    {
+        arbiter.waiting[1].failed = true;
+        actions.push_back({utils::MessageType::FAILED, arbiter.waiting[1].id, unit});
+    }
+    if (!arbiter.inquired)
+    {
+        arbiter.inquired = true;
+        actions.push_back({utils::MessageType::INQUIRE, arbiter.holder.id, unit});
+    }
+}
+
+void Maekawa::arbitrateRelease(int thief_id, int unit, std::vector<Action> &actions)
+{
+    Arbiter &arbiter = arbiters[unit];
+    if (arbiter.locked && arbiter.holder.id == thief_id)
+    {
+        grantNext(arbiter, unit, actions);
+    }
+}
+
+void Maekawa::arbitrateYield(int thief_id, int unit, std::vector<Action> &actions)
+{
+    Arbiter &arbiter = arbiters[unit];
+    if (!arbiter.locked || arbiter.holder.id != thief_id)
+    {
+        return;
+    }
+    Entry yielded = arbiter.holder;
+    yielded.failed = true;
+    arbiter.waiting.insert(std::lower_bound(arbiter.waiting.begin(), arbiter.waiting.end(), yielded), yielded);
+    waiting_requests++;
+    grantNext(arbiter, unit, actions);
+}
+
+
+} // namespace mood_thieves
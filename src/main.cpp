@@ -1,24 +1,399 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <latch>
+#include <memory>
 #include <mpi.h>
+#include <mutex>
+#include <signal.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <thread>
+#include <vector>
 
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/coroutine_thief.hpp"
+#include "mood_thieves/executor.hpp"
+#include "mood_thieves/in_process_transport.hpp"
 #include "mood_thieves/mood_thieves.hpp"
+#include "mood_thieves/node_arbiter.hpp"
+#include "mood_thieves/schedule.hpp"
+#include "mood_thieves/timer_wheel.hpp"
+#include "mood_thieves/trace.hpp"
 #include "mood_thieves/utils.hpp"
+#include "mood_thieves/workload.hpp"
 
-void startFunc(int rank, int size)
+/**
+ * Opens the schedule files of a thief the configuration asks for.
+ *
+ * @return Status code, -1 if a file cannot be opened.
+ */
+int openSchedules(const mood_thieves::Config &config, int thief_id, mood_thieves::schedule::Recorder &recorder,
+                  mood_thieves::schedule::Replay &replay)
+{
+    if (!config.record_prefix.empty() && recorder.open(config.record_prefix, thief_id) == -1)
+    {
+        return -1;
+    }
+    if (!config.replay_prefix.empty() && replay.open(config.replay_prefix, thief_id) == -1)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Hands the open schedule files over to a thief.
+ */
+void useSchedules(const mood_thieves::Config &config, mood_thieves::MoodThieve &thief,
+                  mood_thieves::schedule::Recorder &recorder, mood_thieves::schedule::Replay &replay)
+{
+    if (!config.record_prefix.empty())
+    {
+        thief.recordSchedule(recorder);
+    }
+    if (!config.replay_prefix.empty())
+    {
+        thief.replaySchedule(replay);
+    }
+}
+
+void startFunc(int rank, int size, const mood_thieves::Config &config)
 {
     printf("Starting %d of %d\n", rank, size);
 
-    MPI_Datatype message_type;
-    mood_thieves::utils::initialize_message_type(message_type);
+    MPI_Datatype batch_type;
+    mood_thieves::utils::initialize_batch_type(batch_type);
 
-    mood_thieves::MoodThieve mood_thieve(message_type, rank, size);
+    mood_thieves::schedule::Recorder recorder;
+    mood_thieves::schedule::Replay replay;
+    if (openSchedules(config, rank, recorder, replay) == -1)
+    {
+        MPI_Abort(MPI_COMM_WORLD, 1);
+        return;
+    }
+
+    mood_thieves::MpiTransport transport(batch_type, MPI_COMM_WORLD, size, config);
+    mood_thieves::MoodThieve mood_thieve(transport, rank, size, config);
+    useSchedules(config, mood_thieve, recorder, replay);
     mood_thieve.receiveMessages();
+    mood_thieve.reportMetrics();
 
     printf("Finishing %d of %d\n", rank, size);
 }
 
+/**
+ * Runs a thief per rank that acquires its weapons and laboratories through the leader of its node and
+ * reports the metrics merged from all ranks, the messages counted are the ones between the leaders.
+ */
+void startHierarchical(int rank, int size, const mood_thieves::Config &config)
+{
+    MPI_Datatype batch_type;
+    mood_thieves::utils::initialize_batch_type(batch_type);
+
+    mood_thieves::Metrics metrics;
+    mood_thieves::NodeArbiter arbiter(MPI_COMM_WORLD, batch_type, config, metrics);
+    printf("Starting %d of %d on %d nodes%s\n", rank, size, arbiter.nodeCount(), arbiter.isLeader() ? ", leader" : "");
+    std::thread leader;
+    if (arbiter.isLeader())
+    {
+        leader = std::thread(&mood_thieves::NodeArbiter::lead, &arbiter);
+    }
+
+    // Every leader posted its receives before any thief starts
+    MPI_Barrier(MPI_COMM_WORLD);
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    auto elapsed_ns = [&started]
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started)
+            .count();
+    };
+    std::atomic<int> recharging{0};
+    {
+        mood_thieves::TimerWheel timers;
+        mood_thieves::Workload workload(config, rank);
+        int entries = 0;
+        while (true)
+        {
+            int64_t requested = elapsed_ns();
+            mood_thieves::trace::record(mood_thieves::trace::REQUEST, arbiter.lamportClock(), -1,
+                                        mood_thieves::utils::WEAPON);
+            arbiter.acquire(mood_thieves::utils::WEAPON);
+            mood_thieves::trace::record(mood_thieves::trace::ENTER, arbiter.lamportClock(), -1,
+                                        mood_thieves::utils::WEAPON);
+            metrics.record(mood_thieves::Metrics::ACQUIRE_WEAPON, elapsed_ns() - requested);
+            std::this_thread::sleep_for(std::chrono::microseconds(workload.roamUs()));
+
+            requested = elapsed_ns();
+            mood_thieves::trace::record(mood_thieves::trace::REQUEST, arbiter.lamportClock(), -1,
+                                        mood_thieves::utils::LABORATORY);
+            arbiter.acquire(mood_thieves::utils::LABORATORY);
+            mood_thieves::trace::record(mood_thieves::trace::ENTER, arbiter.lamportClock(), -1,
+                                        mood_thieves::utils::LABORATORY);
+            metrics.record(mood_thieves::Metrics::ACQUIRE_LABORATORY, elapsed_ns() - requested);
+            entries++;
+            std::this_thread::sleep_for(std::chrono::microseconds(workload.laboratoryUs()));
+
+            mood_thieves::trace::record(mood_thieves::trace::EXIT, arbiter.lamportClock(), -1,
+                                        mood_thieves::utils::LABORATORY);
+            arbiter.release(mood_thieves::utils::LABORATORY);
+            recharging++;
+            mood_thieves::trace::record(mood_thieves::trace::RECHARGE_START, arbiter.lamportClock(), -1,
+                                        mood_thieves::utils::WEAPON);
+            timers.schedule(std::chrono::microseconds(workload.rechargeUs()),
+                            [&arbiter, &recharging]
+                            {
+                                mood_thieves::trace::record(mood_thieves::trace::RECHARGE_END, arbiter.lamportClock(),
+                                                            -1, mood_thieves::utils::WEAPON);
+                                arbiter.release(mood_thieves::utils::WEAPON);
+                                recharging--;
+                            });
+            if ((config.entries > 0 && entries >= config.entries) ||
+                (config.duration_ms > 0 && elapsed_ns() >= config.duration_ms * int64_t{1000000}))
+            {
+                break;
+            }
+        }
+        printf("[%d] LEFT LAB | ENTRIES: %d\n", rank, entries);
+        while (recharging.load() > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    arbiter.finish();
+    if (leader.joinable())
+    {
+        leader.join();
+    }
+
+    if (config.metrics_format != mood_thieves::MetricsFormat::OFF)
+    {
+        FILE *output = stdout;
+        if (rank == 0 && !config.metrics_file.empty())
+        {
+            output = fopen(config.metrics_file.c_str(), "w");
+            if (output == nullptr)
+            {
+                fprintf(stderr, "[ERROR]: Cannot open metrics file %s, reporting to stdout\n",
+                        config.metrics_file.c_str());
+                output = stdout;
+            }
+        }
+        metrics.report(MPI_COMM_WORLD, rank, elapsed_ns() / 1e9,
+                       config.metrics_format == mood_thieves::MetricsFormat::JSON, output);
+        if (output != stdout)
+        {
+            fclose(output);
+        }
+    }
+
+    printf("Finishing %d of %d\n", rank, size);
+}
+
+/**
+ * Reports the metrics merged from all ranks periodically until the thieves of any rank finished.
+ */
+mood_thieves::Task reportPeriodically(mood_thieves::Executor &executor, const mood_thieves::Metrics &metrics,
+                                      std::function<bool()> finished, std::chrono::steady_clock::time_point started,
+                                      int rank, const mood_thieves::Config &config, FILE *output)
+{
+    while (true)
+    {
+        co_await executor.sleep_for(std::chrono::milliseconds(config.metrics_interval_ms));
+        // All ranks stop in the same round, so everyone calls the same number of reductions
+        int stop = finished(), any_stop = 0;
+        MPI_Allreduce(&stop, &any_stop, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        if (any_stop)
+        {
+            co_return;
+        }
+        metrics.report(MPI_COMM_WORLD, rank,
+                       std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count(),
+                       config.metrics_format == mood_thieves::MetricsFormat::JSON, output, config.thieves);
+    }
+}
+
+/**
+ * Runs --thieves thieves on this rank as coroutines of the calling thread and reports the metrics merged
+ * from all ranks.
+ */
+void startCoroutines(int rank, int size, const mood_thieves::Config &config)
+{
+    int per_rank = config.thieves;
+    printf("Starting %d thieves on %d of %d\n", per_rank, rank, size);
+
+    MPI_Datatype batch_type;
+    mood_thieves::utils::initialize_batch_type(batch_type);
+
+    mood_thieves::MpiTransport transport(batch_type, MPI_COMM_WORLD, size, config);
+    mood_thieves::Executor executor(transport, rank, per_rank, config);
+    mood_thieves::Metrics metrics;
+    std::vector<std::unique_ptr<mood_thieves::CoroutineThief>> thieves;
+    for (int i = 0; i < per_rank; i++)
+    {
+        thieves.push_back(std::make_unique<mood_thieves::CoroutineThief>(executor, metrics, rank * per_rank + i,
+                                                                         size * per_rank, config));
+    }
+
+    FILE *output = nullptr;
+    bool json = config.metrics_format == mood_thieves::MetricsFormat::JSON;
+    if (rank == 0 && config.metrics_format != mood_thieves::MetricsFormat::OFF)
+    {
+        output = config.metrics_file.empty() ? stdout : fopen(config.metrics_file.c_str(), "w");
+        if (output == nullptr)
+        {
+            fprintf(stderr, "[ERROR]: Cannot open metrics file %s, reporting to stdout\n", config.metrics_file.c_str());
+            output = stdout;
+        }
+    }
+    auto all_finished = [&thieves]
+    {
+        return std::all_of(thieves.begin(), thieves.end(), [](const auto &thief) { return thief->finished(); });
+    };
+
+    // Every rank posted its receives before any thief starts
+    MPI_Barrier(MPI_COMM_WORLD);
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    auto elapsed_s = [&started]
+    { return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count(); };
+    for (auto &thief : thieves)
+    {
+        executor.spawn(thief->run());
+    }
+    if (config.metrics_interval_ms > 0 && config.metrics_format != mood_thieves::MetricsFormat::OFF)
+    {
+        executor.spawn(reportPeriodically(executor, metrics, all_finished, started, rank, config, output));
+    }
+    executor.run([&](const mood_thieves::utils::message_t &message)
+                 { thieves[message.to - rank * per_rank]->handleMessage(message); },
+                 all_finished);
+
+    if (config.metrics_format != mood_thieves::MetricsFormat::OFF)
+    {
+        metrics.report(MPI_COMM_WORLD, rank, elapsed_s(), json, output, per_rank);
+    }
+    if (output != nullptr && output != stdout)
+    {
+        fclose(output);
+    }
+
+    printf("Finishing %d thieves on %d of %d, %ld messages stayed on the rank\n", per_rank, rank, size,
+           executor.localMessages());
+}
+
+/**
+ * Hosts all thieves as threads of this process, each receiving on its own thread, and reports
+ * their merged metrics.
+ */
+void startInProcess(const mood_thieves::Config &config)
+{
+    int size = config.thieves;
+    printf("Starting %d thieves in-process\n", size);
+
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    mood_thieves::InProcessNetwork network(size);
+    std::vector<std::unique_ptr<mood_thieves::InProcessTransport>> transports;
+    std::vector<mood_thieves::schedule::Recorder> recorders(size);
+    std::vector<mood_thieves::schedule::Replay> replays(size);
+    for (int id = 0; id < size; id++)
+    {
+        transports.push_back(std::make_unique<mood_thieves::InProcessTransport>(network, id));
+        if (openSchedules(config, id, recorders[id], replays[id]) == -1)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+            return;
+        }
+    }
+
+    // A thief has to be constructed on the thread receiving its messages
+    std::vector<std::unique_ptr<mood_thieves::MoodThieve>> thieves(size);
+    std::latch constructed(size);
+    std::vector<std::thread> threads;
+    for (int id = 0; id < size; id++)
+    {
+        threads.emplace_back(
+            [&, id]
+            {
+                thieves[id] = std::make_unique<mood_thieves::MoodThieve>(*transports[id], id, size, config,
+                                                                          MPI_COMM_NULL);
+                useSchedules(config, *thieves[id], recorders[id], replays[id]);
+                constructed.count_down();
+                thieves[id]->receiveMessages();
+            });
+    }
+    constructed.wait();
+    std::vector<const mood_thieves::Metrics *> metrics;
+    for (const auto &thief : thieves)
+    {
+        metrics.push_back(&thief->getMetrics());
+    }
+
+    FILE *output = nullptr;
+    bool json = config.metrics_format == mood_thieves::MetricsFormat::JSON;
+    if (config.metrics_format != mood_thieves::MetricsFormat::OFF)
+    {
+        output = config.metrics_file.empty() ? stdout : fopen(config.metrics_file.c_str(), "w");
+        if (output == nullptr)
+        {
+            fprintf(stderr, "[ERROR]: Cannot open metrics file %s, reporting to stdout\n", config.metrics_file.c_str());
+            output = stdout;
+        }
+    }
+    auto elapsed_s = [&started]
+    { return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count(); };
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    std::thread reporter;
+    if (output != nullptr && config.metrics_interval_ms > 0)
+    {
+        reporter = std::thread(
+            [&]
+            {
+                std::chrono::steady_clock::time_point next = started;
+                std::unique_lock<std::mutex> lock(done_mutex);
+                while (true)
+                {
+                    next += std::chrono::milliseconds(config.metrics_interval_ms);
+                    if (done_cv.wait_until(lock, next, [&done] { return done; }))
+                    {
+                        return;
+                    }
+                    mood_thieves::Metrics::report(metrics, elapsed_s(), json, output);
+                }
+            });
+    }
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    if (reporter.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(done_mutex);
+            done = true;
+        }
+        done_cv.notify_one();
+        reporter.join();
+    }
+    if (output != nullptr)
+    {
+        mood_thieves::Metrics::report(metrics, elapsed_s(), json, output);
+        if (output != stdout)
+        {
+            fclose(output);
+        }
+    }
+    thieves.clear();
+
+    printf("Finishing %d thieves in-process\n", size);
+}
+
 int main(int argc, char **argv)
 {
     int provided;
@@ -33,11 +408,108 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    mood_thieves::Config config;
+    if (mood_thieves::parse_config(argc, argv, config) == -1)
+    {
+        MPI_Abort(MPI_COMM_WORLD, 1);
+        return 1;
+    }
+
     int size, rank;
     MPI_Comm_size(MPI_COMM_WORLD, &size);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-    startFunc(rank, size);
+    if (!config.trace_prefix.empty())
+    {
+        if (mood_thieves::trace::open(config.trace_prefix, rank) == -1)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+            return 1;
+        }
+        // SIGUSR1 pauses and resumes tracing
+        signal(SIGUSR1, [](int) { mood_thieves::trace::toggle(); });
+    }
+
+    if (config.protocol == mood_thieves::Protocol::RMA &&
+        (config.topology != mood_thieves::Topology::FLAT || config.executor != mood_thieves::ExecutorKind::THREADS ||
+         config.transport != mood_thieves::TransportBackend::MPI))
+    {
+        fprintf(stderr, "[ERROR]: The rma protocol runs a threaded thief per rank over the mpi transport\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+        return 1;
+    }
+
+    if ((!config.record_prefix.empty() || !config.replay_prefix.empty()) &&
+        (config.protocol == mood_thieves::Protocol::RMA || config.topology != mood_thieves::Topology::FLAT ||
+         config.executor != mood_thieves::ExecutorKind::THREADS))
+    {
+        fprintf(stderr, "[ERROR]: Schedules are recorded and replayed by threaded thieves of the flat topology "
+                        "exchanging messages\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+        return 1;
+    }
+
+    if (config.shards > 1 &&
+        (config.protocol == mood_thieves::Protocol::RMA || config.topology != mood_thieves::Topology::FLAT))
+    {
+        fprintf(stderr, "[ERROR]: Sharded pools are arbitrated by messages between the thieves of the flat "
+                        "topology\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+        return 1;
+    }
+
+    if ((config.lab_lead_us > 0 || config.victim_probability < 1) &&
+        config.topology != mood_thieves::Topology::FLAT)
+    {
+        fprintf(stderr, "[ERROR]: Laboratories are requested early or withdrawn only in the flat topology\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+        return 1;
+    }
+
+    if (config.topology == mood_thieves::Topology::NODE)
+    {
+        if (config.executor != mood_thieves::ExecutorKind::THREADS ||
+            config.transport != mood_thieves::TransportBackend::MPI)
+        {
+            fprintf(stderr, "[ERROR]: The node topology runs a threaded thief per rank over the mpi transport\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+            return 1;
+        }
+        startHierarchical(rank, size, config);
+    }
+    else if (config.executor == mood_thieves::ExecutorKind::COROUTINES)
+    {
+        if (config.transport != mood_thieves::TransportBackend::MPI)
+        {
+            fprintf(stderr, "[ERROR]: Coroutine thieves talk to other ranks over the mpi transport\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+            return 1;
+        }
+        if (static_cast<int64_t>(size) * config.thieves > mood_thieves::utils::MAX_WIRE_ID + 1)
+        {
+            fprintf(stderr, "[ERROR]: At most %d thieves fit into the ids of a message\n",
+                    mood_thieves::utils::MAX_WIRE_ID + 1);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+            return 1;
+        }
+        startCoroutines(rank, size, config);
+    }
+    else if (config.transport == mood_thieves::TransportBackend::IN_PROCESS)
+    {
+        if (size != 1)
+        {
+            fprintf(stderr, "[ERROR]: The in-process transport hosts all thieves in a single rank\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+            return 1;
+        }
+        startInProcess(config);
+    }
+    else
+    {
+        startFunc(rank, size, config);
+    }
+
+    mood_thieves::trace::close();
 
     MPI_Finalize();
     return 0;
@@ -0,0 +1,283 @@
+#include "mood_thieves/metrics.hpp"
+#include <algorithm>
+
+namespace mood_thieves
+{
+
+namespace
+{
+
+const char *HISTOGRAM_NAMES[] = {
+    "acquire_weapon_us", "acquire_laboratory_us", "ack_rtt_us",     "queue_weapon",
+    "queue_laboratory",  "remote_ops",            "command_lag_us", "broadcast_us",
+};
+
+const char *MESSAGE_NAMES[] = {"REQUEST", "ACK",   "RELEASE",  "INQUIRE", "YIELD", "FAILED",
+                               "FINISH",  "TOKEN", "WITHDRAW", "SERVED",  "OTHER"};
+
+/**
+ * @return The divisor turning the recorded values of a histogram into the reported unit.
+ */
+double scale(Metrics::HistogramId id)
+{
+    return id == Metrics::QUEUE_WEAPON || id == Metrics::QUEUE_LABORATORY || id == Metrics::REMOTE_OPS ? 1.0 : 1000.0;
+}
+
+void write_text(FILE *output, double elapsed_s, int size, const std::vector<HistogramSummary> &summaries,
+                const uint64_t *sent, const uint64_t *received)
+{
+    fprintf(output, "[METRICS] %.1f s, %d thieves\n", elapsed_s, size);
+    fprintf(output, "%-28s %10s %10s %10s %10s %10s %10s %10s\n", "histogram", "count", "mean", "p50", "p90", "p99",
+            "p99.9", "max");
+    for (int i = 0; i < Metrics::HISTOGRAMS; i++)
+    {
+        const HistogramSummary &summary = summaries[i];
+        double divisor = scale(static_cast<Metrics::HistogramId>(i));
+        double mean = summary.count > 0 ? static_cast<double>(summary.sum) / summary.count : 0;
+        fprintf(output, "%-28s %10lu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", HISTOGRAM_NAMES[i],
+                static_cast<unsigned long>(summary.count), mean / divisor, summary.percentile(0.5) / divisor,
+                summary.percentile(0.9) / divisor, summary.percentile(0.99) / divisor,
+                summary.percentile(0.999) / divisor, summary.max / divisor);
+    }
+    fprintf(output, "%-28s", "messages");
+    for (int i = 0; i < Metrics::MESSAGE_TYPES; i++)
+    {
+        fprintf(output, " %s %lu/%lu", MESSAGE_NAMES[i], static_cast<unsigned long>(sent[i]),
+                static_cast<unsigned long>(received[i]));
+    }
+    fprintf(output, " (sent/received)\n");
+}
+
+void write_json(FILE *output, double elapsed_s, int size, const std::vector<HistogramSummary> &summaries,
+                const uint64_t *sent, const uint64_t *received)
+{
+    fprintf(output, "{\"elapsed_s\":%.3f,\"thieves\":%d,\"histograms\":{", elapsed_s, size);
+    for (int i = 0; i < Metrics::HISTOGRAMS; i++)
+    {
+        const HistogramSummary &summary = summaries[i];
+        double divisor = scale(static_cast<Metrics::HistogramId>(i));
+        double mean = summary.count > 0 ? static_cast<double>(summary.sum) / summary.count : 0;
+        fprintf(output,
+                "%s\"%s\":{\"count\":%lu,\"mean\":%.3f,\"min\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,"
+                "\"p999\":%.3f,\"max\":%.3f}",
+                i > 0 ? "," : "", HISTOGRAM_NAMES[i], static_cast<unsigned long>(summary.count), mean / divisor,
+                summary.min / divisor, summary.percentile(0.5) / divisor, summary.percentile(0.9) / divisor,
+                summary.percentile(0.99) / divisor, summary.percentile(0.999) / divisor, summary.max / divisor);
+    }
+    const uint64_t *counters[] = {sent, received};
+    const char *counter_names[] = {"sent", "received"};
+    fprintf(output, "},\"messages\":{");
+    for (int c = 0; c < 2; c++)
+    {
+        fprintf(output, "%s\"%s\":{", c > 0 ? "," : "", counter_names[c]);
+        for (int i = 0; i < Metrics::MESSAGE_TYPES; i++)
+        {
+            fprintf(output, "%s\"%s\":%lu", i > 0 ? "," : "", MESSAGE_NAMES[i],
+                    static_cast<unsigned long>(counters[c][i]));
+        }
+        fprintf(output, "}");
+    }
+    fprintf(output, "}}\n");
+}
+
+} // namespace
+
+int Histogram::bucket(uint64_t value)
+{
+    if (value < SUB_BUCKETS)
+    {
+        return value;
+    }
+    int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+    return (shift + 1) * SUB_BUCKETS + static_cast<int>(value >> shift) - SUB_BUCKETS;
+}
+
+uint64_t Histogram::bucketUpperBound(int bucket)
+{
+    if (bucket < SUB_BUCKETS)
+    {
+        return bucket;
+    }
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lower + ((uint64_t{1} << shift) - 1);
+}
+
+void Histogram::record(uint64_t value)
+{
+    counts[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t current = minimum.load(std::memory_order_relaxed);
+    while (value < current && !minimum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+    current = maximum.load(std::memory_order_relaxed);
+    while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void Histogram::appendSums(std::vector<uint64_t> &sums) const
+{
+    for (const auto &bucket_count : counts)
+    {
+        sums.push_back(bucket_count.load(std::memory_order_relaxed));
+    }
+    sums.push_back(count.load(std::memory_order_relaxed));
+    sums.push_back(sum.load(std::memory_order_relaxed));
+}
+
+uint64_t HistogramSummary::percentile(double quantile) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(quantile * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); i++)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            return std::min(Histogram::bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+void Metrics::countSent(int message_type)
+{
+    sent[std::clamp(message_type, 0, MESSAGE_TYPES - 1)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::countReceived(int message_type)
+{
+    received[std::clamp(message_type, 0, MESSAGE_TYPES - 1)].fetch_add(1, std::memory_order_relaxed);
+}
+
+const char *Metrics::name(HistogramId id)
+{
+    return HISTOGRAM_NAMES[id];
+}
+
+HistogramSummary Metrics::summary(HistogramId id) const
+{
+    const Histogram &histogram = histograms[id];
+    std::vector<uint64_t> sums;
+    histogram.appendSums(sums);
+    HistogramSummary result;
+    result.counts.assign(sums.begin(), sums.begin() + Histogram::BUCKETS);
+    result.count = sums[Histogram::BUCKETS];
+    result.sum = sums[Histogram::BUCKETS + 1];
+    result.min = result.count > 0 ? histogram.min() : 0;
+    result.max = histogram.max();
+    return result;
+}
+
+uint64_t Metrics::sentCount(int message_type) const
+{
+    return sent[std::clamp(message_type, 0, MESSAGE_TYPES - 1)].load(std::memory_order_relaxed);
+}
+
+void Metrics::collect(std::vector<uint64_t> &sums, std::vector<uint64_t> &mins, std::vector<uint64_t> &maxes) const
+{
+    for (const Histogram &histogram : histograms)
+    {
+        histogram.appendSums(sums);
+        mins.push_back(histogram.min());
+        maxes.push_back(histogram.max());
+    }
+    for (const auto &counter : sent)
+    {
+        sums.push_back(counter.load(std::memory_order_relaxed));
+    }
+    for (const auto &counter : received)
+    {
+        sums.push_back(counter.load(std::memory_order_relaxed));
+    }
+}
+
+void Metrics::write(const std::vector<uint64_t> &sums, const std::vector<uint64_t> &mins,
+                    const std::vector<uint64_t> &maxes, int size, double elapsed_s, bool json, FILE *output)
+{
+    std::vector<HistogramSummary> summaries(HISTOGRAMS);
+    const uint64_t *values = sums.data();
+    for (int i = 0; i < HISTOGRAMS; i++)
+    {
+        summaries[i].counts.assign(values, values + Histogram::BUCKETS);
+        summaries[i].count = values[Histogram::BUCKETS];
+        summaries[i].sum = values[Histogram::BUCKETS + 1];
+        summaries[i].min = summaries[i].count > 0 ? mins[i] : 0;
+        summaries[i].max = maxes[i];
+        values += Histogram::BUCKETS + 2;
+    }
+    if (json)
+    {
+        write_json(output, elapsed_s, size, summaries, values, values + MESSAGE_TYPES);
+    }
+    else
+    {
+        write_text(output, elapsed_s, size, summaries, values, values + MESSAGE_TYPES);
+    }
+    fflush(output);
+}
+
+void Metrics::report(MPI_Comm comm, int rank, double elapsed_s, bool json, FILE *output, int thieves_per_rank) const
+{
+    std::vector<uint64_t> sums, mins, maxes;
+    collect(sums, mins, maxes);
+
+    std::vector<uint64_t> total_sums(sums.size()), total_mins(mins.size()), total_maxes(maxes.size());
+    MPI_Reduce(sums.data(), total_sums.data(), sums.size(), MPI_UINT64_T, MPI_SUM, 0, comm);
+    MPI_Reduce(mins.data(), total_mins.data(), mins.size(), MPI_UINT64_T, MPI_MIN, 0, comm);
+    MPI_Reduce(maxes.data(), total_maxes.data(), maxes.size(), MPI_UINT64_T, MPI_MAX, 0, comm);
+    if (rank != 0)
+    {
+        return;
+    }
+
+    int size;
+    MPI_Comm_size(comm, &size);
+    write(total_sums, total_mins, total_maxes, size * thieves_per_rank, elapsed_s, json, output);
+}
+
+void Metrics::report(const std::vector<const Metrics *> &thieves, double elapsed_s, bool json, FILE *output)
+{
+    std::vector<uint64_t> total_sums, total_mins, total_maxes;
+    for (const Metrics *metrics : thieves)
+    {
+        std::vector<uint64_t> sums, mins, maxes;
+        metrics->collect(sums, mins, maxes);
+        if (total_sums.empty())
+        {
+            total_sums = sums;
+            total_mins = mins;
+            total_maxes = maxes;
+            continue;
+        }
+        for (size_t i = 0; i < sums.size(); i++)
+        {
+            total_sums[i] += sums[i];
+        }
+        for (size_t i = 0; i < mins.size(); i++)
+        {
+            total_mins[i] = std::min(total_mins[i], mins[i]);
+            total_maxes[i] = std::max(total_maxes[i], maxes[i]);
+        }
+    }
+    if (!thieves.empty())
+    {
+        write(total_sums, total_mins, total_maxes, thieves.size(), elapsed_s, json, output);
+    }
+}
+
+void Metrics::report(int size, double elapsed_s, bool json, FILE *output) const
+{
+    std::vector<uint64_t> sums, mins, maxes;
+    collect(sums, mins, maxes);
+    write(sums, mins, maxes, size, elapsed_s, json, output);
+}
+
+} // namespace mood_thieves
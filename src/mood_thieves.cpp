@@ -1,210 +1,373 @@
 #include "mood_thieves/mood_thieves.hpp"
-#define DEBUG false
-#define LABORATORIES_N 1
-#define SLEEP_WEAPON_TIME 1
-#define SLEEP_LABORATORY_TIME 3
-#define WEAPON_TIMEOUT 5
-#define WEAPONS_N 2
+#include "mood_thieves/receive_engine.hpp"
+#include "mood_thieves/trace.hpp"
 #include <algorithm>
 
 namespace mood_thieves
 {
 
-MoodThieve::MoodThieve(MPI_Datatype msg_t, int id, int size) : clock(utils::LamportClock{id}), msg_t(msg_t), size(size)
+MoodThieve::MoodThieve(Transport &transport, int id, int size, const Config &config, MPI_Comm comm)
+    : clock(utils::LamportClock{id}), transport(transport), size(size), config(config),
+      started(std::chrono::steady_clock::now()), max_weapons(max_weapons_held(config)), workload(config, id),
+      pools{ShardedPool(config.protocol, id, size, config.weapons, max_weapons, config.ack_horizon, config.shards),
+            ShardedPool(config.protocol, id, size, config.laboratories, 1, config.ack_horizon, config.shards)},
+      receiver_thread(pthread_self())
 {
-    logic_thread = std::thread(&MoodThieve::business_logic, this);
-    free_weapon_queue_thread = std::thread(&MoodThieve::free_weapon_queue, this);
-}
-
-void MoodThieve::free_weapon_queue()
-{
-    while (!end.load())
+    if (comm != MPI_COMM_NULL)
+    {
+        MPI_Comm_dup(comm, &metrics_comm);
+    }
+    if (config.protocol == Protocol::RMA)
     {
-        // If the queue is not empty
-        if (free_weapon_threads.size() > 0)
+        rma = std::make_unique<RmaSemaphores>(comm, config);
+    }
+    if (id == 0 && comm != MPI_COMM_NULL && config.metrics_format != MetricsFormat::OFF)
+    {
+        metrics_output = config.metrics_file.empty() ? stdout : fopen(config.metrics_file.c_str(), "w");
+        if (metrics_output == nullptr)
         {
-            // Get the first thread
-            std::thread *thread = &free_weapon_threads.front();
-            // If the thread is joinable
-            if (thread->joinable())
-            {
-                // Join it
-                thread->join();
-                // Remove it from the queue
-                free_weapon_threads.pop();
-            }
+            fprintf(stderr, "[ERROR]: Cannot open metrics file %s, reporting to stdout\n", config.metrics_file.c_str());
+            metrics_output = stdout;
         }
     }
+    if (config.metrics_interval_ms > 0 && comm != MPI_COMM_NULL && config.metrics_format != MetricsFormat::OFF)
+    {
+        metrics_thread = std::thread(&MoodThieve::metrics_loop, this);
+    }
+    logic_thread = std::thread(&MoodThieve::business_logic, this);
 }
 
 MoodThieve::~MoodThieve()
 {
     end.store(true);
     logic_thread.join();
+    if (metrics_thread.joinable())
+    {
+        finishing.store(true);
+        metrics_thread.join();
+    }
+    if (metrics_comm != MPI_COMM_NULL)
+    {
+        MPI_Comm_free(&metrics_comm);
+    }
+    if (metrics_output != nullptr && metrics_output != stdout)
+    {
+        fclose(metrics_output);
+    }
 }
 
-void MoodThieve::receiveMessages()
+int64_t MoodThieve::elapsedNs() const
 {
-    utils::message_data_t message_data;
-    MPI_Status status;
-    int message_available = 0;
-    while (1)
-    {
-        if (end.load())
-        {
-            break;
-        }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+}
 
-        // Check if there is a message available
-        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &message_available, &status);
+void MoodThieve::metrics_loop()
+{
+    std::chrono::steady_clock::time_point next = started;
+    while (true)
+    {
+        next += std::chrono::milliseconds(config.metrics_interval_ms);
+        std::this_thread::sleep_until(next);
 
-        if (!message_available)
+        // All thieves stop in the same round, so everyone calls the same number of reductions
+        int stop = finishing.load(), any_stop = 0;
+        MPI_Allreduce(&stop, &any_stop, 1, MPI_INT, MPI_MAX, metrics_comm);
+        if (any_stop)
         {
-            continue;
+            return;
         }
-        message_available = 0;
+        metrics.report(metrics_comm, clock.id, elapsedNs() / 1e9, config.metrics_format == MetricsFormat::JSON,
+                       metrics_output);
+    }
+}
 
-        message_data = {-1, -1, -1};
-        MPI_Recv(&message_data, 1, msg_t, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+void MoodThieve::reportMetrics()
+{
+    finishing.store(true);
+    if (metrics_thread.joinable())
+    {
+        metrics_thread.join();
+    }
+    if (metrics_comm != MPI_COMM_NULL && config.metrics_format != MetricsFormat::OFF)
+    {
+        metrics.report(metrics_comm, clock.id, elapsedNs() / 1e9, config.metrics_format == MetricsFormat::JSON,
+                       metrics_output);
+    }
+}
 
-        if (DEBUG)
+void MoodThieve::receiveMessages()
+{
+    trace::set_thread_role(trace::RECEIVER);
+    IdlePolicy idle_policy(config);
+    Transport::Handler handler = [this](const utils::message_t &message)
+    {
+        if (replay != nullptr && replay->following())
         {
-            printf("[DEBUG] Thief %d received message from %d with tag %d", clock.id, status.MPI_SOURCE,
-                   status.MPI_TAG);
-            printf(" | ID | CLOCK | RESOURCE : %d | %d | %d |\n", message_data.id, message_data.clock,
-                   message_data.resource_type);
+            held.push_back(message);
+            return;
         }
-        utils::message_t message = {status.MPI_TAG, message_data};
-
-        // Compare clocks
-        clock.lock();
-        clock.update(message_data.clock);
-        clock.increment();
-        clock.unlock();
-
-        // If the message is request
-        if (status.MPI_TAG == utils::MessageType::REQUEST)
+        handleMessage(message);
+    };
+    while (!end.load() && finished < size)
+    {
+        // Read before looking for work, a command queued after the check rings it and cuts the sleep short
+        uint32_t rings = doorbell.rings();
+        int commands = replay != nullptr ? followSchedule() : runCommands();
+        // Deferred messages go out once the receiver runs out of work, so nothing waits on an idle thief
+        if (config.receive_policy == ReceivePolicy::BLOCK)
         {
-            if (message.data.resource_type == utils::ResourceType::WEAPON)
-            {
-                // Add the message to the vector of messages and sort it in descending order
-                weapons_data_vector_mutex.lock();
-                weapons_data_vector.push_back(message.data);
-                std::sort(weapons_data_vector.begin(), weapons_data_vector.end(),
-                          [](const utils::message_data_t &a, const utils::message_data_t &b)
-                          {
-                              if (a.clock == b.clock)
-                              {
-                                  return a.id < b.id;
-                              }
-                              else
-                              {
-                                  return a.clock < b.clock;
-                              }
-                          });
-
-                if (isWeapon())
-                {
-                    wv.notify_one();
-                }
-
-                weapons_data_vector_mutex.unlock();
-            }
-            else if (message.data.resource_type == utils::ResourceType::LABORATORY)
+            transport.flushAll();
+            if (commands == 0)
             {
-                laborotories_data_vector_mutex.lock();
-                laborotories_data_vector.push_back(message.data);
-                std::sort(laborotories_data_vector.begin(), laborotories_data_vector.end(),
-                          [](const utils::message_data_t &a, const utils::message_data_t &b)
-                          {
-                              if (a.clock == b.clock)
-                              {
-                                  return a.id < b.id;
-                              }
-                              else
-                              {
-                                  return a.clock < b.clock;
-                              }
-                          });
-
-                if (isLaboratory())
-                {
-                    lv.notify_one();
-                }
-
-                laborotories_data_vector_mutex.unlock();
+                transport.wait(handler);
             }
-            clock.lock();
-            clock.increment();
-            sendAck(message_data.resource_type, message_data.id);
-            clock.unlock();
         }
-        else if (status.MPI_TAG == utils::MessageType::RELEASE)
+        else if (commands + transport.poll(handler) > 0)
         {
-            // Remove the message from the vector of messages
-            if (message.data.resource_type == utils::ResourceType::WEAPON)
-            {
-                if (message.data.id != this->clock.id)
-                {
-                    weapons_data_vector_mutex.lock();
-                    // Find the first message with the same id and remove it
-                    std::vector<utils::message_data_t>::iterator it =
-                        std::find_if(weapons_data_vector.begin(), weapons_data_vector.end(),
-                                     [message](const utils::message_data_t &m) { return m.id == message.data.id; });
-                    if (it != weapons_data_vector.end())
-                    {
-                        weapons_data_vector.erase(it);
-                    }
-                    if (weapons_data_vector.size() > 0 && isWeapon())
-                    {
-                        wv.notify_one();
-                    }
-                    weapons_data_vector_mutex.unlock();
-                }
-            }
-            else if (message.data.resource_type == utils::ResourceType::LABORATORY)
+            transport.flushExpired();
+            idle_policy.reset();
+        }
+        else
+        {
+            transport.flushAll();
+            if (config.receive_policy == ReceivePolicy::ADAPTIVE)
             {
-                laborotories_data_vector_mutex.lock();
-                laborotories_data_vector.erase(
-                    std::remove_if(laborotories_data_vector.begin(), laborotories_data_vector.end(),
-                                   [message](const utils::message_data_t &m) { return m.id == message.data.id; }),
-                    laborotories_data_vector.end());
-                if (laborotories_data_vector.size() > 0 && isLaboratory())
-                {
-                    lv.notify_one();
-                }
-                laborotories_data_vector_mutex.unlock();
+                idle_policy.idle(&doorbell, rings);
             }
         }
-        else if (status.MPI_TAG == utils::MessageType::ACK)
+    }
+    transport.flushAll();
+    if (replay != nullptr)
+    {
+        printf("[REPLAY] Thief %d followed %zu of %zu steps%s\n", clock.id, replay->taken(), replay->length(),
+               replay->divergent() ? ", then left the schedule" : "");
+    }
+}
+
+void MoodThieve::queueCommand(SpscQueue<Command> &commands, int message_type, int resource_type)
+{
+    int source = &commands == &timer_commands ? schedule::TIMER_COMMAND : schedule::LOGIC_COMMAND;
+    Command command = {message_type, resource_type, elapsedNs(), source};
+    if (config.protocol == Protocol::RMA && message_type != utils::MessageType::FINISH)
+    {
+        // The pools of the rma protocol live in the window, there is no state on the receiver to go through
+        runCommand(command);
+        return;
+    }
+    while (!commands.push(command))
+    {
+        std::this_thread::yield();
+    }
+    if (config.receive_policy == ReceivePolicy::BLOCK)
+    {
+        transport.wake();
+    }
+    else
+    {
+        doorbell.ring();
+    }
+}
+
+int MoodThieve::runCommands()
+{
+    // Weapons are released before the FINISH of the business logic, which waits for every recharge
+    int count = 0;
+    Command command;
+    executing = true;
+    while (timer_commands.pop(command) || logic_commands.pop(command))
+    {
+        runCommand(command);
+        count++;
+    }
+    executing = false;
+    return count;
+}
+
+int MoodThieve::followSchedule()
+{
+    int count = 0;
+    while (replay->following())
+    {
+        const schedule::Entry &entry = replay->next();
+        if (entry.kind == schedule::MESSAGE)
         {
-            if (message.data.resource_type == utils::ResourceType::WEAPON)
+            // Channels are FIFO, the message due is the oldest held one of its sender
+            auto message = std::find_if(held.begin(), held.end(), [&entry](const utils::message_t &candidate)
+                                        { return candidate.data.id == entry.peer; });
+            if (message == held.end())
             {
-                weapons_data_vector_mutex.lock();
-                weapons_ack++;
-                if (isWeapon())
-                {
-                    wv.notify_one();
-                }
-                weapons_data_vector_mutex.unlock();
+                return count;
             }
-            else if (message.data.resource_type == utils::ResourceType::LABORATORY)
+            utils::message_t due = *message;
+            held.erase(message);
+            handleMessage(due);
+        }
+        else
+        {
+            Command command;
+            if (!(entry.kind == schedule::TIMER_COMMAND ? timer_commands : logic_commands).pop(command))
             {
-                laborotories_data_vector_mutex.lock();
-                laboratories_ack++;
-                if (isLaboratory())
-                {
-                    lv.notify_one();
-                }
-                laborotories_data_vector_mutex.unlock();
+                return count;
             }
+            executing = true;
+            runCommand(command);
+            executing = false;
+        }
+        count++;
+    }
+    // Past the end of the schedule, or once the thief left it, everything is handled as it comes
+    for (const utils::message_t &message : held)
+    {
+        handleMessage(message);
+    }
+    count += held.size();
+    held.clear();
+    return count + runCommands();
+}
+
+void MoodThieve::step(const schedule::Entry &entry)
+{
+    if (recorder != nullptr)
+    {
+        recorder->append(entry);
+    }
+    if (replay != nullptr && replay->following())
+    {
+        replay->take(entry);
+    }
+}
+
+void MoodThieve::runCommand(const Command &command)
+{
+    step({clock.value(), 0, -1, static_cast<uint8_t>(command.source), static_cast<uint8_t>(command.message_type),
+          static_cast<uint8_t>(command.resource_type), {}});
+    if (command.message_type == utils::MessageType::FINISH)
+    {
+        clock.increment();
+        sendMessage(utils::MessageType::FINISH, -1);
+        return;
+    }
+    // A release carries the shard of its unit
+    int resource_type = utils::resource_of(command.resource_type);
+    if (command.message_type == utils::MessageType::REQUEST)
+    {
+        sendRequest(resource_type);
+    }
+    else if (command.message_type == utils::MessageType::WITHDRAW)
+    {
+        sendWithdraw(resource_type);
+    }
+    else
+    {
+        sendRelease(resource_type, utils::shard_of(command.resource_type));
+    }
+    metrics.record(Metrics::COMMAND_LAG, elapsedNs() - command.queued_ns);
+    if (command.message_type == utils::MessageType::RELEASE && resource_type == utils::ResourceType::WEAPON)
+    {
+        recharging--;
+        recharging.notify_one();
+    }
+    // A release may free a unit for the pending request of the same resource
+    grant(resource_type);
+}
+
+void MoodThieve::grant(int resource_type)
+{
+    // The unit of a withdrawn request is released by the arbitration itself, nobody waits for it
+    if (config.protocol == Protocol::RMA || !pools[resource_type].canEnter())
+    {
+        return;
+    }
+    int shard = pools[resource_type].enter();
+    granted[resource_type].store(shard + 1, std::memory_order_release);
+    granted[resource_type].notify_one();
+}
+
+int MoodThieve::waitFor(int resource_type)
+{
+    int shard = 0;
+    if (config.protocol == Protocol::RMA)
+    {
+        // Nothing announces a released unit, the pool is polled
+        while (!isRmaGranted(resource_type))
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
         }
+        metrics.record(Metrics::REMOTE_OPS, rma_operations[resource_type]);
+        rma_granted[resource_type] = false;
+    }
+    else
+    {
+        granted[resource_type].wait(0, std::memory_order_acquire);
+        shard = static_cast<int>(granted[resource_type].exchange(0, std::memory_order_relaxed)) - 1;
     }
+    metrics.record(resource_type == utils::ResourceType::WEAPON ? Metrics::ACQUIRE_WEAPON
+                                                                : Metrics::ACQUIRE_LABORATORY,
+                   elapsedNs() - request_ns[resource_type].load());
+    return shard;
+}
+
+void MoodThieve::handleMessage(const utils::message_t &message)
+{
+    const utils::message_data_t &message_data = message.data;
+
+    // Compare clocks
+    int message_clock = clock.receive(message_data.clock);
+    step({message_clock, message_data.clock, static_cast<int16_t>(message_data.id), schedule::MESSAGE,
+          static_cast<uint8_t>(message.type), static_cast<uint8_t>(message_data.resource_type), {}});
+    trace::record(trace::RECEIVE, message_clock, message_data.id, message_data.resource_type, message.type,
+                  message_data.clock, message_data.value);
+    metrics.countReceived(message.type);
+
+    // Channels are FIFO, nothing follows the FINISH of a thief
+    if (message.type == utils::MessageType::FINISH)
+    {
+        finished++;
+        for (ShardedPool &pool : pools)
+        {
+            pool.receiveFinish(message_data.id);
+        }
+        return;
+    }
+    // The shard travels with the resource type
+    int resource_type = utils::resource_of(message_data.resource_type);
+    if (resource_type != utils::ResourceType::WEAPON && resource_type != utils::ResourceType::LABORATORY)
+    {
+        return;
+    }
+    if (message.type == utils::MessageType::ACK)
+    {
+        metrics.record(Metrics::ACK_RTT, elapsedNs() - request_ns[resource_type].load());
+    }
+
+    // The receiver alone ticks the clock, the arbitration ticks a copy before every reply
+    int reply_clock = message_clock;
+    pools[resource_type].receive(message, utils::shard_of(message_data.resource_type), reply_clock,
+                                 sender(resource_type));
+    clock.advance(reply_clock);
+    if (message.type == utils::MessageType::REQUEST)
+    {
+        metrics.record(resource_type == utils::ResourceType::WEAPON ? Metrics::QUEUE_WEAPON
+                                                                    : Metrics::QUEUE_LABORATORY,
+                       pools[resource_type].queueDepth());
+    }
+    grant(resource_type);
+}
+
+ShardedPool::Send MoodThieve::sender(int resource_type)
+{
+    return [this, resource_type](int thief_id, int message_type, int message_clock, int shard, int value)
+    { send(message_type, {clock.id, message_clock, utils::shard_resource(resource_type, shard), value}, thief_id); };
 }
 
 void MoodThieve::business_logic()
 {
-    MPI_Barrier(MPI_COMM_WORLD);
+    trace::set_thread_role(trace::LOGIC);
+    // Thieves hosted in-process share a rank, their mailboxes exist before any of them starts
+    if (metrics_comm != MPI_COMM_NULL)
+    {
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
     while (1)
     {
         if (end.load())
@@ -212,177 +375,196 @@ void MoodThieve::business_logic()
             break;
         }
 
-        // Send request for a critical section
-        clock.lock();
-        clock.increment();
-        sendRequest(utils::ResourceType::WEAPON);
-        clock.unlock();
-        weapons_data_vector_mutex.unlock();
+        // Peers count on no thief holding more than max_weapons, however late the timer releases a recharged one
+        for (int held = recharging.load(); held >= max_weapons; held = recharging.load())
+        {
+            recharging.wait(held);
+        }
 
-        std::unique_lock<std::mutex> lk(wv_mutex);
+        // Send request for a critical section
+        request(utils::ResourceType::WEAPON);
+        int weapon_shard = waitFor(utils::ResourceType::WEAPON);
+
+        // Take weapon, the laboratory may be requested before the roam ends to collect its ACKs meanwhile
+        trace::record(trace::ENTER, clock.value(), -1, utils::ResourceType::WEAPON);
+        int roam_us = workload.roamUs();
+        int lead_us = std::min(config.lab_lead_us, roam_us);
+        std::this_thread::sleep_for(std::chrono::microseconds(roam_us - lead_us));
+        if (lead_us > 0)
+        {
+            request(utils::ResourceType::LABORATORY);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(lead_us));
 
-        do
+        if (!workload.findsVictim())
         {
-            weapons_data_vector_mutex.lock();
-            if (isWeapon())
+            // Nobody to rob, the laboratory is not needed and the unused weapon goes back without recharging
+            if (lead_us > 0)
+            {
+                trace::record(trace::WITHDRAW, clock.value(), -1, utils::ResourceType::LABORATORY);
+                queueCommand(logic_commands, utils::MessageType::WITHDRAW, utils::ResourceType::LABORATORY);
+            }
+            free_weapon_with_timeout(std::chrono::microseconds(0), weapon_shard);
+            if (config.duration_ms > 0 && elapsedNs() >= config.duration_ms * int64_t{1000000})
             {
-                weapons_data_vector_mutex.unlock();
-                break;
+                finish();
+                return;
             }
-            weapons_data_vector_mutex.unlock();
-            // Wait for 100 micro seconds
-            wv.wait_for(lk, std::chrono::microseconds(100));
-        } while (1);
-
-        // Take weapon
-        printf("\n[%d] TAKE WEAPON\n", clock.id);
-        weapons_data_vector_mutex.lock();
-        weapons_ack = 0;
-        weapons_data_vector_mutex.unlock();
-        sleep(SLEEP_WEAPON_TIME);
+            continue;
+        }
 
         // Request laboratory
-        clock.lock();
-        clock.increment();
-        sendRequest(utils::ResourceType::LABORATORY);
-        clock.unlock();
-
-        do
+        if (lead_us == 0)
         {
-            laborotories_data_vector_mutex.lock();
-            if (isLaboratory())
-            {
-                laborotories_data_vector_mutex.unlock();
-                break;
-            }
-            laborotories_data_vector_mutex.unlock();
-            // Wait for 100 micro seconds
-            lv.wait_for(lk, std::chrono::microseconds(100));
-        } while (1);
+            request(utils::ResourceType::LABORATORY);
+        }
+        int laboratory_shard = waitFor(utils::ResourceType::LABORATORY);
 
         // Enter laboratory
-        printf("[%d] ENTER LAB\n", clock.id);
-        laborotories_data_vector_mutex.lock();
-        laboratories_ack = 0;
-        laborotories_data_vector_mutex.unlock();
-        sleep(SLEEP_LABORATORY_TIME);
+        trace::record(trace::ENTER, clock.value(), -1, utils::ResourceType::LABORATORY);
+        laboratory_entries++;
+        std::this_thread::sleep_for(std::chrono::microseconds(workload.laboratoryUs()));
 
         // Release laboratory
-        printf("[%d] LEAVE LAB | CLOCK: %d \n", clock.id, clock.clock);
-        clock.lock();
-        clock.increment();
-        sendRelease(utils::ResourceType::LABORATORY);
-        clock.unlock();
-
-        // Create a thread and place it into a queue
-        std::thread free_resources_thread = std::thread(&MoodThieve::free_weapon_with_timeout, this, WEAPON_TIMEOUT);
-        free_weapon_threads.push(std::move(free_resources_thread));
-        wv.wait(lk);
-
-        // Remove the message from the vector of messages (in order not to re-enter the critical section)
-        laborotories_data_vector_mutex.lock();
-        laborotories_data_vector.erase(std::remove_if(laborotories_data_vector.begin(), laborotories_data_vector.end(),
-                                                      [this](const utils::message_data_t &m)
-                                                      { return m.id == this->clock.id; }),
-                                       laborotories_data_vector.end());
-        laborotories_data_vector_mutex.unlock();
+        trace::record(trace::EXIT, clock.value(), -1, utils::ResourceType::LABORATORY);
+        queueCommand(logic_commands, utils::MessageType::RELEASE,
+                     utils::shard_resource(utils::ResourceType::LABORATORY, laboratory_shard));
+
+        free_weapon_with_timeout(std::chrono::microseconds(workload.rechargeUs()), weapon_shard);
+
+        if ((config.entries > 0 && laboratory_entries >= config.entries) ||
+            (config.duration_ms > 0 && elapsedNs() >= config.duration_ms * int64_t{1000000}))
+        {
+            // Every exit is in the trace, the summary is printed once outside the measured cycle
+            printf("[%d] LEFT LAB | CLOCK: %d | ENTRIES: %d | CPU/ENTRY: %.2f ms | RECEIVER CPU/ENTRY: %.2f ms | "
+                   "MSGS/ENTRY: %.1f | SENDS/ENTRY: %.1f\n",
+                   clock.id, clock.value(), laboratory_entries, utils::process_cpu_time() * 1000.0 / laboratory_entries,
+                   utils::thread_cpu_time(receiver_thread) * 1000.0 / laboratory_entries,
+                   static_cast<double>(messages_sent.load()) / laboratory_entries,
+                   static_cast<double>(transport.batchesSent()) / laboratory_entries);
+            finish();
+            return;
+        }
     }
 }
 
-void MoodThieve::free_weapon_with_timeout(int timeout)
+void MoodThieve::request(int resource_type)
 {
-    weapons_data_vector_mutex.lock();
-    printf("[%d] WEAPON TIMEOUT STARTED\n", clock.id);
-
-    // Find the first message with the same id
-    auto it = std::find_if(weapons_data_vector.begin(), weapons_data_vector.end(),
-                           [this](const utils::message_data_t &m) { return m.id == this->clock.id; });
-    if (it != weapons_data_vector.end())
-    {
-        it->id = -1;
-    }
-
-    weapons_data_vector_mutex.unlock();
-    // Notify the wv condition variable
-    wv.notify_one();
-    sleep(timeout);
-    printf("[%d] WEAPON TIMEOUT ENDED | RELEASED\n", clock.id);
-    clock.lock();
-    clock.increment();
-    sendRelease(utils::ResourceType::WEAPON);
-    clock.unlock();
-    // Find the first message with the -1 id and erase it
-    weapons_data_vector_mutex.lock();
-    it = std::find_if(weapons_data_vector.begin(), weapons_data_vector.end(),
-                      [](const utils::message_data_t &m) { return m.id == -1; });
-    if (it != weapons_data_vector.end())
-    {
-        weapons_data_vector.erase(it);
-    }
-    weapons_data_vector_mutex.unlock();
+    trace::record(trace::REQUEST, clock.value(), -1, resource_type);
+    request_ns[resource_type].store(elapsedNs());
+    queueCommand(logic_commands, utils::MessageType::REQUEST, resource_type);
 }
 
-bool MoodThieve::isWeapon()
+void MoodThieve::finish()
 {
-    if (weapons_ack != size)
+    while (recharging.load() > 0)
     {
-        return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
-    int counter = 0;
-    for (auto &m : weapons_data_vector)
+    queueCommand(logic_commands, utils::MessageType::FINISH, -1);
+}
+
+void MoodThieve::free_weapon_with_timeout(std::chrono::microseconds timeout, int shard)
+{
+    recharging++;
+    trace::record(trace::RECHARGE_START, clock.value(), -1, utils::ResourceType::WEAPON);
+    timers.schedule(timeout, [this, shard] { free_weapon(shard); });
+}
+
+void MoodThieve::free_weapon(int shard)
+{
+    trace::set_thread_role(trace::TIMER);
+    trace::record(trace::RECHARGE_END, clock.value(), -1, utils::ResourceType::WEAPON);
+    queueCommand(timer_commands, utils::MessageType::RELEASE,
+                 utils::shard_resource(utils::ResourceType::WEAPON, shard));
+}
+
+bool MoodThieve::isRmaGranted(int resource_type)
+{
+    if (!rma_granted[resource_type])
     {
-        if (m.id == clock.id)
-        {
-            return true;
-        }
-        counter++;
-        if (counter == WEAPONS_N)
-        {
-            break;
-        }
+        rma_granted[resource_type] = rma->poll(resource_type, rma_tickets[resource_type]);
+        rma_operations[resource_type]++;
     }
-    return false;
+    return rma_granted[resource_type];
 }
 
-bool MoodThieve::isLaboratory()
+void MoodThieve::sendRequest(int resource_type)
 {
-    if (laboratories_ack != size)
+    if (config.protocol == Protocol::RMA)
     {
-        return false;
+        // Taking a ticket is the whole request, an uncontended one may enter right away
+        rma_tickets[resource_type] = rma->take(resource_type, rma_granted[resource_type]);
+        rma_operations[resource_type] = 1;
+        return;
     }
-    int counter = 0;
-    for (auto &m : laborotories_data_vector)
+    int64_t started_ns = elapsedNs();
+    pools[resource_type].request(clock.increment(), sender(resource_type));
+    if (config.protocol == Protocol::BROADCAST)
     {
-        if (m.id == clock.id)
-        {
-            return true;
-        }
-        counter++;
-        if (counter == LABORATORIES_N)
-        {
-            break;
-        }
+        metrics.record(Metrics::BROADCAST, elapsedNs() - started_ns);
     }
-    return false;
 }
 
-void MoodThieve::sendRequest(int resource_type) { sendMessage(utils::MessageType::REQUEST, resource_type); }
-
-void MoodThieve::sendAck(int resource_type, int thief_id)
+void MoodThieve::sendRelease(int resource_type, int shard)
 {
-    utils::message_data_t message_data = {clock.id, clock.clock, resource_type};
-    MPI_Send(&message_data, 1, msg_t, thief_id, utils::MessageType::ACK, MPI_COMM_WORLD);
+    if (config.protocol == Protocol::RMA)
+    {
+        rma->release(resource_type);
+        metrics.record(Metrics::REMOTE_OPS, 1);
+        return;
+    }
+    int64_t started_ns = elapsedNs();
+    pools[resource_type].release(shard, clock.increment(), sender(resource_type));
+    if (config.protocol == Protocol::BROADCAST)
+    {
+        metrics.record(Metrics::BROADCAST, elapsedNs() - started_ns);
+    }
 }
 
-void MoodThieve::sendRelease(int resource_type) { sendMessage(utils::MessageType::RELEASE, resource_type); }
+void MoodThieve::sendWithdraw(int resource_type)
+{
+    if (config.protocol == Protocol::RMA)
+    {
+        // A ticket cannot be given back, the unit is waited for and released
+        while (!isRmaGranted(resource_type))
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        rma_granted[resource_type] = false;
+        sendRelease(resource_type, 0);
+        return;
+    }
+    // Granted before the withdrawal arrived, the unit goes back to its shard
+    int taken = static_cast<int>(granted[resource_type].exchange(0, std::memory_order_acquire));
+    if (taken != 0)
+    {
+        sendRelease(resource_type, taken - 1);
+        return;
+    }
+    pools[resource_type].withdraw(clock.increment(), sender(resource_type));
+}
 
 void MoodThieve::sendMessage(int message_type, int resource_type)
 {
-    utils::message_data_t message_data = {clock.id, clock.clock, resource_type};
+    int64_t started_ns = elapsedNs();
+    utils::message_data_t message_data = {clock.id, clock.value(), resource_type, 0};
     for (int i = 0; i < size; i++)
     {
-        MPI_Send(&message_data, 1, msg_t, i, message_type, MPI_COMM_WORLD);
+        send(message_type, message_data, i);
     }
+    metrics.record(Metrics::BROADCAST, elapsedNs() - started_ns);
+}
+
+void MoodThieve::send(int message_type, const utils::message_data_t &message_data, int thief_id)
+{
+    // Replies wait for a batch, requests and the messages of commands piggyback them
+    bool urgent = message_type == utils::MessageType::REQUEST || executing;
+    metrics.countSent(message_type);
+    trace::record(trace::SEND, message_data.clock, thief_id, message_data.resource_type, message_type,
+                  message_data.clock, message_data.value);
+    transport.post(thief_id, {message_type, message_data}, urgent);
+    messages_sent++;
 }
 
 } // namespace mood_thieves
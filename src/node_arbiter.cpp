@@ -0,0 +1,250 @@
+#include "mood_thieves/node_arbiter.hpp"
+#include "mood_thieves/receive_engine.hpp"
+#include <algorithm>
+#include <new>
+
+namespace mood_thieves
+{
+
+// Atomics in the window are shared between processes, which only works for lock-free ones
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<int>::is_always_lock_free);
+
+NodeArbiter::NodeArbiter(MPI_Comm comm, MPI_Datatype batch_type, const Config &config, Metrics &metrics)
+    : config(config), metrics(metrics)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (config.node_size > 0)
+    {
+        MPI_Comm_split(comm, rank / config.node_size, rank, &node_comm);
+    }
+    else
+    {
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+    }
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+    MPI_Comm_split(comm, isLeader() ? 0 : MPI_UNDEFINED, rank, &leaders_comm);
+    if (isLeader())
+    {
+        MPI_Comm_rank(leaders_comm, &node);
+        MPI_Comm_size(leaders_comm, &nodes);
+    }
+    MPI_Bcast(&node, 1, MPI_INT, 0, node_comm);
+    MPI_Bcast(&nodes, 1, MPI_INT, 0, node_comm);
+
+    // The leader allocates the whole state, the other ranks map it
+    void *base = nullptr;
+    MPI_Win_allocate_shared(isLeader() ? sizeof(SharedState) : 0, 1, MPI_INFO_NULL, node_comm, &base, &window);
+    if (isLeader())
+    {
+        state = new (base) SharedState{};
+    }
+    else
+    {
+        MPI_Aint size;
+        int displacement;
+        MPI_Win_shared_query(window, 0, &size, &displacement, &base);
+        state = static_cast<SharedState *>(base);
+    }
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, window);
+    MPI_Barrier(node_comm);
+
+    if (isLeader())
+    {
+        transport = std::make_unique<MpiTransport>(batch_type, leaders_comm, nodes, config);
+        leases[utils::ResourceType::WEAPON].max_held = std::min(config.weapons, node_size * max_weapons_held(config));
+        leases[utils::ResourceType::LABORATORY].max_held = std::min(config.laboratories, node_size);
+        pools.emplace_back(config.protocol, node, nodes, config.weapons, leases[utils::ResourceType::WEAPON].max_held,
+                           config.ack_horizon);
+        pools.emplace_back(config.protocol, node, nodes, config.laboratories,
+                           leases[utils::ResourceType::LABORATORY].max_held, config.ack_horizon);
+    }
+}
+
+NodeArbiter::~NodeArbiter()
+{
+    transport.reset();
+    MPI_Win_unlock_all(window);
+    MPI_Win_free(&window);
+    if (leaders_comm != MPI_COMM_NULL)
+    {
+        MPI_Comm_free(&leaders_comm);
+    }
+    MPI_Comm_free(&node_comm);
+}
+
+void NodeArbiter::acquire(int resource_type)
+{
+    SharedQueue &queue = state->queues[resource_type];
+    uint32_t ticket = queue.tickets.fetch_add(1, std::memory_order_acq_rel);
+    IdlePolicy idle_policy(config);
+    // Tickets wrap around, the difference tells which one is older
+    while (static_cast<int32_t>(queue.granted.load(std::memory_order_acquire) - ticket) <= 0)
+    {
+        idle_policy.idle();
+    }
+}
+
+void NodeArbiter::release(int resource_type)
+{
+    state->queues[resource_type].released.fetch_add(1, std::memory_order_release);
+}
+
+void NodeArbiter::finish()
+{
+    state->finished.fetch_add(1, std::memory_order_release);
+}
+
+Arbitration::Send NodeArbiter::sender(int resource_type)
+{
+    return [this, resource_type](int leader, int message_type, int message_clock, int value)
+    {
+        metrics.countSent(message_type);
+        transport->post(leader, {message_type, {node, message_clock, resource_type, value}},
+                        message_type == utils::MessageType::REQUEST);
+    };
+}
+
+void NodeArbiter::releaseGlobally(int resource_type)
+{
+    clock++;
+    pools[resource_type].release(clock, sender(resource_type));
+    if (leases[resource_type].requesting && pools[resource_type].canEnter())
+    {
+        pools[resource_type].enter();
+        leases[resource_type].requesting = false;
+        leases[resource_type].idle.push_back(0);
+    }
+}
+
+bool NodeArbiter::progress(int resource_type)
+{
+    SharedQueue &queue = state->queues[resource_type];
+    Lease &lease = leases[resource_type];
+
+    // A returned unit serves the next local holder unless it served enough of them in a row
+    uint32_t released = queue.released.load(std::memory_order_acquire);
+    bool changed = lease.released != released;
+    while (lease.released != released)
+    {
+        lease.released++;
+        int served = lease.in_use.front();
+        lease.in_use.pop_front();
+        if (served >= config.lease)
+        {
+            releaseGlobally(resource_type);
+        }
+        else
+        {
+            lease.idle.push_back(served);
+        }
+    }
+
+    // A rank granted a unit traces its entry after every message that led to the grant
+    state->clock.store(clock, std::memory_order_release);
+    uint32_t waiting = queue.tickets.load(std::memory_order_acquire) - lease.granted;
+    changed = changed || (waiting > 0 && !lease.idle.empty());
+    while (waiting > 0 && !lease.idle.empty())
+    {
+        lease.in_use.push_back(lease.idle.front() + 1);
+        lease.idle.pop_front();
+        lease.granted++;
+        waiting--;
+        queue.granted.store(lease.granted, std::memory_order_release);
+    }
+    while (waiting == 0 && !lease.idle.empty())
+    {
+        lease.idle.pop_front();
+        releaseGlobally(resource_type);
+    }
+
+    // The peers count on a node never holding more than max_held units, pending request included
+    if (waiting > 0 && !lease.requesting && static_cast<int>(lease.in_use.size()) < lease.max_held)
+    {
+        changed = true;
+        lease.requesting = true;
+        clock++;
+        pools[resource_type].request(clock, sender(resource_type));
+        if (pools[resource_type].canEnter())
+        {
+            pools[resource_type].enter();
+            lease.requesting = false;
+            lease.idle.push_back(0);
+        }
+    }
+    return changed;
+}
+
+void NodeArbiter::handleMessage(const utils::message_t &message)
+{
+    const utils::message_data_t &data = message.data;
+    clock = std::max(clock, data.clock) + 1;
+    metrics.countReceived(message.type);
+    if (message.type == utils::MessageType::FINISH)
+    {
+        finished_nodes++;
+        for (Arbitration &pool : pools)
+        {
+            pool.receiveFinish(data.id);
+        }
+        return;
+    }
+    if (data.resource_type != utils::ResourceType::WEAPON && data.resource_type != utils::ResourceType::LABORATORY)
+    {
+        return;
+    }
+
+    Arbitration &pool = pools[data.resource_type];
+    Lease &lease = leases[data.resource_type];
+    pool.receive(message, clock, sender(data.resource_type));
+    if (lease.requesting && pool.canEnter())
+    {
+        pool.enter();
+        lease.requesting = false;
+        lease.idle.push_back(0);
+    }
+}
+
+void NodeArbiter::lead()
+{
+    IdlePolicy idle_policy(config);
+    Transport::Handler handler = [this](const utils::message_t &message) { handleMessage(message); };
+    bool finish_sent = false;
+    while (finished_nodes < nodes)
+    {
+        // Both resources make progress on every round
+        bool changed = progress(utils::ResourceType::WEAPON);
+        changed = progress(utils::ResourceType::LABORATORY) || changed;
+
+        // Channels are FIFO, nothing may follow the FINISH, so every unit has to be back first
+        if (!finish_sent && state->finished.load(std::memory_order_acquire) == node_size &&
+            leases[utils::ResourceType::WEAPON].in_use.empty() &&
+            leases[utils::ResourceType::LABORATORY].in_use.empty())
+        {
+            clock++;
+            for (int i = 0; i < nodes; i++)
+            {
+                sender(-1)(i, utils::MessageType::FINISH, clock, 0);
+            }
+            finish_sent = true;
+        }
+
+        if (transport->poll(handler) > 0 || changed)
+        {
+            transport->flushExpired();
+            idle_policy.reset();
+        }
+        else
+        {
+            transport->flushAll();
+            if (config.receive_policy != ReceivePolicy::SPIN)
+            {
+                idle_policy.idle();
+            }
+        }
+    }
+    transport->flushAll();
+}
+
+} // namespace mood_thieves
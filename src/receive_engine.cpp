@@ -0,0 +1,112 @@
+#include "mood_thieves/receive_engine.hpp"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace mood_thieves
+{
+
+ReceiveEngine::ReceiveEngine(MPI_Datatype batch_type, MPI_Comm comm, int slots, int max_batch)
+    : batch_type(batch_type), max_batch(max_batch), buffers(slots * max_batch), requests(slots), statuses(slots),
+      indices(slots), counts(slots), completed_slots(slots, false)
+{
+    for (int i = 0; i < slots; i++)
+    {
+        MPI_Recv_init(&buffers[i * max_batch], max_batch, batch_type, MPI_ANY_SOURCE, MPI_ANY_TAG, comm,
+                      &requests[i]);
+    }
+    MPI_Startall(slots, requests.data());
+}
+
+ReceiveEngine::~ReceiveEngine()
+{
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        if (!completed_slots[i])
+        {
+            MPI_Cancel(&requests[i]);
+            MPI_Wait(&requests[i], MPI_STATUS_IGNORE);
+        }
+        MPI_Request_free(&requests[i]);
+    }
+}
+
+int ReceiveEngine::poll(const Handler &handler)
+{
+    int completed = 0;
+    MPI_Testsome(requests.size(), requests.data(), &completed, indices.data(), statuses.data());
+    return drain(completed, handler);
+}
+
+int ReceiveEngine::wait(const Handler &handler)
+{
+    int completed = 0;
+    MPI_Waitsome(requests.size(), requests.data(), &completed, indices.data(), statuses.data());
+    return drain(completed, handler);
+}
+
+int ReceiveEngine::drain(int completed, const Handler &handler)
+{
+    if (completed == MPI_UNDEFINED)
+    {
+        return 0;
+    }
+    for (int i = 0; i < completed; i++)
+    {
+        completed_slots[indices[i]] = true;
+        MPI_Get_count(&statuses[i], batch_type, &counts[indices[i]]);
+    }
+
+    // A message could complete before an older one, keep the ring order
+    int handled = 0;
+    while (completed_slots[head])
+    {
+        // Handle the messages before the buffer is re-posted
+        for (int i = 0; i < counts[head]; i++)
+        {
+            handler(utils::unpack(buffers[head * max_batch + i]));
+        }
+        handled += counts[head];
+        completed_slots[head] = false;
+        MPI_Start(&requests[head]);
+        head = (head + 1) % requests.size();
+    }
+    return handled;
+}
+
+IdlePolicy::IdlePolicy(const Config &config)
+    : spin_iterations(config.spin_iterations), yield_iterations(config.yield_iterations),
+      max_backoff_us(config.max_backoff_us)
+{
+}
+
+void IdlePolicy::idle(utils::Doorbell *doorbell, uint32_t seen)
+{
+    idle_polls++;
+    if (idle_polls <= spin_iterations)
+    {
+        return;
+    }
+    if (idle_polls <= spin_iterations + yield_iterations)
+    {
+        std::this_thread::yield();
+        return;
+    }
+    if (doorbell != nullptr)
+    {
+        doorbell->sleep(seen, std::chrono::microseconds(backoff_us));
+    }
+    else
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(backoff_us));
+    }
+    backoff_us = std::min(backoff_us * 2, max_backoff_us);
+}
+
+void IdlePolicy::reset()
+{
+    idle_polls = 0;
+    backoff_us = 1;
+}
+
+} // namespace mood_thieves
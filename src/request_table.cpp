@@ -0,0 +1,130 @@
+#include "mood_thieves/request_table.hpp"
+#include <algorithm>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace mood_thieves
+{
+
+namespace
+{
+
+#if defined(__x86_64__)
+/**
+ * Counts the keys smaller than a key four at a time, the keys are below 2^63 so signed compares order them.
+ */
+__attribute__((target("avx2,popcnt"))) int count_less_avx2(const uint64_t *keys, size_t count, uint64_t key)
+{
+    const __m256i pivot = _mm256_set1_epi64x(static_cast<int64_t>(key));
+    int smaller = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(pivot, block)));
+        smaller += _mm_popcnt_u32(mask);
+    }
+    for (; i < count; i++)
+    {
+        smaller += keys[i] < key;
+    }
+    return smaller;
+}
+#endif
+
+} // namespace
+
+RequestTable::RequestTable(int size, int slots) : size(size), slots(slots), keys(size * slots, FREE)
+{
+}
+
+void RequestTable::insert(int thief_id, int clock)
+{
+    uint64_t *row = keys.data() + thief_id * slots;
+    uint64_t *slot = std::find(row, row + slots, FREE);
+    if (slot == row + slots)
+    {
+        grow();
+        insert(thief_id, clock);
+        return;
+    }
+    *slot = key(clock, thief_id);
+    requests++;
+    watched_before += *slot < watched;
+}
+
+uint64_t RequestTable::oldest(int thief_id) const
+{
+    const uint64_t *row = keys.data() + thief_id * slots;
+    return *std::min_element(row, row + slots);
+}
+
+void RequestTable::remove(int thief_id, uint64_t key)
+{
+    uint64_t *row = keys.data() + thief_id * slots;
+    uint64_t *slot = std::find(row, row + slots, key);
+    if (slot != row + slots && key != FREE)
+    {
+        *slot = FREE;
+        requests--;
+        watched_before -= key < watched;
+    }
+}
+
+void RequestTable::watch(uint64_t key)
+{
+    watched = key;
+    watched_before = countLess(keys.data(), keys.size(), key);
+}
+
+bool RequestTable::contains(int thief_id, uint64_t key) const
+{
+    const uint64_t *row = keys.data() + thief_id * slots;
+    return key != FREE && std::find(row, row + slots, key) != row + slots;
+}
+
+void RequestTable::grow()
+{
+    std::vector<uint64_t> grown(size * slots * 2, FREE);
+    for (int thief_id = 0; thief_id < size; thief_id++)
+    {
+        std::copy_n(keys.begin() + thief_id * slots, slots, grown.begin() + thief_id * slots * 2);
+    }
+    keys.swap(grown);
+    slots *= 2;
+}
+
+int RequestTable::countLessScalar(const uint64_t *keys, size_t count, uint64_t key)
+{
+    int smaller = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        smaller += keys[i] < key;
+    }
+    return smaller;
+}
+
+bool RequestTable::vectorized()
+{
+#if defined(__x86_64__)
+    static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+int RequestTable::countLess(const uint64_t *keys, size_t count, uint64_t key)
+{
+#if defined(__x86_64__)
+    if (vectorized())
+    {
+        return count_less_avx2(keys, count, key);
+    }
+#endif
+    return countLessScalar(keys, count, key);
+}
+
+} // namespace mood_thieves
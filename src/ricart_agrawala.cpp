@@ -0,0 +1,125 @@
+#include "mood_thieves/ricart_agrawala.hpp"
+#include <algorithm>
+
+namespace mood_thieves
+{
+
+RicartAgrawala::RicartAgrawala(int id, int size, int capacity, int max_held)
+    : id(id), capacity(capacity), max_held(max_held), owed(size, 0), debt(size, 0), postponed(size, false),
+      deferred(size)
+{
+}
+
+bool RicartAgrawala::older(int clock, int id, int other_clock, int other_id)
+{
+    if (clock == other_clock)
+    {
+        return id < other_id;
+    }
+    return clock < other_clock;
+}
+
+std::vector<int> RicartAgrawala::request(int clock)
+{
+    requesting = true;
+    request_clock = clock;
+
+    std::vector<int> recipients;
+    for (size_t i = 0; i < owed.size(); i++)
+    {
+        if (static_cast<int>(i) == id)
+        {
+            continue;
+        }
+        // Whatever is still owed belongs to the previous request, answers arrive in order
+        // so the new request is only sent once the old one is paid off
+        debt[i] += owed[i];
+        owed[i] = max_held;
+        if (debt[i] > 0)
+        {
+            postponed[i] = true;
+        }
+        else
+        {
+            recipients.push_back(i);
+        }
+    }
+    return recipients;
+}
+
+int RicartAgrawala::receiveRequest(int thief_id, int clock)
+{
+    // Defer every unit held now and the pending request if it is older
+    deferred[thief_id] = held;
+    if (requesting && older(request_clock, id, clock, thief_id))
+    {
+        deferred[thief_id].push_back(request_clock);
+    }
+    return std::max(0, max_held - static_cast<int>(deferred[thief_id].size()));
+}
+
+std::vector<int> RicartAgrawala::receiveAck(int thief_id, int units)
+{
+    int paid = std::min(units, debt[thief_id]);
+    debt[thief_id] -= paid;
+    owed[thief_id] = std::max(0, owed[thief_id] - (units - paid));
+
+    std::vector<int> recipients;
+    if (postponed[thief_id] && debt[thief_id] == 0)
+    {
+        postponed[thief_id] = false;
+        recipients.push_back(thief_id);
+    }
+    return recipients;
+}
+
+bool RicartAgrawala::canEnter() const
+{
+    if (!requesting)
+    {
+        return false;
+    }
+    int in_use = held.size();
+    for (int units : owed)
+    {
+        in_use += units;
+    }
+    return in_use < capacity;
+}
+
+void RicartAgrawala::enter()
+{
+    requesting = false;
+    held.push_back(request_clock);
+}
+
+std::vector<std::pair<int, int>> RicartAgrawala::release()
+{
+    std::vector<std::pair<int, int>> acks;
+    if (held.empty())
+    {
+        return acks;
+    }
+    int released = held.front();
+    held.erase(held.begin());
+
+    // Only the thieves that counted this very unit get an answer
+    for (size_t i = 0; i < deferred.size(); i++)
+    {
+        auto it = std::find(deferred[i].begin(), deferred[i].end(), released);
+        if (it != deferred[i].end())
+        {
+            deferred[i].erase(it);
+            acks.push_back({static_cast<int>(i), 1});
+        }
+    }
+    return acks;
+}
+
+int RicartAgrawala::queueDepth() const
+{
+    return std::count_if(deferred.begin(), deferred.end(),
+                         [](const std::vector<int> &clocks) { return !clocks.empty(); });
+}
+
+} // namespace mood_thieves
@@ -0,0 +1,79 @@
+#include "mood_thieves/rma_semaphores.hpp"
+#include "mood_thieves/utils.hpp"
+#include <stdio.h>
+
+namespace mood_thieves
+{
+
+namespace
+{
+
+constexpr uint64_t TICKET = uint64_t{1} << 32; ///< Adding it to a word takes a ticket.
+
+} // namespace
+
+RmaSemaphores::RmaSemaphores(MPI_Comm comm, const Config &config)
+{
+    int size;
+    MPI_Comm_size(comm, &size);
+    // The pools live on different ranks where there are two, so their atomics do not queue up on one target
+    homes[utils::ResourceType::WEAPON] = 0;
+    homes[utils::ResourceType::LABORATORY] = size - 1;
+    capacities[utils::ResourceType::WEAPON] = config.weapons;
+    capacities[utils::ResourceType::LABORATORY] = config.laboratories;
+
+    uint64_t *words;
+    MPI_Win_allocate(2 * sizeof(uint64_t), sizeof(uint64_t), MPI_INFO_NULL, comm, &words, &window);
+    words[0] = 0;
+    words[1] = 0;
+    MPI_Win_lock_all(0, window);
+    MPI_Barrier(comm);
+}
+
+RmaSemaphores::~RmaSemaphores()
+{
+    MPI_Win_unlock_all(window);
+    MPI_Win_free(&window);
+}
+
+bool RmaSemaphores::mayEnter(int resource_type, uint32_t ticket, uint32_t released) const
+{
+    // Neither half wraps, and the later tickets may release more units than the ticket waited for before it polls
+    return uint64_t{ticket} < uint64_t{released} + static_cast<uint64_t>(capacities[resource_type]);
+}
+
+uint32_t RmaSemaphores::take(int resource_type, bool &granted)
+{
+    uint64_t word;
+    MPI_Fetch_and_op(&TICKET, &word, MPI_UINT64_T, homes[resource_type], resource_type, MPI_SUM, window);
+    MPI_Win_flush(homes[resource_type], window);
+    uint32_t ticket = static_cast<uint32_t>(word >> 32);
+    // Releasing the last ticket of the upper half would carry the lower half into it
+    if (ticket == UINT32_MAX)
+    {
+        fprintf(stderr, "[ERROR]: The pool %d ran out of its 2^32 - 1 tickets\n", resource_type);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    granted = mayEnter(resource_type, ticket, static_cast<uint32_t>(word));
+    return ticket;
+}
+
+bool RmaSemaphores::poll(int resource_type, uint32_t ticket)
+{
+    // The origin buffer of MPI_NO_OP is ignored
+    uint64_t unused = 0;
+    uint64_t word;
+    MPI_Fetch_and_op(&unused, &word, MPI_UINT64_T, homes[resource_type], resource_type, MPI_NO_OP, window);
+    MPI_Win_flush(homes[resource_type], window);
+    return mayEnter(resource_type, ticket, static_cast<uint32_t>(word));
+}
+
+void RmaSemaphores::release(int resource_type)
+{
+    // Every released unit had a ticket below 2^32 - 1, so the lower half never carries into the tickets
+    uint64_t one = 1;
+    MPI_Accumulate(&one, 1, MPI_UINT64_T, homes[resource_type], resource_type, 1, MPI_UINT64_T, MPI_SUM, window);
+    MPI_Win_flush(homes[resource_type], window);
+}
+
+} // namespace mood_thieves
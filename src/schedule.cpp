@@ -0,0 +1,104 @@
+#include "mood_thieves/schedule.hpp"
+#include <cstring>
+
+namespace mood_thieves
+{
+namespace schedule
+{
+
+namespace
+{
+
+const size_t BLOCK = 4096;
+
+} // namespace
+
+std::string path(const std::string &prefix, int thief_id)
+{
+    return prefix + "." + std::to_string(thief_id) + ".schedule";
+}
+
+int Recorder::open(const std::string &prefix, int thief_id)
+{
+    std::string file_path = path(prefix, thief_id);
+    file = fopen(file_path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "[ERROR]: Cannot open schedule file %s\n", file_path.c_str());
+        return -1;
+    }
+    FileHeader header = {{'M', 'T', 'S', 'C'}, VERSION, thief_id, sizeof(Entry)};
+    fwrite(&header, sizeof(header), 1, file);
+    entries.reserve(BLOCK);
+    return 0;
+}
+
+void Recorder::append(const Entry &entry)
+{
+    entries.push_back(entry);
+    if (entries.size() == BLOCK)
+    {
+        fwrite(entries.data(), sizeof(Entry), entries.size(), file);
+        entries.clear();
+    }
+}
+
+void Recorder::close()
+{
+    if (file == nullptr)
+    {
+        return;
+    }
+    fwrite(entries.data(), sizeof(Entry), entries.size(), file);
+    entries.clear();
+    fclose(file);
+    file = nullptr;
+}
+
+int Replay::open(const std::string &prefix, int thief_id)
+{
+    std::string file_path = path(prefix, thief_id);
+    FILE *file = fopen(file_path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "[ERROR]: Cannot open schedule file %s\n", file_path.c_str());
+        return -1;
+    }
+    FileHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "MTSC", 4) == 0 &&
+                 header.version == VERSION && header.entry_size == sizeof(Entry) && header.thief == thief_id;
+    Entry entry;
+    while (valid && fread(&entry, sizeof(entry), 1, file) == 1)
+    {
+        entries.push_back(entry);
+    }
+    fclose(file);
+    if (!valid)
+    {
+        fprintf(stderr, "[ERROR]: %s is not a schedule of thief %d\n", file_path.c_str(), thief_id);
+        return -1;
+    }
+    thief = thief_id;
+    position = 0;
+    diverged = false;
+    return 0;
+}
+
+void Replay::take(const Entry &taken)
+{
+    const Entry &recorded = entries[position];
+    if (!(taken == recorded))
+    {
+        fprintf(stderr,
+                "[ERROR]: Thief %d left its schedule at step %zu: recorded kind %d type %d peer %d clock %d, "
+                "took kind %d type %d peer %d clock %d\n",
+                thief, position, recorded.kind, recorded.message_type, recorded.peer, recorded.clock, taken.kind,
+                taken.message_type, taken.peer, taken.clock);
+        diverged = true;
+        return;
+    }
+    position++;
+}
+
+} // namespace schedule
+} // namespace mood_thieves
@@ -0,0 +1,208 @@
+#include "mood_thieves/sharded_pool.hpp"
+#include <algorithm>
+
+namespace mood_thieves
+{
+
+ShardedPool::ShardedPool(Protocol protocol, int id, int size, int capacity, int max_held, int ack_horizon,
+                         int shards)
+    : random(id + 1)
+{
+    for (int index : subscriptions(id, shards))
+    {
+        int shard_capacity = shardCapacity(capacity, shards, index);
+        // A single shard numbers the thieves as they are, without a list of everyone
+        std::vector<int> members;
+        for (int thief_id = 0; thief_id < size && shards > 1; thief_id++)
+        {
+            if (subscribes(thief_id, index, shards))
+            {
+                members.push_back(thief_id);
+            }
+        }
+        int local = shards > 1 ? static_cast<int>(std::lower_bound(members.begin(), members.end(), id) -
+                                                  members.begin())
+                               : id;
+        int local_size = shards > 1 ? static_cast<int>(members.size()) : size;
+        int shard_max_held = std::min(max_held, shard_capacity);
+        this->shards.push_back({index, shard_capacity, shard_max_held, std::move(members),
+                                Arbitration(protocol, local, local_size, shard_capacity, shard_max_held,
+                                            ack_horizon)});
+    }
+}
+
+std::vector<int> ShardedPool::subscriptions(int thief_id, int shards)
+{
+    if (shards == 1)
+    {
+        return {0};
+    }
+    // Every shard is the first of K / M thieves, the second shards spread over all the others
+    int first = thief_id % shards;
+    int second = (first + 1 + thief_id / shards % (shards - 1)) % shards;
+    return {std::min(first, second), std::max(first, second)};
+}
+
+int ShardedPool::shardCapacity(int capacity, int shards, int shard)
+{
+    return capacity / shards + (shard < capacity % shards ? 1 : 0);
+}
+
+bool ShardedPool::subscribes(int thief_id, int shard, int shards)
+{
+    int first = thief_id % shards;
+    return shards == 1 || first == shard || (first + 1 + thief_id / shards % (shards - 1)) % shards == shard;
+}
+
+int ShardedPool::localId(const Shard &shard, int thief_id)
+{
+    if (shard.members.empty())
+    {
+        return thief_id;
+    }
+    auto position = std::lower_bound(shard.members.begin(), shard.members.end(), thief_id);
+    return position != shard.members.end() && *position == thief_id
+               ? static_cast<int>(position - shard.members.begin())
+               : -1;
+}
+
+Arbitration::Send ShardedPool::sender(const Shard &shard, const Send &send)
+{
+    return [&shard, &send](int thief_id, int message_type, int clock, int value)
+    {
+        int global_id = shard.members.empty() ? thief_id : shard.members[thief_id];
+        send(global_id, message_type, clock, shard.index, value);
+    };
+}
+
+ShardedPool::Shard *ShardedPool::find(int shard)
+{
+    for (Shard &subscribed : shards)
+    {
+        if (subscribed.index == shard)
+        {
+            return &subscribed;
+        }
+    }
+    return nullptr;
+}
+
+int ShardedPool::choose()
+{
+    int best_position = -1;
+    for (int position = 0; position < static_cast<int>(shards.size()); position++)
+    {
+        // The peers of a shard count on the thief holding no more than its share of the shard
+        const Shard &other = shards[position];
+        if (std::count(held.begin(), held.end(), position) >= other.max_held)
+        {
+            continue;
+        }
+        if (best_position < 0)
+        {
+            best_position = position;
+            continue;
+        }
+        // Requests queued per unit, compared without dividing
+        const Shard &best = shards[best_position];
+        int64_t best_load = static_cast<int64_t>(best.arbitration.queueDepth()) * other.capacity;
+        int64_t other_load = static_cast<int64_t>(other.arbitration.queueDepth()) * best.capacity;
+        if (other_load < best_load || (other_load == best_load && random() % 2 == 0))
+        {
+            best_position = position;
+        }
+    }
+    return best_position;
+}
+
+void ShardedPool::request(int clock, const Send &send)
+{
+    pending = choose();
+    postponed = pending < 0;
+    if (postponed)
+    {
+        return;
+    }
+    Shard &shard = shards[pending];
+    shard.arbitration.request(clock, sender(shard, send));
+}
+
+void ShardedPool::release(int shard_index, int clock, const Send &send)
+{
+    auto unit = std::find_if(held.begin(), held.end(),
+                             [this, shard_index](int position) { return shards[position].index == shard_index; });
+    if (unit == held.end())
+    {
+        return;
+    }
+    Shard &shard = shards[*unit];
+    held.erase(unit);
+    shard.arbitration.release(clock, sender(shard, send));
+    // The released shard has room for the request waiting on the share of the thief
+    if (postponed)
+    {
+        request(clock, send);
+    }
+}
+
+void ShardedPool::withdraw(int clock, const Send &send)
+{
+    if (postponed)
+    {
+        postponed = false;
+        return;
+    }
+    Shard &shard = shards[pending];
+    pending = -1;
+    shard.arbitration.withdraw(clock, sender(shard, send));
+}
+
+void ShardedPool::receive(const utils::message_t &message, int shard, int &clock, const Send &send)
+{
+    Shard *subscribed = find(shard);
+    int local = subscribed != nullptr ? localId(*subscribed, message.data.id) : -1;
+    if (local < 0)
+    {
+        return;
+    }
+    utils::message_t translated = message;
+    translated.data.id = local;
+    subscribed->arbitration.receive(translated, clock, sender(*subscribed, send));
+}
+
+void ShardedPool::receiveFinish(int thief_id)
+{
+    for (Shard &shard : shards)
+    {
+        int local = localId(shard, thief_id);
+        if (local >= 0)
+        {
+            shard.arbitration.receiveFinish(local);
+        }
+    }
+}
+
+bool ShardedPool::canEnter() const
+{
+    return pending >= 0 && shards[pending].arbitration.canEnter();
+}
+
+int ShardedPool::enter()
+{
+    shards[pending].arbitration.enter();
+    held.push_back(pending);
+    pending = -1;
+    return shards[held.back()].index;
+}
+
+int ShardedPool::queueDepth() const
+{
+    int depth = 0;
+    for (const Shard &shard : shards)
+    {
+        depth += shard.arbitration.queueDepth();
+    }
+    return depth;
+}
+
+} // namespace mood_thieves
@@ -0,0 +1,333 @@
+#include "mood_thieves/simulator.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace mood_thieves
+{
+
+Simulator::Simulator(const Config &config)
+    : config(config), size(config.thieves), random(config.seed)
+{
+    int capacities[2] = {config.weapons, config.laboratories};
+    int max_held[2] = {max_weapons_held(config), 1};
+    for (int resource = 0; resource < 2; resource++)
+    {
+        in_use[resource].assign(config.shards, 0);
+    }
+    thieves.reserve(size);
+    for (int id = 0; id < size; id++)
+    {
+        thieves.emplace_back(config, id);
+        for (int resource = 0; resource < 2; resource++)
+        {
+            thieves[id].pools.emplace_back(config.protocol, id, size, capacities[resource], max_held[resource],
+                                           config.ack_horizon, config.shards);
+        }
+        schedule(0, START, id);
+    }
+}
+
+namespace
+{
+
+/**
+ * @return The first slot to probe for a key in a table of a power-of-two size.
+ */
+size_t first_slot(uint64_t key, size_t slots)
+{
+    uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+    return (hash ^ (hash >> 32)) & (slots - 1);
+}
+
+} // namespace
+
+int64_t &Simulator::ChannelTable::operator[](uint64_t channel)
+{
+    if ((used + 1) * 2 > keys.size())
+    {
+        std::vector<uint64_t> old_keys(std::max<size_t>(64, keys.size() * 2), 0);
+        std::vector<int64_t> old_values(old_keys.size(), 0);
+        old_keys.swap(keys);
+        old_values.swap(values);
+        for (size_t slot = 0; slot < old_keys.size(); slot++)
+        {
+            if (old_keys[slot] != 0)
+            {
+                size_t position = first_slot(old_keys[slot], keys.size());
+                while (keys[position] != 0)
+                {
+                    position = (position + 1) & (keys.size() - 1);
+                }
+                keys[position] = old_keys[slot];
+                values[position] = old_values[slot];
+            }
+        }
+    }
+    uint64_t key = channel + 1;
+    size_t position = first_slot(key, keys.size());
+    while (keys[position] != key && keys[position] != 0)
+    {
+        position = (position + 1) & (keys.size() - 1);
+    }
+    if (keys[position] == 0)
+    {
+        keys[position] = key;
+        used++;
+    }
+    return values[position];
+}
+
+void Simulator::schedule(int64_t time, EventKind kind, int thief, const utils::message_t &message)
+{
+    agenda.push({time, sequence++, kind, thief, message});
+}
+
+int64_t Simulator::latency()
+{
+    double latency_us = config.latency.first_us;
+    switch (config.latency.distribution)
+    {
+    case LatencyDistribution::CONSTANT:
+        break;
+    case LatencyDistribution::UNIFORM:
+        latency_us = std::uniform_real_distribution<double>(config.latency.first_us, config.latency.second_us)(random);
+        break;
+    case LatencyDistribution::EXPONENTIAL:
+        if (config.latency.second_us > 0)
+        {
+            latency_us += std::exponential_distribution<double>(1.0 / config.latency.second_us)(random);
+        }
+        break;
+    case LatencyDistribution::LOGNORMAL:
+        latency_us =
+            std::lognormal_distribution<double>(std::log(config.latency.first_us), config.latency.second_us)(random);
+        break;
+    }
+    return std::llround(latency_us * 1000.0);
+}
+
+void Simulator::send(int from, int to, int message_type, int clock, int resource_type, int value)
+{
+    metrics.countSent(message_type);
+    int64_t arrival = now + latency();
+    // Channels are FIFO like MPI between a pair of ranks, a constant latency keeps the order by itself
+    if (config.latency.distribution != LatencyDistribution::CONSTANT)
+    {
+        int64_t &last = channel_last[static_cast<uint64_t>(from) * size + to];
+        last = std::max(last, arrival);
+        arrival = last;
+    }
+    schedule(arrival, DELIVER, to, {message_type, {from, clock, resource_type, value}});
+}
+
+void Simulator::request(int id, int resource_type)
+{
+    Thief &thief = thieves[id];
+    thief.waiting = resource_type;
+    thief.request_time[resource_type] = now;
+    thief.pools[resource_type].request(thief.clock, sender(id, resource_type));
+    if (canEnter(id, resource_type))
+    {
+        enter(id, resource_type);
+    }
+}
+
+void Simulator::release(int id, int resource_type, int shard)
+{
+    Thief &thief = thieves[id];
+    in_use[resource_type][shard]--;
+    thief.pools[resource_type].release(shard, thief.clock, sender(id, resource_type));
+    if (canEnter(id, resource_type))
+    {
+        enter(id, resource_type);
+    }
+}
+
+ShardedPool::Send Simulator::sender(int id, int resource_type)
+{
+    return [this, id, resource_type](int thief_id, int message_type, int clock, int shard, int value)
+    { send(id, thief_id, message_type, clock, utils::shard_resource(resource_type, shard), value); };
+}
+
+bool Simulator::canEnter(int id, int resource_type) const
+{
+    const Thief &thief = thieves[id];
+    return thief.waiting == resource_type && thief.pools[resource_type].canEnter();
+}
+
+void Simulator::enter(int id, int resource_type)
+{
+    Thief &thief = thieves[id];
+    bool weapon = resource_type == utils::ResourceType::WEAPON;
+    metrics.record(weapon ? Metrics::ACQUIRE_WEAPON : Metrics::ACQUIRE_LABORATORY,
+                   now - thief.request_time[resource_type]);
+    int shard = thief.pools[resource_type].enter();
+    thief.taken_shards[resource_type] = shard;
+    thief.waiting = -1;
+    int capacity = weapon ? config.weapons : config.laboratories;
+    if (++in_use[resource_type][shard] > ShardedPool::shardCapacity(capacity, config.shards, shard))
+    {
+        violations++;
+    }
+
+    if (weapon)
+    {
+        int roam_us = thief.workload.roamUs();
+        int lead_us = std::min(config.lab_lead_us, roam_us);
+        if (lead_us > 0)
+        {
+            schedule(now + (roam_us - lead_us) * int64_t{1000}, LEAD, id);
+        }
+        thief.roaming = true;
+        schedule(now + roam_us * int64_t{1000}, ROAMED, id);
+    }
+    else if (thief.roaming)
+    {
+        // Taken during the roam, the work starts once the roam ends
+        thief.lab_granted = true;
+    }
+    else
+    {
+        thief.entries++;
+        schedule(now + thief.workload.laboratoryUs() * int64_t{1000}, WORKED, id);
+    }
+}
+
+void Simulator::roamed(int id)
+{
+    Thief &thief = thieves[id];
+    thief.roaming = false;
+    bool requested = config.lab_lead_us > 0;
+    if (!thief.workload.findsVictim())
+    {
+        ShardedPool &laboratories = thief.pools[utils::ResourceType::LABORATORY];
+        thief.clock++;
+        if (thief.lab_granted)
+        {
+            thief.lab_granted = false;
+            in_use[utils::ResourceType::LABORATORY][thief.taken_shards[utils::ResourceType::LABORATORY]]--;
+            laboratories.release(thief.taken_shards[utils::ResourceType::LABORATORY], thief.clock,
+                                 sender(id, utils::ResourceType::LABORATORY));
+        }
+        else if (requested)
+        {
+            thief.waiting = -1;
+            laboratories.withdraw(thief.clock, sender(id, utils::ResourceType::LABORATORY));
+        }
+        // The unused weapon goes back without recharging
+        release(id, utils::ResourceType::WEAPON, thief.taken_shards[utils::ResourceType::WEAPON]);
+        if (config.duration_ms > 0 && now >= config.duration_ms * int64_t{1000000})
+        {
+            return;
+        }
+        thief.clock++;
+        request(id, utils::ResourceType::WEAPON);
+        return;
+    }
+    if (thief.lab_granted)
+    {
+        thief.lab_granted = false;
+        thief.entries++;
+        schedule(now + thief.workload.laboratoryUs() * int64_t{1000}, WORKED, id);
+    }
+    else if (!requested)
+    {
+        thief.clock++;
+        request(id, utils::ResourceType::LABORATORY);
+    }
+}
+
+void Simulator::handle(int id, const utils::message_t &message)
+{
+    Thief &thief = thieves[id];
+    const utils::message_data_t &data = message.data;
+    thief.clock = std::max(thief.clock, data.clock) + 1;
+    metrics.countReceived(message.type);
+    int resource_type = utils::resource_of(data.resource_type);
+    if (resource_type != utils::ResourceType::WEAPON && resource_type != utils::ResourceType::LABORATORY)
+    {
+        return;
+    }
+    if (message.type == utils::MessageType::ACK)
+    {
+        metrics.record(Metrics::ACK_RTT, now - thief.request_time[resource_type]);
+    }
+
+    ShardedPool &pool = thief.pools[resource_type];
+    pool.receive(message, utils::shard_of(data.resource_type), thief.clock, sender(id, resource_type));
+    if (message.type == utils::MessageType::REQUEST)
+    {
+        metrics.record(resource_type == utils::ResourceType::WEAPON ? Metrics::QUEUE_WEAPON
+                                                                    : Metrics::QUEUE_LABORATORY,
+                       pool.queueDepth());
+    }
+
+    if (canEnter(id, resource_type))
+    {
+        enter(id, resource_type);
+    }
+}
+
+void Simulator::run()
+{
+    int64_t end_ns = config.duration_ms * int64_t{1000000};
+    while (!agenda.empty())
+    {
+        Event event = agenda.top();
+        agenda.pop();
+        now = event.time;
+        events++;
+        Thief &thief = thieves[event.thief];
+        switch (event.kind)
+        {
+        case DELIVER:
+            // The receiver handles one message at a time, in the order they arrive
+            if (thief.receiver_free > now)
+            {
+                schedule(thief.receiver_free, HANDLE, event.thief, event.message);
+                thief.receiver_free += config.handle_ns;
+                break;
+            }
+            thief.receiver_free = now + config.handle_ns;
+            handle(event.thief, event.message);
+            break;
+        case HANDLE:
+            handle(event.thief, event.message);
+            break;
+        case START:
+            thief.clock++;
+            request(event.thief, utils::ResourceType::WEAPON);
+            break;
+        case LEAD:
+            thief.clock++;
+            request(event.thief, utils::ResourceType::LABORATORY);
+            break;
+        case ROAMED:
+            roamed(event.thief);
+            break;
+        case WORKED:
+        {
+            thief.clock++;
+            release(event.thief, utils::ResourceType::LABORATORY, thief.taken_shards[utils::ResourceType::LABORATORY]);
+            // Recharges end in any order, every one releases the weapon it recharged
+            int shard = thief.taken_shards[utils::ResourceType::WEAPON];
+            schedule(now + thief.workload.rechargeUs() * int64_t{1000}, RECHARGED, event.thief,
+                     {utils::MessageType::RELEASE,
+                      {event.thief, 0, utils::shard_resource(utils::ResourceType::WEAPON, shard), 0}});
+            if ((config.entries > 0 && thief.entries >= config.entries) || (end_ns > 0 && now >= end_ns))
+            {
+                break;
+            }
+            thief.clock++;
+            request(event.thief, utils::ResourceType::WEAPON);
+            break;
+        }
+        case RECHARGED:
+            thief.clock++;
+            release(event.thief, utils::ResourceType::WEAPON, utils::shard_of(event.message.data.resource_type));
+            break;
+        }
+    }
+}
+
+} // namespace mood_thieves
@@ -0,0 +1,165 @@
+#include "mood_thieves/suzuki_kasami.hpp"
+#include <algorithm>
+
+namespace mood_thieves
+{
+
+SuzukiKasami::SuzukiKasami(int id, int size, int tokens)
+    : id(id), size(size), request_numbers(size, 0), served(size, 0), finished(size, false), told(size, 0)
+{
+    for (int token = id; token < tokens; token += size)
+    {
+        idle++;
+    }
+}
+
+bool SuzukiKasami::request()
+{
+    requesting = true;
+    if (idle > 0)
+    {
+        reserved = true;
+        return false;
+    }
+    // The request waits in the queue of the thief itself behind the requests it already saw
+    request_numbers[id]++;
+    queue.push_back(id);
+    return true;
+}
+
+int SuzukiKasami::passIdle()
+{
+    while (idle - (reserved ? 1 : 0) > 0 && !queue.empty())
+    {
+        int thief_id = queue.front();
+        queue.pop_front();
+        if (thief_id == id)
+        {
+            // The pending request of the thief is the oldest one, a token stays for it
+            reserved = true;
+            continue;
+        }
+        if (finished[thief_id] || served[thief_id] >= request_numbers[thief_id])
+        {
+            continue;
+        }
+        serve(thief_id, request_numbers[thief_id]);
+        idle--;
+        return thief_id;
+    }
+    return -1;
+}
+
+void SuzukiKasami::serve(int thief_id, int request_number)
+{
+    served[thief_id] = request_number;
+    if (latest % size != thief_id)
+    {
+        previous = latest;
+    }
+    latest = request_number * size + thief_id;
+    recent.push_back(latest);
+    learned++;
+    if (static_cast<int>(recent.size()) > size)
+    {
+        recent.pop_front();
+    }
+}
+
+void SuzukiKasami::learn(int news)
+{
+    if (news >= 0 && news / size > served[news % size])
+    {
+        serve(news % size, news / size);
+    }
+}
+
+int SuzukiKasami::receiveRequest(int thief_id, int news)
+{
+    // Channels are FIFO and every request goes to every thief, so counting them numbers them
+    int request_number = request_numbers[thief_id] + 1;
+    learn(news);
+    // A thief only requests again once served, an entry left by its previous request goes to the back
+    std::deque<int>::iterator entry = std::find(queue.begin(), queue.end(), thief_id);
+    if (entry != queue.end())
+    {
+        queue.erase(entry);
+    }
+    served[thief_id] = std::max(served[thief_id], request_number - 1);
+    request_numbers[thief_id] = request_number;
+    queue.push_back(thief_id);
+    return passIdle();
+}
+
+int SuzukiKasami::receiveToken(int news)
+{
+    learn(news);
+    idle++;
+    // A token reaching a waiting thief serves it, whichever request it was passed for
+    if (requesting && !reserved)
+    {
+        reserved = true;
+        return -1;
+    }
+    return passIdle();
+}
+
+int SuzukiKasami::news(int thief_id) const
+{
+    return latest >= 0 && latest % size != thief_id ? latest : previous;
+}
+
+void SuzukiKasami::receiveServed(int news)
+{
+    learn(news);
+}
+
+std::vector<int> SuzukiKasami::takeNews(int thief_id)
+{
+    std::vector<int> news;
+    uint64_t first = std::max(told[thief_id], learned - recent.size());
+    for (uint64_t index = first; index < learned; index++)
+    {
+        int request = recent[index - (learned - recent.size())];
+        // The thief knows best about its own requests
+        if (request % size != thief_id)
+        {
+            news.push_back(request);
+        }
+    }
+    told[thief_id] = learned;
+    return news;
+}
+
+void SuzukiKasami::receiveFinish(int thief_id)
+{
+    finished[thief_id] = true;
+    queue.erase(std::remove(queue.begin(), queue.end(), thief_id), queue.end());
+}
+
+bool SuzukiKasami::canEnter() const
+{
+    return reserved;
+}
+
+void SuzukiKasami::enter()
+{
+    queue.erase(std::remove(queue.begin(), queue.end(), id), queue.end());
+    requesting = false;
+    reserved = false;
+    idle--;
+    held++;
+}
+
+int SuzukiKasami::release()
+{
+    if (held == 0)
+    {
+        return -1;
+    }
+    held--;
+    idle++;
+    return passIdle();
+}
+
+} // namespace mood_thieves
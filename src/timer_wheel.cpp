@@ -0,0 +1,146 @@
+#include "mood_thieves/timer_wheel.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace mood_thieves
+{
+
+TimerWheel::TimerWheel(std::chrono::microseconds tick) : tick(tick), start(Clock::now())
+{
+    thread = std::thread(&TimerWheel::run, this);
+}
+
+TimerWheel::~TimerWheel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wakeup.notify_one();
+    thread.join();
+}
+
+void TimerWheel::schedule(std::chrono::microseconds delay, Callback callback)
+{
+    // Round up to the first tick at or after the deadline, so a timer never runs early
+    Clock::duration deadline = Clock::now() - start + std::max(delay, std::chrono::microseconds(0));
+    uint64_t expiry = (deadline + tick - Clock::duration(1)) / tick;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0)
+    {
+        // Nothing is pending, the wheel can skip the ticks the thread slept through
+        current = std::max(current, elapsedTicks());
+    }
+    expiry = std::max(expiry, current + 1);
+    bool earlier = count == 0 || expiry < nextWakeup();
+    insert({expiry, std::move(callback)});
+    count++;
+    if (earlier)
+    {
+        wakeup.notify_one();
+    }
+}
+
+size_t TimerWheel::pending()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return count;
+}
+
+void TimerWheel::insert(Timer &&timer)
+{
+    uint64_t delta = timer.expiry > current ? timer.expiry - current : 0;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t{1} << (LEVEL_BITS * (level + 1))))
+    {
+        level++;
+    }
+    // Timers beyond the span of the wheel wait in the top level and are placed again on every cascade
+    uint64_t last_tick = current + (uint64_t{1} << (LEVEL_BITS * LEVELS)) - 1;
+    uint64_t slot_tick = std::min(std::max(timer.expiry, current), last_tick);
+    wheels[level][(slot_tick >> (LEVEL_BITS * level)) & (SLOTS - 1)].push_back(std::move(timer));
+}
+
+void TimerWheel::advance(std::vector<Timer> &expired)
+{
+    current++;
+    // Cascade from the top, a timer moved down may land in the slot of a lower level cascading in this tick
+    for (int level = LEVELS - 1; level > 0; level--)
+    {
+        if ((current & ((uint64_t{1} << (LEVEL_BITS * level)) - 1)) != 0)
+        {
+            continue;
+        }
+        std::vector<Timer> timers = std::move(wheels[level][(current >> (LEVEL_BITS * level)) & (SLOTS - 1)]);
+        wheels[level][(current >> (LEVEL_BITS * level)) & (SLOTS - 1)].clear();
+        for (Timer &timer : timers)
+        {
+            insert(std::move(timer));
+        }
+    }
+
+    std::vector<Timer> &slot = wheels[0][current & (SLOTS - 1)];
+    count -= slot.size();
+    std::move(slot.begin(), slot.end(), std::back_inserter(expired));
+    slot.clear();
+}
+
+uint64_t TimerWheel::nextWakeup() const
+{
+    if (count == 0)
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    uint64_t cascade = (current | (SLOTS - 1)) + 1;
+    for (uint64_t next = current + 1; next < cascade; next++)
+    {
+        if (!wheels[0][next & (SLOTS - 1)].empty())
+        {
+            return next;
+        }
+    }
+    return cascade;
+}
+
+uint64_t TimerWheel::elapsedTicks() const
+{
+    return (Clock::now() - start) / tick;
+}
+
+void TimerWheel::run()
+{
+    std::vector<Timer> expired;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stop)
+    {
+        if (count == 0)
+        {
+            wakeup.wait(lock);
+            continue;
+        }
+        uint64_t next = nextWakeup();
+        if (elapsedTicks() < next)
+        {
+            wakeup.wait_until(lock, start + tick * next);
+            continue;
+        }
+
+        uint64_t now = elapsedTicks();
+        while (current < now && count > 0)
+        {
+            advance(expired);
+        }
+
+        // Callbacks may schedule new timers
+        lock.unlock();
+        for (Timer &timer : expired)
+        {
+            timer.callback();
+        }
+        expired.clear();
+        lock.lock();
+    }
+}
+
+} // namespace mood_thieves
@@ -0,0 +1,200 @@
+#include "mood_thieves/trace.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+namespace mood_thieves
+{
+namespace trace
+{
+
+namespace
+{
+
+const uint64_t RING_CAPACITY = 1 << 13;
+
+/**
+ * Single producer single consumer ring of a thread, the thread writes and the flushing thread reads.
+ */
+struct Ring
+{
+    std::array<Record, RING_CAPACITY> records;
+    alignas(64) std::atomic<uint64_t> head{0}; ///< The next record to write, owned by the thread.
+    alignas(64) std::atomic<uint64_t> tail{0}; ///< The next record to flush, owned by the flushing thread.
+    std::atomic<uint64_t> dropped{0};           ///< Records dropped because the ring was full.
+    uint16_t thread = 0;                        ///< Index of the thread within the rank.
+};
+
+std::mutex rings_mutex;                   ///< Mutex protecting the list of rings.
+std::vector<std::unique_ptr<Ring>> rings; ///< The ring of every thread that recorded an event.
+FILE *file = nullptr;                     ///< The per-rank trace file.
+std::atomic<bool> opened{false};          ///< Whether the trace file is open.
+
+std::mutex flusher_mutex;               ///< Mutex protecting the stop flag of the flushing thread.
+std::condition_variable flusher_wakeup; ///< Wakes the flushing thread up to stop.
+bool stopping = false;                  ///< Whether the flushing thread should end.
+std::thread flusher;                    ///< The thread writing the rings to the file.
+
+thread_local Ring *local_ring = nullptr;
+thread_local Role local_role = UNNAMED;
+
+uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * Appends a record to a ring, drops it if the ring is full.
+ */
+void push(Ring &ring, const Record &record)
+{
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == RING_CAPACITY)
+    {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring.records[head & (RING_CAPACITY - 1)] = record;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+/**
+ * Creates the ring of the calling thread and records its role.
+ */
+Ring &register_thread()
+{
+    std::unique_ptr<Ring> ring = std::make_unique<Ring>();
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        ring->thread = rings.size();
+        local_ring = ring.get();
+        rings.push_back(std::move(ring));
+    }
+    push(*local_ring, {now_ns(), 0, 0, -1, local_ring->thread, THREAD_NAME, 255, local_role, 0});
+    return *local_ring;
+}
+
+/**
+ * Writes all records of all rings to the file.
+ */
+void drain()
+{
+    std::vector<Ring *> current;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        for (auto &ring : rings)
+        {
+            current.push_back(ring.get());
+        }
+    }
+    for (Ring *ring : current)
+    {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        while (tail < head)
+        {
+            uint64_t index = tail & (RING_CAPACITY - 1);
+            uint64_t count = std::min(head - tail, RING_CAPACITY - index);
+            fwrite(&ring->records[index], sizeof(Record), count, file);
+            tail += count;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+    fflush(file);
+}
+
+void flush_loop()
+{
+    std::unique_lock<std::mutex> lock(flusher_mutex);
+    while (!stopping)
+    {
+        flusher_wakeup.wait_for(lock, std::chrono::milliseconds(10));
+        drain();
+    }
+}
+
+} // namespace
+
+int open(const std::string &prefix, int rank)
+{
+    std::string path = prefix + "." + std::to_string(rank) + ".trace";
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "[ERROR]: Cannot open trace file %s\n", path.c_str());
+        return -1;
+    }
+
+    int64_t system_offset_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::system_clock::now().time_since_epoch())
+                                   .count() -
+                               now_ns();
+    FileHeader header = {{'M', 'T', 'T', 'R'}, VERSION, rank, sizeof(Record), system_offset_ns};
+    fwrite(&header, sizeof(header), 1, file);
+
+    stopping = false;
+    flusher = std::thread(flush_loop);
+    opened.store(true);
+    enabled.store(true);
+    return 0;
+}
+
+void close()
+{
+    if (!opened.load())
+    {
+        return;
+    }
+    enabled.store(false);
+    opened.store(false);
+    {
+        std::lock_guard<std::mutex> lock(flusher_mutex);
+        stopping = true;
+    }
+    flusher_wakeup.notify_one();
+    flusher.join();
+    drain();
+
+    uint64_t dropped = 0;
+    for (auto &ring : rings)
+    {
+        dropped += ring->dropped.load();
+    }
+    if (dropped > 0)
+    {
+        fprintf(stderr, "[WARNING]: %lu trace records dropped, the rings were full\n",
+                static_cast<unsigned long>(dropped));
+    }
+    fclose(file);
+    file = nullptr;
+}
+
+void toggle()
+{
+    if (opened.load())
+    {
+        enabled.store(!enabled.load());
+    }
+}
+
+void set_thread_role(Role role)
+{
+    local_role = role;
+}
+
+void write(Kind kind, int clock, int peer, int resource, int message_type, int message_clock, int unit)
+{
+    Ring &ring = local_ring != nullptr ? *local_ring : register_thread();
+    push(ring, {now_ns(), clock, message_clock, static_cast<int16_t>(peer), ring.thread, kind,
+                static_cast<uint8_t>(resource), static_cast<uint8_t>(message_type), static_cast<uint8_t>(unit)});
+}
+
+} // namespace trace
+} // namespace mood_thieves
@@ -0,0 +1,125 @@
+#include "mood_thieves/transport.hpp"
+#include "mood_thieves/in_process_transport.hpp"
+
+namespace mood_thieves
+{
+
+MpiTransport::MpiTransport(MPI_Datatype batch_type, MPI_Comm comm, int size, const Config &config)
+    : batch_type(batch_type), comm(comm), batcher(batch_type, comm, size, config.batch_size, config.batch_delay_us),
+      own(std::make_unique<Mailbox>())
+{
+    MPI_Comm_rank(comm, &rank);
+    // Pre-posted receives would take the messages MPI_Iprobe looks for
+    if (config.receive_policy == ReceivePolicy::SPIN)
+    {
+        messages.resize(config.batch_size);
+    }
+    else
+    {
+        engine = std::make_unique<ReceiveEngine>(batch_type, comm, config.receive_slots, config.batch_size);
+    }
+}
+
+MpiTransport::~MpiTransport() = default;
+
+void MpiTransport::post(int thief_id, const utils::message_t &message, bool urgent)
+{
+    if (thief_id != rank)
+    {
+        batcher.post(thief_id, message, urgent);
+        return;
+    }
+    own->push(message);
+    unblock();
+}
+
+void MpiTransport::wake()
+{
+    woken.store(true);
+    unblock();
+}
+
+void MpiTransport::unblock()
+{
+    // Either the receiver sees the message or the wake before it blocks or the poster sees it blocked
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (blocked.exchange(false))
+    {
+        MPI_Send(nullptr, 0, batch_type, rank, utils::BATCH_TAG, comm);
+    }
+}
+
+void MpiTransport::flushExpired()
+{
+    batcher.flushExpired();
+}
+
+void MpiTransport::flushAll()
+{
+    batcher.flushAll();
+}
+
+int MpiTransport::pollOwn(const Handler &handler)
+{
+    int handled = 0;
+    utils::message_t message;
+    while (own->pop(message))
+    {
+        handler(message);
+        handled++;
+    }
+    return handled;
+}
+
+int MpiTransport::poll(const Handler &handler)
+{
+    return pollOwn(handler) + pollMpi(handler);
+}
+
+int MpiTransport::pollMpi(const Handler &handler)
+{
+    if (engine)
+    {
+        return engine->poll(handler);
+    }
+
+    MPI_Status status;
+    int message_available = 0;
+    MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &message_available, &status);
+    if (!message_available)
+    {
+        return 0;
+    }
+    int count = 0;
+    MPI_Recv(messages.data(), messages.size(), batch_type, MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &status);
+    MPI_Get_count(&status, batch_type, &count);
+    for (int i = 0; i < count; i++)
+    {
+        handler(utils::unpack(messages[i]));
+    }
+    return count;
+}
+
+int MpiTransport::wait(const Handler &handler)
+{
+    blocked.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int handled = pollOwn(handler);
+    if (handled == 0 && !woken.exchange(false))
+    {
+        if (engine)
+        {
+            handled = engine->wait(handler);
+        }
+        else
+        {
+            MPI_Status status;
+            MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &status);
+            handled = pollMpi(handler);
+        }
+    }
+    blocked.store(false);
+    return handled + pollOwn(handler);
+}
+
+} // namespace mood_thieves
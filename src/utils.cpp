@@ -1,4 +1,8 @@
 #include "mood_thieves/utils.hpp"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 
 namespace mood_thieves
 {
@@ -29,22 +33,71 @@ int check_thread_support(int provided)
     return 0;
 }
 
+double process_cpu_time()
+{
+    timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+double thread_cpu_time(pthread_t thread)
+{
+    clockid_t clock_id;
+    timespec time;
+    pthread_getcpuclockid(thread, &clock_id);
+    clock_gettime(clock_id, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "The doorbell counter is a futex word");
+
+void Doorbell::ring()
+{
+    count.fetch_add(1, std::memory_order_seq_cst);
+    // Either the sleeper sees the new count before it sleeps or the ringer sees it sleeping
+    if (sleeping.load(std::memory_order_seq_cst))
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&count), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+}
+
+void Doorbell::sleep(uint32_t seen, std::chrono::microseconds timeout)
+{
+    sleeping.store(true, std::memory_order_seq_cst);
+    if (count.load(std::memory_order_seq_cst) == seen)
+    {
+        timespec relative = {static_cast<time_t>(timeout.count() / 1000000),
+                             static_cast<long>(timeout.count() % 1000000 * 1000)};
+        // Returns right away if the count changed in between, or with EINTR, both only cut the sleep short
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&count), FUTEX_WAIT_PRIVATE, seen, &relative, nullptr, 0);
+    }
+    sleeping.store(false, std::memory_order_relaxed);
+}
+
 void initialize_message_type(MPI_Datatype &MPI_PAKIET_T)
 {
-    const int nitems = 3;
-    int blocklengths[nitems] = {1, 1, 1};
-    MPI_Datatype typy[nitems] = {MPI_INT, MPI_INT, MPI_INT};
+    const int nitems = 4;
+    int blocklengths[nitems] = {1, 1, 1, 1};
+    MPI_Datatype typy[nitems] = {MPI_INT, MPI_INT, MPI_INT, MPI_INT};
     MPI_Aint offsets[nitems];
 
     // Set the offsets for each field
-    offsets[0] = offsetof(LamportClock, clock);
-    offsets[1] = offsetof(LamportClock, id);
+    offsets[0] = offsetof(message_data_t, id);
+    offsets[1] = offsetof(message_data_t, clock);
     offsets[2] = offsetof(message_data_t, resource_type);
+    offsets[3] = offsetof(message_data_t, value);
 
     MPI_Type_create_struct(nitems, blocklengths, offsets, typy, &MPI_PAKIET_T);
     MPI_Type_commit(&MPI_PAKIET_T);
 }
 
+void initialize_batch_type(MPI_Datatype &batch_type)
+{
+    // The entries are contiguous without padding, so a batch goes out as a single block
+    MPI_Type_contiguous(sizeof(wire_message_t) / sizeof(uint32_t), MPI_UINT32_T, &batch_type);
+    MPI_Type_commit(&batch_type);
+}
+
 void free_message_type(MPI_Datatype &MPI_PAKIET_T) { MPI_Type_free(&MPI_PAKIET_T); }
 
 } // namespace utils
@@ -0,0 +1,70 @@
+#include "mood_thieves/workload.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace mood_thieves
+{
+
+Workload::Workload(const Config &config, int id)
+    : random(static_cast<uint64_t>(config.seed) << 32 | static_cast<uint32_t>(id)),
+      phases{{config.weapon_time, config.weapon_us},
+             {config.laboratory_time, config.laboratory_us},
+             {config.recharge_time, config.recharge_us}},
+      victim_probability(config.victim_probability)
+{
+    for (Phase &phase : phases)
+    {
+        if (!phase.time.samples_us.empty())
+        {
+            phase.next = std::uniform_int_distribution<size_t>(0, phase.time.samples_us.size() - 1)(random);
+        }
+    }
+}
+
+bool Workload::findsVictim()
+{
+    // A certain victim draws nothing, the durations stay the same with and without the option
+    return victim_probability >= 1 || std::bernoulli_distribution(victim_probability)(random);
+}
+
+int Workload::draw(Phase &phase)
+{
+    double mean = phase.mean_us;
+    double duration_us = mean;
+    switch (phase.time.distribution)
+    {
+    case PhaseDistribution::CONSTANT:
+        return phase.mean_us;
+    case PhaseDistribution::EXPONENTIAL:
+        if (mean > 0)
+        {
+            duration_us = std::exponential_distribution<double>(1.0 / mean)(random);
+        }
+        break;
+    case PhaseDistribution::LOGNORMAL:
+        if (mean > 0)
+        {
+            double sigma = phase.time.shape;
+            duration_us = std::lognormal_distribution<double>(std::log(mean) - sigma * sigma / 2, sigma)(random);
+        }
+        break;
+    case PhaseDistribution::PARETO:
+    {
+        double alpha = phase.time.shape;
+        double scale = mean * (alpha - 1) / alpha;
+        duration_us = scale / std::pow(1.0 - std::uniform_real_distribution<double>(0, 1)(random), 1.0 / alpha);
+        break;
+    }
+    case PhaseDistribution::TRACE:
+    {
+        int sample = phase.time.samples_us[phase.next];
+        phase.next = (phase.next + 1) % phase.time.samples_us.size();
+        return sample;
+    }
+    }
+    // The tail of a Pareto phase may reach beyond any clock
+    return static_cast<int>(std::llround(std::min(duration_us, static_cast<double>(INT_MAX))));
+}
+
+} // namespace mood_thieves
@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/maekawa.hpp"
+#include "mood_thieves/simulator.hpp"
+
+/**
+ * Predicts the laboratory throughput, the utilization of the pools and the waiting times of the thieves with
+ * mean-value analysis, without running them.
+ *
+ * A thief cycles through a closed network: it waits for a weapon, roams, waits for a laboratory and works in it,
+ * a weapon stays taken from its grant through the recharge. Every pool is a multi-server station seen by the
+ * thieves as a finite population (the machine repairman model), solved exactly by load-dependent MVA. Its think
+ * time is the rest of the cycle, so the two pools are solved in turn until their waiting times settle. A thief
+ * requests its next weapon while the last one recharges: when a weapon is held longer than a cycle, every thief
+ * counts as that many sources of requests to the weapon pool.
+ *
+ * Every acquisition adds the arbitration latency: a round trip of the mean message latency, each message
+ * queueing at a receiver busy --handle-ns per message with the messages of all acquisitions, 3(K - 1) per
+ * acquisition under the broadcast protocol, 2(K - 1) under Ricart-Agrawala, 3(q - 1) for a quorum of q under
+ * Maekawa and 2K under Suzuki-Kasami, a REQUEST to everyone and the SERVED messages ahead of a token. The model
+ * uses the means of the phase durations only.
+ *
+ * Takes the options of main, --thieves is K. With --entries the configuration is also simulated and the
+ * measured values are printed next to the predicted ones. With --bench=bench.csv every row of a bench run is
+ * predicted instead and printed next to its measured throughput and median acquisition latencies, the options
+ * given set the latency and the handling time of the model.
+ *
+ * Usage: capacity_model --thieves=64 --weapons=8 --laboratories=4 [--entries=100] [--name=value ...]
+ *        capacity_model --bench=bench.csv [--latency=const:50] [--handle-ns=0]
+ */
+
+namespace
+{
+
+using mood_thieves::Config;
+using mood_thieves::Protocol;
+
+struct Prediction
+{
+    double throughput = 0;           ///< Laboratory entries per second of all thieves.
+    double cycle_us = 0;             ///< Mean time of a thief from one weapon request to the next.
+    double weapon_wait_us = 0;       ///< Mean time a weapon request queues for a free weapon.
+    double laboratory_wait_us = 0;   ///< Mean time a laboratory request queues for a free laboratory.
+    double arbitration_us = 0;       ///< Mean arbitration latency added to every acquisition.
+    double weapon_utilization = 0;   ///< Share of the weapons taken.
+    double lab_utilization = 0;      ///< Share of the laboratories taken.
+    double receiver_utilization = 0; ///< Share of the time a receiver handles messages.
+};
+
+/**
+ * Solves the machine repairman model by exact load-dependent MVA.
+ *
+ * @param sources The number of sources.
+ * @param servers The number of servers.
+ * @param service_us The mean service time.
+ * @param think_us The mean time a source spends away from the station.
+ *
+ * @return The mean time a request queues before its service starts.
+ */
+double repairman_wait(int sources, int servers, double service_us, double think_us)
+{
+    if (service_us <= 0 || sources <= servers)
+    {
+        return 0;
+    }
+    // Probabilities of j requests at the station with n sources, from those with n - 1
+    std::vector<double> probability(sources + 1, 0);
+    probability[0] = 1;
+    double response_us = service_us;
+    for (int n = 1; n <= sources; n++)
+    {
+        response_us = 0;
+        for (int j = 1; j <= n; j++)
+        {
+            response_us += j * service_us / std::min(j, servers) * probability[j - 1];
+        }
+        double throughput = n / (think_us + response_us);
+        double busy = 0;
+        for (int j = n; j >= 1; j--)
+        {
+            probability[j] = throughput * service_us / std::min(j, servers) * probability[j - 1];
+            busy += probability[j];
+        }
+        probability[0] = std::max(0.0, 1 - busy);
+    }
+    return std::max(0.0, response_us - service_us);
+}
+
+/**
+ * @return The mean of the configured message latency in microseconds.
+ */
+double mean_latency_us(const mood_thieves::Latency &latency)
+{
+    switch (latency.distribution)
+    {
+    case mood_thieves::LatencyDistribution::UNIFORM:
+        return (latency.first_us + latency.second_us) / 2;
+    case mood_thieves::LatencyDistribution::EXPONENTIAL:
+        return latency.first_us + latency.second_us;
+    case mood_thieves::LatencyDistribution::LOGNORMAL:
+        return latency.first_us * std::exp(latency.second_us * latency.second_us / 2);
+    default:
+        return latency.first_us;
+    }
+}
+
+/**
+ * @return The messages all thieves send for one acquisition.
+ */
+double messages_per_acquisition(Protocol protocol, int thieves)
+{
+    switch (protocol)
+    {
+    case Protocol::BROADCAST:
+        return 3.0 * (thieves - 1);
+    case Protocol::RICART_AGRAWALA:
+        return 2.0 * (thieves - 1);
+    case Protocol::MAEKAWA:
+        return 3.0 * (mood_thieves::grid_quorum(0, thieves).size() - 1);
+    case Protocol::SUZUKI_KASAMI:
+        return 2.0 * thieves;
+    default:
+        return 0;
+    }
+}
+
+Prediction predict(const Config &config)
+{
+    int thieves = config.thieves;
+    double roam_us = config.weapon_us;
+    double lab_us = config.laboratory_us;
+    double recharge_us = config.recharge_us;
+    double latency_us = mean_latency_us(config.latency);
+    double handle_us = config.handle_ns / 1000.0;
+    double messages = messages_per_acquisition(config.protocol, thieves);
+
+    Prediction prediction;
+    double weapon_wait = 0, lab_wait = 0, arbitration = 2 * (latency_us + handle_us);
+    for (int iteration = 0; iteration < 10000; iteration++)
+    {
+        double cycle = weapon_wait + roam_us + lab_wait + lab_us + 2 * arbitration;
+        double throughput = thieves / cycle;
+        // Every entry takes a weapon and a laboratory, their messages spread over all receivers
+        double receiver = std::min(0.99, 2 * throughput * messages / thieves * handle_us);
+        double next_arbitration = 2 * (latency_us + handle_us / (1 - receiver));
+
+        // Only thieves holding a weapon request a laboratory, the weapons pace the laboratory requests
+        int lab_sources = std::min(thieves, config.weapons);
+        double lab_think = std::max(0.0, lab_sources / throughput - lab_wait - lab_us);
+        double next_lab_wait = repairman_wait(lab_sources, config.laboratories, lab_us, lab_think);
+
+        double held = roam_us + arbitration + lab_wait + lab_us + recharge_us;
+        int sources = static_cast<int>(std::ceil((weapon_wait + held) / cycle));
+        double weapon_think = sources * cycle - weapon_wait - held;
+        double next_weapon_wait = repairman_wait(thieves * sources, config.weapons, held, weapon_think);
+
+        prediction.throughput = throughput * 1e6;
+        prediction.cycle_us = cycle;
+        prediction.weapon_wait_us = weapon_wait;
+        prediction.laboratory_wait_us = lab_wait;
+        prediction.arbitration_us = arbitration;
+        prediction.weapon_utilization = throughput * held / config.weapons;
+        prediction.lab_utilization = throughput * lab_us / config.laboratories;
+        prediction.receiver_utilization = receiver;
+
+        double change = std::abs(next_weapon_wait - weapon_wait) + std::abs(next_lab_wait - lab_wait) +
+                        std::abs(next_arbitration - arbitration);
+        if (change < 1e-6 * cycle)
+        {
+            break;
+        }
+        // Damped, the waits of the two pools feed each other
+        weapon_wait = (weapon_wait + next_weapon_wait) / 2;
+        lab_wait = (lab_wait + next_lab_wait) / 2;
+        arbitration = (arbitration + next_arbitration) / 2;
+    }
+    return prediction;
+}
+
+const char *protocol_name(Protocol protocol)
+{
+    const char *names[] = {"broadcast", "ricart-agrawala", "maekawa", "suzuki-kasami", "rma"};
+    return names[static_cast<int>(protocol)];
+}
+
+/**
+ * Split a line of a CSV file.
+ */
+std::vector<std::string> split(const std::string &line)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (true)
+    {
+        size_t comma = line.find(',', start);
+        items.push_back(line.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+        if (comma == std::string::npos)
+        {
+            return items;
+        }
+        start = comma + 1;
+    }
+}
+
+/**
+ * Predicts every row of a bench CSV and prints it next to the measured values.
+ *
+ * @return Status code, -1 if the file cannot be read.
+ */
+int compare_bench(const std::string &path, std::vector<std::string> arguments)
+{
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "[ERROR]: Cannot open %s\n", path.c_str());
+        return -1;
+    }
+    std::vector<std::string> lines;
+    char buffer[1024];
+    while (fgets(buffer, sizeof(buffer), file) != nullptr)
+    {
+        std::string line = buffer;
+        line.erase(line.find_last_not_of("\r\n") + 1);
+        lines.push_back(line);
+    }
+    fclose(file);
+    if (lines.empty())
+    {
+        fprintf(stderr, "[ERROR]: %s is empty\n", path.c_str());
+        return -1;
+    }
+
+    std::map<std::string, size_t> columns;
+    std::vector<std::string> header = split(lines[0]);
+    for (size_t column = 0; column < header.size(); column++)
+    {
+        columns[header[column]] = column;
+    }
+    for (const char *name : {"protocol", "ranks", "weapons", "laboratories", "weapon_us", "laboratory_us",
+                             "recharge_us", "entries_per_s", "laboratory_p50_us", "weapon_p50_us"})
+    {
+        if (columns.count(name) == 0)
+        {
+            fprintf(stderr, "[ERROR]: %s has no column %s\n", path.c_str(), name);
+            return -1;
+        }
+    }
+
+    printf("%16s %6s %8s %6s %14s %14s %8s %14s %14s %14s %14s\n", "protocol", "K", "weapons", "labs",
+           "entries/s", "measured", "error", "weapon(ms)", "measured p50", "lab(ms)", "measured p50");
+    for (size_t i = 1; i < lines.size(); i++)
+    {
+        std::vector<std::string> row = split(lines[i]);
+        if (row.size() != header.size())
+        {
+            continue;
+        }
+        // The options of the row follow those given, so the row wins
+        std::vector<std::string> row_arguments = arguments;
+        row_arguments.push_back("--protocol=" + row[columns["protocol"]]);
+        row_arguments.push_back("--thieves=" + row[columns["ranks"]]);
+        for (const char *name : {"weapons", "laboratories", "weapon_us", "laboratory_us", "recharge_us"})
+        {
+            std::string option = name;
+            std::replace(option.begin(), option.end(), '_', '-');
+            row_arguments.push_back("--" + option + "=" + row[columns[name]]);
+        }
+        std::vector<char *> argv;
+        for (std::string &argument : row_arguments)
+        {
+            argv.push_back(argument.data());
+        }
+        Config config;
+        if (mood_thieves::parse_config(static_cast<int>(argv.size()), argv.data(), config) == -1)
+        {
+            return -1;
+        }
+
+        Prediction prediction = predict(config);
+        double measured = atof(row[columns["entries_per_s"]].c_str());
+        printf("%16s %6d %8d %6d %14.1f %14.1f %7.1f%% %14.3f %14.3f %14.3f %14.3f\n",
+               protocol_name(config.protocol), config.thieves, config.weapons, config.laboratories,
+               prediction.throughput, measured,
+               measured > 0 ? 100 * (prediction.throughput - measured) / measured : 0,
+               (prediction.weapon_wait_us + prediction.arbitration_us) / 1000,
+               atof(row[columns["weapon_p50_us"]].c_str()) / 1000,
+               (prediction.laboratory_wait_us + prediction.arbitration_us) / 1000,
+               atof(row[columns["laboratory_p50_us"]].c_str()) / 1000);
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> arguments = {argv[0]};
+    std::string bench;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument.rfind("--bench=", 0) == 0)
+        {
+            bench = argument.substr(8);
+        }
+        else
+        {
+            arguments.push_back(argument);
+        }
+    }
+    if (!bench.empty())
+    {
+        return compare_bench(bench, arguments) == -1 ? 1 : 0;
+    }
+
+    std::vector<char *> config_argv;
+    for (std::string &argument : arguments)
+    {
+        config_argv.push_back(argument.data());
+    }
+    Config config;
+    if (mood_thieves::parse_config(static_cast<int>(config_argv.size()), config_argv.data(), config) == -1)
+    {
+        return 1;
+    }
+
+    Prediction prediction = predict(config);
+    printf("%-24s %14s", "", "predicted");
+    bool simulated = config.entries > 0 && config.protocol != Protocol::RMA;
+    mood_thieves::HistogramSummary weapon, laboratory;
+    double measured_throughput = 0;
+    if (simulated)
+    {
+        mood_thieves::Simulator simulator(config);
+        simulator.run();
+        weapon = simulator.getMetrics().summary(mood_thieves::Metrics::ACQUIRE_WEAPON);
+        laboratory = simulator.getMetrics().summary(mood_thieves::Metrics::ACQUIRE_LABORATORY);
+        measured_throughput = laboratory.count / (simulator.virtualNs() / 1e9);
+        printf(" %14s %8s", "simulated", "error");
+    }
+    printf("\n");
+
+    auto print = [simulated](const char *name, double predicted, double measured)
+    {
+        printf("%-24s %14.3f", name, predicted);
+        if (simulated)
+        {
+            printf(" %14.3f %7.1f%%", measured, measured > 0 ? 100 * (predicted - measured) / measured : 0);
+        }
+        printf("\n");
+    };
+    auto mean_ms = [](const mood_thieves::HistogramSummary &summary)
+    { return summary.count > 0 ? static_cast<double>(summary.sum) / summary.count / 1e6 : 0; };
+    print("entries/s", prediction.throughput, measured_throughput);
+    print("acquire weapon (ms)", (prediction.weapon_wait_us + prediction.arbitration_us) / 1000, mean_ms(weapon));
+    print("acquire laboratory (ms)", (prediction.laboratory_wait_us + prediction.arbitration_us) / 1000,
+          mean_ms(laboratory));
+    printf("%-24s %14.3f\n", "cycle (ms)", prediction.cycle_us / 1000);
+    printf("%-24s %14.3f\n", "arbitration (ms)", prediction.arbitration_us / 1000);
+    printf("%-24s %14.3f\n", "weapon utilization", prediction.weapon_utilization);
+    printf("%-24s %14.3f\n", "laboratory utilization", prediction.lab_utilization);
+    printf("%-24s %14.3f\n", "receiver utilization", prediction.receiver_utilization);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <chrono>
+#include <stdio.h>
+
+#include "mood_thieves/config.hpp"
+#include "mood_thieves/simulator.hpp"
+
+/**
+ * Runs the thieves in a deterministic discrete-event simulation and reports the metrics of the run.
+ *
+ * Takes the options of main, --thieves is the number of simulated thieves, --latency the distribution of the
+ * message latency (const:US, uniform:MIN:MAX, exp:BASE:MEAN or lognormal:MEDIAN:SIGMA), --handle-ns the time
+ * a receiver spends on a message and --seed the seed. Either --entries or --duration-ms (in virtual time)
+ * has to be set. The times in the report are virtual, a summary of the simulation goes to the standard error.
+ *
+ * Usage: simulate --thieves=1000 --protocol=maekawa --entries=100 [--name=value ...]
+ */
+
+int main(int argc, char **argv)
+{
+    mood_thieves::Config config;
+    if (mood_thieves::parse_config(argc, argv, config) == -1)
+    {
+        return 1;
+    }
+    if (config.protocol == mood_thieves::Protocol::RMA)
+    {
+        fprintf(stderr, "[ERROR]: The rma protocol exchanges no messages to simulate\n");
+        return 1;
+    }
+    if (config.entries == 0 && config.duration_ms == 0)
+    {
+        fprintf(stderr, "[ERROR]: Either --entries or --duration-ms has to be positive\n");
+        return 1;
+    }
+
+    FILE *output = stdout;
+    if (!config.metrics_file.empty())
+    {
+        output = fopen(config.metrics_file.c_str(), "w");
+        if (output == nullptr)
+        {
+            fprintf(stderr, "[ERROR]: Cannot open metrics file %s\n", config.metrics_file.c_str());
+            return 1;
+        }
+    }
+
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    mood_thieves::Simulator simulator(config);
+    simulator.run();
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    if (config.metrics_format != mood_thieves::MetricsFormat::OFF)
+    {
+        simulator.getMetrics().report(config.thieves, simulator.virtualNs() / 1e9,
+                                      config.metrics_format == mood_thieves::MetricsFormat::JSON, output);
+    }
+    if (output != stdout)
+    {
+        fclose(output);
+    }
+    fprintf(stderr,
+            "[SIMULATION] %d thieves, %.3f virtual s, %ld events in %.2f wall s (%.0f events/s), %ld violations\n",
+            config.thieves, simulator.virtualNs() / 1e9, simulator.eventCount(), wall_s,
+            simulator.eventCount() / wall_s, simulator.violationCount());
+    return simulator.violationCount() == 0 ? 0 : 1;
+}
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <cstdarg>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <stdio.h>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "mood_thieves/trace.hpp"
+
+/**
+ * Merges the per-rank trace files into a single Chrome/Perfetto trace JSON written to the standard output.
+ *
+ * Every rank becomes a process and every traced thread a thread of it. Sends and receives are slices joined
+ * by flow arrows, waiting for and holding a resource and recharging a weapon are async spans. A wait ends
+ * when the thief enters or withdraws its request.
+ *
+ * Usage: trace_merge <prefix>.0.trace <prefix>.1.trace ... > trace.json
+ */
+
+namespace
+{
+
+using mood_thieves::trace::Record;
+
+const char *MESSAGE_NAMES[] = {"REQUEST", "ACK",    "RELEASE", "INQUIRE",  "YIELD",
+                               "FAILED",  "FINISH", "TOKEN",   "WITHDRAW", "SERVED"};
+const char *RESOURCE_NAMES[] = {"weapon", "laboratory"};
+const char *ROLE_NAMES[] = {"thread", "receiver", "logic", "timer"};
+
+struct Event
+{
+    double ts;        ///< Time in microseconds since the first record.
+    int rank;         ///< The rank that recorded the event.
+    std::string json; ///< The event without the closing brace.
+};
+
+struct RankTrace
+{
+    int rank;
+    int64_t offset_ns;
+    std::vector<Record> records;
+};
+
+const char *message_name(int type)
+{
+    return type >= 0 && type < 10 ? MESSAGE_NAMES[type] : "UNKNOWN";
+}
+
+const char *resource_name(int resource)
+{
+    // Messages about a shard of a pool carry the shard in the bits above the resource
+    return resource >= 0 && resource < 256 ? RESOURCE_NAMES[resource % 2] : "resource";
+}
+
+bool read_trace(const char *path, RankTrace &trace)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "[ERROR]: Cannot open %s\n", path);
+        return false;
+    }
+    mood_thieves::trace::FileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, "MTTR", 4) != 0 ||
+        header.version != mood_thieves::trace::VERSION || header.record_size != sizeof(Record))
+    {
+        fprintf(stderr, "[ERROR]: %s is not a trace file of this version\n", path);
+        fclose(file);
+        return false;
+    }
+    trace.rank = header.rank;
+    trace.offset_ns = header.system_offset_ns;
+    Record record;
+    while (fread(&record, sizeof(record), 1, file) == 1)
+    {
+        trace.records.push_back(record);
+    }
+    fclose(file);
+    return true;
+}
+
+std::string format(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+std::string format(const char *fmt, ...)
+{
+    char buffer[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    return buffer;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <prefix>.<rank>.trace ... > trace.json\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<RankTrace> traces(argc - 1);
+    int64_t start_ns = INT64_MAX;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!read_trace(argv[i], traces[i - 1]))
+        {
+            return 1;
+        }
+        for (const Record &record : traces[i - 1].records)
+        {
+            start_ns = std::min(start_ns, static_cast<int64_t>(record.time_ns) + traces[i - 1].offset_ns);
+        }
+    }
+
+    std::vector<Event> events;
+    // Messages waiting for their receive, keyed by sender, receiver, type, resource, clock and value
+    std::map<std::tuple<int, int, int, int, int, int>, std::deque<long>> in_flight;
+    long next_flow = 0;
+    long next_span = 0;
+
+    for (const RankTrace &trace : traces)
+    {
+        int pid = trace.rank;
+        events.push_back({0, pid, format(R"({"ph":"M","pid":%d,"name":"process_name","args":{"name":"thief %d"})",
+                                         pid, pid)});
+        std::map<int, std::deque<long>> holding; // Hold spans per resource, the oldest weapon is released first
+        std::deque<long> recharging;             // Recharge spans, the oldest recharge ends first
+        std::map<int, long> waiting;             // Wait spans per resource
+
+        for (const Record &record : trace.records)
+        {
+            double ts = (static_cast<int64_t>(record.time_ns) + trace.offset_ns - start_ns) / 1000.0;
+            int tid = record.thread;
+            const char *resource = resource_name(record.resource);
+            switch (record.kind)
+            {
+            case mood_thieves::trace::THREAD_NAME:
+                events.push_back({ts, pid,
+                                  format(R"({"ph":"M","pid":%d,"tid":%d,"name":"thread_name","args":{"name":"%s"})",
+                                         pid, tid, ROLE_NAMES[std::min<int>(record.message_type, 3)])});
+                break;
+            case mood_thieves::trace::SEND:
+            {
+                long flow = next_flow++;
+                in_flight[{pid, record.peer, record.message_type, record.resource, record.message_clock, record.unit}]
+                    .push_back(flow);
+                events.push_back({ts, pid,
+                                  format(R"({"ph":"X","pid":%d,"tid":%d,"ts":%.3f,"dur":1,"name":"send %s",)"
+                                         R"("args":{"to":%d,"resource":"%s","clock":%d,"value":%d})",
+                                         pid, tid, ts, message_name(record.message_type), record.peer, resource,
+                                         record.message_clock, record.unit)});
+                events.push_back({ts, pid,
+                                  format(R"({"ph":"s","pid":%d,"tid":%d,"ts":%.3f,"id":%ld,"name":"message",)"
+                                         R"("cat":"message")",
+                                         pid, tid, ts, flow)});
+                break;
+            }
+            case mood_thieves::trace::RECEIVE:
+                events.push_back({ts, pid,
+                                  format(R"({"ph":"X","pid":%d,"tid":%d,"ts":%.3f,"dur":1,"name":"receive %s",)"
+                                         R"("args":{"from":%d,"resource":"%s","clock":%d,"message_clock":%d,)"
+                                         R"("value":%d})",
+                                         pid, tid, ts, message_name(record.message_type), record.peer, resource,
+                                         record.clock, record.message_clock, record.unit)});
+                break;
+            case mood_thieves::trace::REQUEST:
+                waiting[record.resource] = next_span;
+                events.push_back({ts, pid,
+                                  format(R"({"ph":"b","pid":%d,"tid":%d,"ts":%.3f,"id":%ld,"cat":"wait",)"
+                                         R"("name":"wait %s","args":{"clock":%d})",
+                                         pid, tid, ts, next_span++, resource, record.clock)});
+                break;
+            case mood_thieves::trace::WITHDRAW:
+            case mood_thieves::trace::ENTER:
+                if (waiting.count(record.resource) > 0)
+                {
+                    events.push_back({ts, pid,
+                                      format(R"({"ph":"e","pid":%d,"tid":%d,"ts":%.3f,"id":%ld,"cat":"wait",)"
+                                             R"("name":"wait %s")",
+                                             pid, tid, ts, waiting[record.resource], resource)});
+                    waiting.erase(record.resource);
+                }
+                if (record.kind == mood_thieves::trace::WITHDRAW)
+                {
+                    break;
+                }
+                holding[record.resource].push_back(next_span);
+                events.push_back({ts, pid,
+                                  format(R"({"ph":"b","pid":%d,"tid":%d,"ts":%.3f,"id":%ld,"cat":"hold",)"
+                                         R"("name":"hold %s","args":{"clock":%d})",
+                                         pid, tid, ts, next_span++, resource, record.clock)});
+                break;
+            case mood_thieves::trace::EXIT:
+            case mood_thieves::trace::RECHARGE_END:
+                if (!holding[record.resource].empty())
+                {
+                    events.push_back({ts, pid,
+                                      format(R"({"ph":"e","pid":%d,"tid":%d,"ts":%.3f,"id":%ld,"cat":"hold",)"
+                                             R"("name":"hold %s")",
+                                             pid, tid, ts, holding[record.resource].front(), resource)});
+                    holding[record.resource].pop_front();
+                }
+                if (record.kind == mood_thieves::trace::RECHARGE_END && !recharging.empty())
+                {
+                    events.push_back({ts, pid,
+                                      format(R"({"ph":"e","pid":%d,"tid":%d,"ts":%.3f,"id":%ld,"cat":"recharge",)"
+                                             R"("name":"recharge")",
+                                             pid, tid, ts, recharging.front())});
+                    recharging.pop_front();
+                }
+                break;
+            case mood_thieves::trace::RECHARGE_START:
+                recharging.push_back(next_span);
+                events.push_back({ts, pid,
+                                  format(R"({"ph":"b","pid":%d,"tid":%d,"ts":%.3f,"id":%ld,"cat":"recharge",)"
+                                         R"("name":"recharge","args":{"clock":%d})",
+                                         pid, tid, ts, next_span++, record.clock)});
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    // Finish the flows once every sender is known, receives may come from ranks read later
+    for (const RankTrace &trace : traces)
+    {
+        for (const Record &record : trace.records)
+        {
+            if (record.kind != mood_thieves::trace::RECEIVE)
+            {
+                continue;
+            }
+            auto it = in_flight.find(
+                {record.peer, trace.rank, record.message_type, record.resource, record.message_clock, record.unit});
+            if (it == in_flight.end() || it->second.empty())
+            {
+                continue;
+            }
+            double ts = (static_cast<int64_t>(record.time_ns) + trace.offset_ns - start_ns) / 1000.0;
+            events.push_back({ts, trace.rank,
+                              format(R"({"ph":"f","bp":"e","pid":%d,"tid":%d,"ts":%.3f,"id":%ld,"name":"message",)"
+                                     R"("cat":"message")",
+                                     trace.rank, record.thread, ts, it->second.front())});
+            it->second.pop_front();
+        }
+    }
+
+    std::stable_sort(events.begin(), events.end(),
+                     [](const Event &a, const Event &b) { return a.ts < b.ts; });
+    printf("{\"traceEvents\":[\n");
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        printf("%s}%s\n", events[i].json.c_str(), i + 1 < events.size() ? "," : "");
+    }
+    printf("],\"displayTimeUnit\":\"ms\"}\n");
+    return 0;
+}